@@ -50,39 +50,78 @@ static const char* h_table[] = {
     "ぜ","じ","ぞ","ず","じゃ","じぇ","じぃ","じょ","じゅ",
 };
 
+// かなテーブル(Shift-JIS、h_table と同じ並び。辞書の見出し語の符号化)
+//  ゔ は Shift-JIS にないため ヴ で代用する
+static const char* s_table[] = {
+    "\x82\xa0","\x82\xce","\x82\xd7","\x82\xd1","\x82\xda","\x82\xd4","\x82\xd1\x82\xe1","\x82\xd1\x82\xa5","\x82\xd1\x82\xa1","\x82\xd1\x82\xe5","\x82\xd1\x82\xe3","\x82\xa9","\x82\xb9","\x82\xbf\x82\xe1","\x82\xbf\x82\xa5",
+    "\x82\xbf","\x82\xbf\x82\xe5","\x82\xbf\x82\xe3","\x82\xb5","\x82\xb1","\x82\xad","\x82\xbf\x82\xe1","\x82\xbf\x82\xa5","\x82\xbf\x82\xa1","\x82\xbf\x82\xe5","\x82\xbf\x82\xe3","\x82\xbe","\x82\xc5","\x82\xc5\x82\xe1","\x82\xc5\x82\xa5",
+    "\x82\xc5\x82\xa1","\x82\xc5\x82\xe5","\x82\xc5\x82\xe3","\x82\xc0","\x82\xc7","\x82\xc3","\x82\xc0\x82\xe1","\x82\xc0\x82\xa5","\x82\xc0\x82\xa1","\x82\xc0\x82\xe5","\x82\xc0\x82\xe3","\x82\xa6","\x82\xd3\x82\x9f","\x82\xd3\x82\xa5","\x82\xd3\x82\xa1",
+    "\x82\xd3\x82\xa7","\x82\xd3","\x82\xd3\x82\xe1","\x82\xd3\x82\xa5","\x82\xd3\x82\xa1","\x82\xd3\x82\xe5","\x82\xd3\x82\xe3","\x82\xaa","\x82\xb0","\x82\xac","\x82\xb2","\x82\xae","\x82\xac\x82\xe1","\x82\xac\x82\xa5","\x82\xac\x82\xa1",
+    "\x82\xac\x82\xe5","\x82\xac\x82\xe3","\x82\xcd","\x82\xd6","\x82\xd0","\x82\xd9","\x82\xd3","\x82\xd0\x82\xe1","\x82\xd0\x82\xa5","\x82\xd0\x82\xa1","\x82\xd0\x82\xe5","\x82\xd0\x82\xe3","\x82\xa2","\x82\xb6\x82\xe1","\x82\xb6\x82\xa5",
+    "\x82\xb6","\x82\xb6\x82\xe5","\x82\xb6\x82\xe3","\x82\xb6\x82\xe1","\x82\xb6\x82\xa5","\x82\xb6\x82\xa1","\x82\xb6\x82\xe5","\x82\xb6\x82\xe3","\x82\xa9","\x82\xaf","\x82\xab","\x82\xb1","\x82\xad","\x82\xad\x82\xec","\x82\xad\x82\xa5",
+    "\x82\xad\x82\xa1","\x82\xad\x82\xa7","\x82\xad\x82\xa3","\x82\xab\x82\xe1","\x82\xab\x82\xa5","\x82\xab\x82\xa1","\x82\xab\x82\xe5","\x82\xab\x82\xe3","\x82\x9f","\x82\xa5","\x82\xa1","\x82\xa7","\x82\xc1","\x82\xc1","\x82\xa3",
+    "\x82\xe1","\x82\xa5","\x82\xa1","\x82\xe5","\x82\xe3","\x82\xdc","\x82\xdf","\x82\xdd","\x82\xe0","\x82\xde","\x82\xdd\x82\xe1","\x82\xdd\x82\xa5","\x82\xdd\x82\xa1","\x82\xdd\x82\xe5","\x82\xdd\x82\xe3",
+    "\x82\xc8","\x82\xcb","\x82\xc9","\x82\xcc","\x82\xca","\x82\xca\x82\xec","\x82\xca\x82\xa5","\x82\xca\x82\xa1","\x82\xca\x82\xa7","\x82\xca\x82\xa3","\x82\xc9\x82\xe1","\x82\xc9\x82\xa5","\x82\xc9\x82\xa1","\x82\xc9\x82\xe5","\x82\xc9\x82\xe3",
+    "\x82\xa8","\x82\xcf","\x82\xd8","\x82\xd2","\x82\xdb","\x82\xd5","\x82\xd2\x82\xe1","\x82\xd2\x82\xa5","\x82\xd2\x82\xa1","\x82\xd2\x82\xe5","\x82\xd2\x82\xe3","\x82\xad\x82\x9f","\x82\xad\x82\xa5","\x82\xad\x82\xa1","\x82\xad\x82\xa7",
+    "\x82\xad","\x82\xe7","\x82\xea","\x82\xe8","\x82\xeb","\x82\xe9","\x82\xe8\x82\xe1","\x82\xe8\x82\xa5","\x82\xe8\x82\xa1","\x82\xe8\x82\xe5","\x82\xe8\x82\xe3","\x82\xb3","\x82\xb9","\x82\xb5\x82\xe1","\x82\xb5\x82\xa5",
+    "\x82\xb5","\x82\xb5\x82\xe5","\x82\xb5\x82\xe3","\x82\xb5","\x82\xbb","\x82\xb7","\x82\xb7\x82\xec","\x82\xb7\x82\xa5","\x82\xb7\x82\xa1","\x82\xb7\x82\xa7","\x82\xb7\x82\xa3","\x82\xb5\x82\xe1","\x82\xb5\x82\xa5","\x82\xb5","\x82\xb5\x82\xe5",
+    "\x82\xb5\x82\xe3","\x82\xbd","\x82\xc4","\x82\xc4\x82\xe1","\x82\xc4\x82\xa5","\x82\xc4\x82\xa1","\x82\xc4\x82\xe5","\x82\xc4\x82\xe3","\x82\xbf","\x82\xc6","\x82\xc2\x82\x9f","\x82\xc2\x82\xa5","\x82\xc2\x82\xa1","\x82\xc2\x82\xa7","\x82\xc2",
+    "\x82\xc2","\x82\xbf\x82\xe1","\x82\xbf\x82\xa5","\x82\xbf\x82\xa1","\x82\xbf\x82\xe5","\x82\xbf\x82\xe3","\x82\xa4","\x83\x94\x82\x9f","\x83\x94\x82\xa5","\x83\x94\x82\xa1","\x83\x94\x82\xa7","\x83\x94","\x83\x94\x82\xe1","\x83\x94\x82\xa5","\x83\x94\x82\xa1",
+    "\x83\x94\x82\xe5","\x83\x94\x82\xe3","\x82\xed","\x82\xa4\x82\xa5","\x82\xa4\x82\x9f","\x82\xa4\x82\xa5","\x82\xa4\x82\xa1","\x82\xa4\x82\xa7","\x82\xa4","\x82\xa4\x82\xa1","\x82\xf0","\x82\xa4","\x82\x9f","\x82\xa5","\x82\xa1",
+    "\x82\xa7","\x82\xc1","\x82\xc1","\x82\xa3","\x82\xe1","\x82\xa5","\x82\xa1","\x82\xe5","\x82\xe3","\x82\xe2","\x82\xa2\x82\xa5","\x82\xa2","\x82\xe6","\x82\xe4","\x82\xb4",
+    "\x82\xba","\x82\xb6","\x82\xbc","\x82\xb8","\x82\xb6\x82\xe1","\x82\xb6\x82\xa5","\x82\xb6\x82\xa1","\x82\xb6\x82\xe5","\x82\xb6\x82\xe3",
+};
+
 // 文字列バイト数の取得
 uint16_t JString::bytes(const char* text) {
     return strlen(text);
 }
 
+// 文字列バイト数の取得(長さ指定版)
+//  text_len バイト以内で '\0' が見つかった場合はその位置までのバイト数を返す
+uint16_t JString::bytes(const char* text, uint16_t text_len) {
+    const char* p = (const char*)memchr(text, '\0', text_len);
+    return p ? (uint16_t)(p - text) : text_len;
+}
+
+// UTF8先頭バイトから1文字のバイト数を求める(不正な先頭バイトは0)
+static inline uint8_t utf8_nbytes(uint8_t c) {
+    if (c < 0x80)              return 1;
+    if (c >= 0xc0 && c < 0xe0) return 2;
+    if (c >= 0xe0 && c < 0xf0) return 3;
+    if (c >= 0xf0 && c < 0xf5) return 4;
+    return 0;
+}
+
 //
 // UTF8文字(1～4バイト)の文字数をカウントする
 // pUTF8(in):   UTF8文字列格納アドレス
 // 戻り値: 文字数
 // 
 uint16_t JString::len(const char* text) {
-    uint8_t *pUTF8 = (uint8_t*)text;
-    uint8_t c; 
+    return len(text, strlen(text));
+}
+
+//
+// UTF8文字(1～4バイト)の文字数をカウントする(長さ指定版)
+//  text(in):     UTF8文字列格納アドレス
+//  text_len(in): 文字列バイト数
+// 戻り値: 文字数('\0'、不正バイト、途中で切れた文字の手前まで)
+//
+uint16_t JString::len(const char* text, uint16_t text_len) {
+    const uint8_t *pUTF8 = (const uint8_t*)text;
+    uint16_t pos = 0;
     uint16_t cnt = 0;
-    
-    for(;;) {
-        c = *pUTF8;
-        if (c =='\0') break;
-        if( c < 0x80 ) {
-            // 1バイト文字
-            cnt++; pUTF8++; 
-        } else if( c >= 0xc0 && c < 0xe0 )  { 
-            // 2バイト文字
-            cnt++; pUTF8+=2;
-        } else if( c >= 0xe0 && c < 0xf0 ) { 
-            // 3バイト文字
-            cnt++;  pUTF8+=3;
-        } else if( c >= 0xf0 && c < 0xf5 ) { 
-            // 4バイト文字
-            cnt++; pUTF8+=4;
-        } else { 
+    uint8_t  n;
+
+    while (pos < text_len) {
+        if (pUTF8[pos] == '\0')
             break;
-        }
+        n = utf8_nbytes(pUTF8[pos]);
+        if (n == 0 || pos + n > text_len)
+            break;
+        cnt++;
+        pos += n;
     }
     return cnt;
 }
@@ -97,62 +136,57 @@ uint16_t JString::len(const char* text) {
 //   変換処理したUTF8文字バイト数
 //
 uint16_t JString::get(char *dst, char *src)  { 
-    uint8_t c = *src;        
-    if( c < 0x80 ) {
-        // 1バイト文字の処理
-        *dst++ = *src;
-        *dst   = '\0';
-        return(1);
-    }
-
-    if(c >= 0xc0 && c < 0xe0) {
-        // 2バイト文字の処理
-        *dst++ = *src++;
-        *dst++ = *src;
-        *dst   = '\0';
-        return(2); 
-    }
+    return get(dst, src, bytes(src, 4));
+} 
 
-    if( c >= 0xe0 && c < 0xf0) {
-        // 3バイト文字の処理
-        *dst++ = *src++;
-        *dst++ = *src++;
-        *dst++ = *src;
-        *dst = '\0';
-        return(3);
-    }
-    
-    if( c >= 0xf0 && c < 0xf5) {
-        // 4バイト文字の処理
-        *dst++ = *src++;
-        *dst++ = *src++;
-        *dst++ = *src++;
-        *dst++ = *src;
+//
+// 先頭からの1文字取得(長さ指定版)
+//  引数
+//   dst(out):    UTF8 1文字+'\0'の格納アドレス
+//   src(in):     UTF8文字列格納アドレス
+//   src_len(in): 文字列バイト数
+// 戻り値
+//   取得したUTF8文字バイト数(不正な文字、途中で切れた文字の場合は0)
+//
+uint16_t JString::get(char *dst, const char *src, uint16_t src_len) {
+    uint8_t n = src_len ? utf8_nbytes((uint8_t)*src) : 0;
+    if (n == 0 || n > src_len) {
         *dst = '\0';
-        return(4);
+        return 0;
     }
-    *dst = '\0';
-    return 0;
-} 
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+    return n;
+}
 
 // utf8 1文字をutf32に変換する
 uint32_t JString::utf8to32(char* src) {
+    return utf8to32(src, bytes(src, 4));
+}
+
+// utf8 1文字をutf32に変換する(長さ指定版)
+//  途中で切れた文字、不正な文字の場合は0を返す
+uint32_t JString::utf8to32(const char* src, uint16_t src_len) {
     uint32_t code;
 
+    uint8_t n = src_len ? utf8_nbytes((uint8_t)*src) : 0;
+    if (n == 0 || n > src_len)
+        return 0;
+
     uint8_t c = *src;        
-    if( c < 0x80 ) {
+    if( n == 1 ) {
         // 1バイト文字の処理
         return (uint32_t)c;
     }
 
-    if(c >= 0xc0 && c < 0xe0) {
+    if( n == 2 ) {
         // 2バイト文字の処理
         code = 0x1f & c; 
         code = (code<<6)+(0x3f & src[1]); 
         return code; 
     }
 
-    if( c >= 0xe0 && c < 0xf0) {
+    if( n == 3 ) {
         // 3バイト文字の処理
         code = 0x0f & c; 
         code = (code<<6)+(0x3f & src[1]); 
@@ -160,15 +194,12 @@ uint32_t JString::utf8to32(char* src) {
         return code; 
     }
     
-    if( c >= 0xf0 && c < 0xf5) {
-        // 4バイト文字の処理
-        code = 0x07 & c; 
-        code = (code<<6)+(0x3f & src[1]); 
-        code = (code<<6)+(0x3f & src[2]); 
-        code = (code<<6)+(0x3f & src[3]); 
-        return code; 
-    }
-    return 0;        
+    // 4バイト文字の処理
+    code = 0x07 & c; 
+    code = (code<<6)+(0x3f & src[1]); 
+    code = (code<<6)+(0x3f & src[2]); 
+    code = (code<<6)+(0x3f & src[3]); 
+    return code; 
 }
 
 
@@ -210,58 +241,76 @@ uint8_t JString::utf32to8(char* dst, uint32_t code) {
     return 4;
 }
 
-// ローマ字テーブル２分検索
-int16_t binfind(const char* key, uint8_t cmplen) {
-	int16_t t_p = 0;                   // 検索範囲上限
-	int16_t e_p = RKTBLSIZE-1;         // 検索範囲下限
-	uint16_t flg_stop = 0;
-	int16_t pos;
-	int rc;
-    char roma_str[10];
+// 先頭の英字毎の r_table の範囲(r_first[c - 'a'] ～ r_first[c - 'a' + 1] - 1)
+static uint8_t r_first[27];
 
-	for(;;) {
-		pos = t_p + ((e_p - t_p+1)>>1);
-		rc = strncasecmp(key, r_table[pos], cmplen);
-        if (rc == 0) {        // 等しい
-            flg_stop = 1;  
-			break;
-		} else if (rc > 0) {  // 大きい
-			t_p = pos + 1;   
-			if (t_p > e_p)
-				break;
-		} else {              // 小さい
-			e_p = pos -1;
-			if (e_p < t_p)
-				break;
-		}
-	}
-	if (!flg_stop)
-		return -1;
-	return pos;
+static uint8_t build_r_first() {
+    uint16_t j = 0;
+    for (uint16_t c = 0; c <= 26; c++) {
+        while (j < RKTBLSIZE && (unsigned char)r_table[j][0] < 'a' + c)
+            j++;
+        r_first[c] = j;
+    }
+    return 1;
 }
+static uint8_t r_first_built = build_r_first();
 
 // ローマ字テーブルのインデックスを返す
+//  r_table は整列済みなので、先頭の英字の範囲(r_first)から1文字ずつ、そこまでの綴りが一致する範囲を
+//  2分検索で絞り込む。一致する範囲では短い綴りほど前に並ぶため、範囲の先頭がちょうどその長さなら
+//  完全に一致している。最も長く完全に一致した綴り(4文字まで)を返す。
 // 引数
 //   tokens
+//   tokens_len: tokens のバイト数
 // 戻り値
 // 　見つかった場合：	0以上
 //	 見つからない場合： -1
 //
-int16_t get_roma_index(const char* tokens) {
-    int16_t tokens_len = strlen(tokens);
+int16_t get_roma_index(const char* tokens, uint16_t tokens_len) {
     int16_t index = -1;
-    int16_t tmp_index = -1;
+    uint16_t lo, hi;                   // 先頭 i 文字が一致する範囲 [lo, hi)
+    unsigned char first;
 
-    for (uint16_t i=1; i<=4; i++) {
-        if (i > tokens_len)
-            break;
-        tmp_index = binfind(tokens, i);
-        if (tmp_index < 0)
+    if (tokens_len == 0)
+        return -1;
+    first = tolower((unsigned char)tokens[0]);
+    if (first < 'a' || first > 'z')
+        return -1;
+    lo = r_first[first - 'a'];
+    hi = r_first[first - 'a' + 1];
+    if (lo >= hi)
+        return -1;
+    if (r_table[lo][1] == '\0')
+        index = lo;
+
+    for (uint16_t i = 1; i < 4 && i < tokens_len; i++) {
+        unsigned char c = tolower((unsigned char)tokens[i]);
+        uint16_t l = lo, h = hi, m;
+        if (c == '\0')
             break;
-        if ( i != strlen_pgm(r_table[tmp_index]) ) {
-        continue;
+        // i 文字目が c 以上の最初
+        while (l < h) {
+            m = (l + h) >> 1;
+            if ((unsigned char)r_table[m][i] < c)
+                l = m + 1;
+            else
+                h = m;
+        }
+        lo = l;
+        // i 文字目が c より大きい最初
+        h = hi;
+        while (l < h) {
+            m = (l + h) >> 1;
+            if ((unsigned char)r_table[m][i] <= c)
+                l = m + 1;
+            else
+                h = m;
         }
-        index = tmp_index;
+        hi = l;
+        if (lo >= hi)
+            break;
+        if (r_table[lo][i + 1] == '\0')
+            index = lo;
     }
     return index;
 }
@@ -269,10 +318,11 @@ int16_t get_roma_index(const char* tokens) {
 // 撥音 "ん" に変換すべきかどうかを判定する
 //  引数
 //    tokens: 文字列
+//    tokens_len: tokens のバイト数
 //  戻り値
 //    1:変換可 0:変換不可
-uint8_t isHatsuon(const char* tokens) {
-	if (strlen(tokens) < 1)
+uint8_t isHatsuon(const char* tokens, uint16_t tokens_len) {
+	if (tokens_len < 1)
 		return 0;
 	if (*tokens == 'n' || *tokens == 'm')
 		return 1;
@@ -283,10 +333,11 @@ uint8_t isHatsuon(const char* tokens) {
 // 促音 "っ" に変換すべきかどうかを判定する
 //  引数
 //    tokens: 文字列
+//    tokens_len: tokens のバイト数
 //  戻り値
 //    1:変換可 0:変換不可
-uint8_t isSokuon(const char* tokens) {
-	if (strlen(tokens) < 2)
+uint8_t isSokuon(const char* tokens, uint16_t tokens_len) {
+	if (tokens_len < 2)
 		return 0;
 	if (tokens[0] != tokens[1])
 		return 0;
@@ -305,49 +356,418 @@ uint8_t isSokuon(const char* tokens) {
 //   ローマ字からひらがなに変換した文字数
 //
 uint16_t JString::roma_to_kana(char* dst, char* src) {
+	return roma_to_kana(dst, src, strlen(src));
+}
+
+// ローマ字ひらがな変換(長さ指定版)
+//  引数
+//   dst:     変換後のひらがな文字列
+//   src:     変換対象ローマ字文字列
+//   src_len: src のバイト数
+//   dst_len: 変換後のバイト数の格納先(NULL可)
+//  戻り値
+//   ローマ字からひらがなに変換した文字数
+//
+uint16_t JString::roma_to_kana(char* dst, const char* src, uint16_t src_len, uint16_t* dst_len) {
+	return roma_convert(dst, src, src_len, dst_len, h_table, "ん", "っ");
+}
+
+// ローマ字ひらがな変換(Shift-JIS出力版)
+//  引数・戻り値は roma_to_kana() と同じ。変換後の文字列は Shift-JIS(辞書の見出し語と同じ符号化)
+//
+uint16_t JString::roma_to_sjis(char* dst, const char* src, uint16_t src_len, uint16_t* dst_len) {
+	return roma_convert(dst, src, src_len, dst_len, s_table, "\x82\xf1", "\x82\xc1");
+}
+
+// かな(Shift-JIS)のローマ字綴りの取得
+//  roma_to_sjis() で kana ちょうどに変換される綴りを返す(ローマ字テーブルの順)。
+//  入力で使われにくい綴り(c・q・l 始まり、wh 始まり等)は含めない。
+//  "ん" は "nn" と "n"。
+//  引数
+//   kana:     かな(1文字、または拗音などの2文字)
+//   kana_len: kana のバイト数
+//   out:      綴りの格納先
+//   max:      out の要素数
+//  戻り値
+//   綴りの数
+//
+uint8_t JString::sjis_spellings(const char* kana, uint16_t kana_len, const char** out, uint8_t max) {
+	uint8_t n = 0;
+
+	if (kana_len == 2 && memcmp(kana, "\x82\xf1", 2) == 0) {
+		if (n < max)
+			out[n++] = "nn";
+		if (n < max)
+			out[n++] = "n";
+		return n;
+	}
+	for (uint16_t i = 0; i < RKTBLSIZE && n < max; i++) {
+		const char* r = r_table[i];
+		if (r[0] == 'l' || r[0] == 'q' || (r[0] == 'c' && r[1] != 'h') ||
+		    (r[0] == 'w' && (r[1] == 'h' || r[1] == 'u')))
+			continue;
+		if (strlen(s_table[i]) == kana_len && memcmp(s_table[i], kana, kana_len) == 0)
+			out[n++] = r;
+	}
+	return n;
+}
+
+// ローマ字かな変換の本体
+//  引数
+//   table:   r_table と同じ並びのかなテーブル(h_table または s_table)
+//   hatsuon: "ん" の文字列(table と同じ符号化)
+//   sokuon:  "っ" の文字列(table と同じ符号化)
+//
+uint16_t JString::roma_convert(char* dst, const char* src, uint16_t src_len, uint16_t* dst_len,
+                               const char* const* table, const char* hatsuon, const char* sokuon) {
 	uint16_t dst_pos = 0;
 	uint16_t src_pos = 0;
-	uint16_t src_len = strlen(src);
 	int16_t index = 0;
 	uint16_t rc = 0;
 
 	for(;;) {
 		if (src_pos >= src_len)
 			break;
-        index = get_roma_index(&src[src_pos]);
+        index = get_roma_index(&src[src_pos], src_len - src_pos);
 		if (index  >= 0) {
-		//if ((index = get_roma_index(&src[src_pos])) >= 0) {
 			// ローマ字変換可能
 			uint16_t rm_len = strlen_pgm(r_table[index]);
-			uint16_t hk_len = strlen_pgm(h_table[index]);
-            strcpy_pgm(dst[dst_pos], h_table[index]);
+			uint16_t hk_len = strlen_pgm(table[index]);
+			memcpy(&dst[dst_pos], table[index], hk_len);
 
 			dst_pos += hk_len;
 			src_pos += rm_len;
 			rc++;
-		} else if (isHatsuon(&src[src_pos])) {
+		} else if (isHatsuon(&src[src_pos], src_len - src_pos)) {
 			// 撥音 "ん"に変換可能
 			uint16_t rm_len = strlen("n");
-			uint16_t hk_len = strlen("ん");
-			strcpy((char *)&dst[dst_pos], "ん");
+			uint16_t hk_len = strlen(hatsuon);
+			memcpy(&dst[dst_pos], hatsuon, hk_len);
 			dst_pos += hk_len;
 			src_pos += rm_len;
 			rc++;
-		} else if (isSokuon(&src[src_pos])) {
+		} else if (isSokuon(&src[src_pos], src_len - src_pos)) {
 			// 促音 "っ"に変換可能
 			uint16_t rm_len = strlen("t");
-			uint16_t hk_len = strlen("っ");
-			strcpy((char *)&dst[dst_pos], "っ");
+			uint16_t hk_len = strlen(sokuon);
+			memcpy(&dst[dst_pos], sokuon, hk_len);
 			dst_pos += hk_len;
 			src_pos += rm_len;
 			rc++;
 		} else {
 			// ローマ字に変換不可の場合、先頭1文字をそのままコピーする
-			((char*)dst)[dst_pos] = src[src_pos];
+			dst[dst_pos] = src[src_pos];
 			dst_pos++;
 			src_pos++;
 		}
 	}
-	((char *)dst)[dst_pos] = '\0';
+	dst[dst_pos] = '\0';
+	if (dst_len)
+		*dst_len = dst_pos;
 	return rc;
 }
+
+
+//
+// 一括変換
+//  UTF8のバイトパターンを直接書き換える。1文字毎に utf8to32()/utf32to8() を
+//  経由しないため、変換対象外の文字はマシンワード単位でそのままコピーする。
+//
+
+typedef uintptr_t jword_t;                              // マシンワード
+#define JW_SIZE   sizeof(jword_t)
+#define JW_ONES   ((jword_t)-1 / 0xff)                  // 0x0101...01
+#define JW_HIGHS  (JW_ONES * 0x80)                      // 0x8080...80
+
+// ワード読み込み(非アライン可)
+static inline jword_t load_word(const char* p) {
+    jword_t w;
+    memcpy(&w, p, JW_SIZE);
+    return w;
+}
+
+// ワード内に指定バイトが含まれるか
+static inline bool has_byte(jword_t w, uint8_t b) {
+    jword_t x = w ^ (JW_ONES * b);
+    return ((x - JW_ONES) & ~x & JW_HIGHS) != 0;
+}
+
+// 半角1文字(ASCII)を全角に変換して格納する。戻り値は格納バイト数
+static inline uint8_t put_zen(char* dst, uint8_t c) {
+    if (c == 0x20) {
+        // 空白 → U+3000 (E3 80 80)
+        dst[0] = (char)0xe3; dst[1] = (char)0x80; dst[2] = (char)0x80;
+        return 3;
+    }
+    if (c >= 0x21 && c <= 0x5f) {
+        // U+FF01～U+FF3F (EF BC 81～BF)
+        dst[0] = (char)0xef; dst[1] = (char)0xbc; dst[2] = (char)(c + 0x60);
+        return 3;
+    }
+    if (c >= 0x60 && c <= 0x7e) {
+        // U+FF40～U+FF5E (EF BD 80～9E)
+        dst[0] = (char)0xef; dst[1] = (char)0xbd; dst[2] = (char)(c + 0x20);
+        return 3;
+    }
+    dst[0] = (char)c;
+    return 1;
+}
+
+//
+// ひらがな⇒カタカナ一括変換
+//  U+3041～U+3093 を U+30A1～U+30F3 に変換する(いずれも E3 xx xx の3バイト)
+//  引数
+//   dst:     変換先(src_len+1 バイト以上。dst==src 可)
+//   src:     変換元UTF8文字列
+//   src_len: src のバイト数
+//  戻り値
+//   カタカナに変換した文字数
+//
+uint32_t JString::hira_to_kata(char* dst, const char* src, uint32_t src_len) {
+    uint32_t pos = 0;
+    uint32_t rc = 0;
+
+    while (pos < src_len) {
+        // E3 を含まないワードはそのままコピー
+        if (pos + JW_SIZE <= src_len) {
+            jword_t w = load_word(src + pos);
+            if (!has_byte(w, 0xe3)) {
+                memcpy(dst + pos, &w, JW_SIZE);
+                pos += JW_SIZE;
+                continue;
+            }
+        }
+        uint8_t c = src[pos];
+        if (c == 0xe3 && pos + 2 < src_len) {
+            uint8_t c1 = src[pos+1];
+            uint8_t c2 = src[pos+2];
+            if (c1 == 0x81 && c2 >= 0x81 && c2 <= 0x9f) {          // ぁ～た → ァ～タ
+                c1 = 0x82; c2 += 0x20; rc++;
+            } else if (c1 == 0x81 && c2 >= 0xa0 && c2 <= 0xbf) {   // だ～み → ダ～ミ
+                c1 = 0x83; c2 -= 0x20; rc++;
+            } else if (c1 == 0x82 && c2 >= 0x80 && c2 <= 0x93) {   // む～ん → ム～ン
+                c1 = 0x83; c2 += 0x20; rc++;
+            }
+            dst[pos]   = (char)c;
+            dst[pos+1] = (char)c1;
+            dst[pos+2] = (char)c2;
+            pos += 3;
+            continue;
+        }
+        dst[pos++] = (char)c;
+    }
+    dst[pos] = '\0';
+    return rc;
+}
+
+//
+// カタカナ⇒ひらがな一括変換
+//  U+30A1～U+30F3 を U+3041～U+3093 に変換する
+//  引数
+//   dst:     変換先(src_len+1 バイト以上。dst==src 可)
+//   src:     変換元UTF8文字列
+//   src_len: src のバイト数
+//  戻り値
+//   ひらがなに変換した文字数
+//
+uint32_t JString::kata_to_hira(char* dst, const char* src, uint32_t src_len) {
+    uint32_t pos = 0;
+    uint32_t rc = 0;
+
+    while (pos < src_len) {
+        // E3 を含まないワードはそのままコピー
+        if (pos + JW_SIZE <= src_len) {
+            jword_t w = load_word(src + pos);
+            if (!has_byte(w, 0xe3)) {
+                memcpy(dst + pos, &w, JW_SIZE);
+                pos += JW_SIZE;
+                continue;
+            }
+        }
+        uint8_t c = src[pos];
+        if (c == 0xe3 && pos + 2 < src_len) {
+            uint8_t c1 = src[pos+1];
+            uint8_t c2 = src[pos+2];
+            if (c1 == 0x82 && c2 >= 0xa1 && c2 <= 0xbf) {          // ァ～タ → ぁ～た
+                c1 = 0x81; c2 -= 0x20; rc++;
+            } else if (c1 == 0x83 && c2 >= 0x80 && c2 <= 0x9f) {   // ダ～ミ → だ～み
+                c1 = 0x81; c2 += 0x20; rc++;
+            } else if (c1 == 0x83 && c2 >= 0xa0 && c2 <= 0xb3) {   // ム～ン → む～ん
+                c1 = 0x82; c2 -= 0x20; rc++;
+            }
+            dst[pos]   = (char)c;
+            dst[pos+1] = (char)c1;
+            dst[pos+2] = (char)c2;
+            pos += 3;
+            continue;
+        }
+        dst[pos++] = (char)c;
+    }
+    dst[pos] = '\0';
+    return rc;
+}
+
+//
+// 半角⇒全角一括変換
+//  0x21～0x7e を U+FF01～U+FF5E、空白を U+3000 に変換する
+//  引数
+//   dst:     変換先(src_len*3+1 バイト以上)
+//   src:     変換元UTF8文字列
+//   src_len: src のバイト数
+//  戻り値
+//   dst に格納したバイト数
+//
+uint32_t JString::ascii_to_zen(char* dst, const char* src, uint32_t src_len) {
+    uint32_t pos = 0;
+    uint32_t out = 0;
+
+    while (pos < src_len) {
+        if (pos + JW_SIZE <= src_len) {
+            jword_t w = load_word(src + pos);
+            jword_t h = w & JW_HIGHS;
+            if (h == JW_HIGHS) {
+                // ASCIIを含まないワードはそのままコピー
+                memcpy(dst + out, &w, JW_SIZE);
+                out += JW_SIZE;
+                pos += JW_SIZE;
+                continue;
+            }
+            if (h == 0) {
+                // ASCIIのみのワードは判定なしで展開
+                for (uint8_t i = 0; i < JW_SIZE; i++)
+                    out += put_zen(dst + out, (uint8_t)src[pos + i]);
+                pos += JW_SIZE;
+                continue;
+            }
+        }
+        uint8_t c = src[pos++];
+        if (c < 0x80)
+            out += put_zen(dst + out, c);
+        else
+            dst[out++] = (char)c;
+    }
+    dst[out] = '\0';
+    return out;
+}
+
+//
+// 全角⇒半角一括変換
+//  U+FF01～U+FF5E を 0x21～0x7e、U+3000 を空白に変換する
+//  引数
+//   dst:     変換先(src_len+1 バイト以上。dst==src 可)
+//   src:     変換元UTF8文字列
+//   src_len: src のバイト数
+//  戻り値
+//   dst に格納したバイト数
+//
+uint32_t JString::zen_to_ascii(char* dst, const char* src, uint32_t src_len) {
+    uint32_t pos = 0;
+    uint32_t out = 0;
+
+    while (pos < src_len) {
+        // EF, E3 を含まないワードはそのままコピー
+        if (pos + JW_SIZE <= src_len) {
+            jword_t w = load_word(src + pos);
+            if (!has_byte(w, 0xef) && !has_byte(w, 0xe3)) {
+                memmove(dst + out, &w, JW_SIZE);
+                out += JW_SIZE;
+                pos += JW_SIZE;
+                continue;
+            }
+        }
+        uint8_t c = src[pos];
+        if ((c == 0xef || c == 0xe3) && pos + 2 < src_len) {
+            uint8_t c1 = src[pos+1];
+            uint8_t c2 = src[pos+2];
+            if (c == 0xef && c1 == 0xbc && c2 >= 0x81 && c2 <= 0xbf) {
+                dst[out++] = (char)(c2 - 0x60);
+            } else if (c == 0xef && c1 == 0xbd && c2 >= 0x80 && c2 <= 0x9e) {
+                dst[out++] = (char)(c2 - 0x20);
+            } else if (c == 0xe3 && c1 == 0x80 && c2 == 0x80) {
+                dst[out++] = ' ';
+            } else {
+                dst[out++] = (char)c;
+                dst[out++] = (char)c1;
+                dst[out++] = (char)c2;
+            }
+            pos += 3;
+            continue;
+        }
+        dst[out++] = (char)c;
+        pos++;
+    }
+    dst[out] = '\0';
+    return out;
+}
+
+// 2・3バイト目の範囲の検査が要らない3バイト文字(E1～EC, EE, EF で始まる)か
+static inline bool is_plain3(const uint8_t* p) {
+    uint32_t v = p[0] | p[1] << 8 | (uint32_t)p[2] << 16;
+    return (v & 0xc0c0f0) == 0x8080e0 && !((0x2001 >> (v & 0x0f)) & 1);   // E0, ED を除く
+}
+
+//
+// 検証付きUTF8文字数カウント
+//  過剰表現、サロゲート、U+10FFFF 超、途中で切れた文字を不正とする
+//  ASCIIのみのワードはワード単位で数え、範囲の検査が要らない3バイト文字は1回の比較で検証する
+//  引数
+//   src:     UTF8文字列
+//   src_len: src のバイト数
+//  戻り値
+//   文字数(不正なUTF8の場合は -1)
+//
+int32_t JString::count_chars(const char* src, uint32_t src_len) {
+    const uint8_t* s = (const uint8_t*)src;
+    uint32_t pos = 0;
+    int32_t  cnt = 0;
+
+    while (pos < src_len) {
+        uint8_t c = s[pos];
+        if (c < 0x80) {
+            // ASCIIが続けばワード単位で数える
+            if (pos + JW_SIZE <= src_len && (load_word(src + pos) & JW_HIGHS) == 0) {
+                cnt += JW_SIZE;
+                pos += JW_SIZE;
+            } else {
+                cnt++;
+                pos++;
+            }
+            continue;
+        }
+        // かな・漢字(E1～EC, EE, EF で始まる3バイト)が続く間は、1文字を1回のマスク比較で検証する
+        //  (E0, ED は2バイト目の範囲が狭いので下の一般の検査に回す)
+        if (pos + 3 <= src_len && is_plain3(s + pos)) {
+            cnt++;
+            pos += 3;
+            // 2文字(6バイト)ずつ、次に1文字ずつ
+            while (pos + 6 <= src_len && is_plain3(s + pos) && is_plain3(s + pos + 3)) {
+                cnt += 2;
+                pos += 6;
+            }
+            while (pos + 3 <= src_len && is_plain3(s + pos)) {
+                cnt++;
+                pos += 3;
+            }
+            continue;
+        }
+        uint8_t n = utf8_nbytes(c);
+        if (n < 2 || c < 0xc2 || pos + n > src_len)
+            return -1;
+
+        // 2バイト目の範囲
+        uint8_t lo = 0x80, hi = 0xbf;
+        if      (c == 0xe0) lo = 0xa0;    // 過剰表現
+        else if (c == 0xed) hi = 0x9f;    // サロゲート
+        else if (c == 0xf0) lo = 0x90;    // 過剰表現
+        else if (c == 0xf4) hi = 0x8f;    // U+10FFFF 超
+        if (s[pos+1] < lo || s[pos+1] > hi)
+            return -1;
+        for (uint8_t i = 2; i < n; i++) {
+            if ((s[pos+i] & 0xc0) != 0x80)
+                return -1;
+        }
+        cnt++;
+        pos += n;
+    }
+    return cnt;
+}
@@ -16,5 +16,29 @@ class JString {
     static uint32_t utf8to32(char* src);                                     // utf8 1文字をutf32に変換する
     static uint8_t  utf32to8(char* dst, uint32_t code);                      // utf32 1文字をutf8 1文字に変換する
     static uint16_t roma_to_kana(char* dst, char* src);                      // ローマ字かな変換
+
+    // 長さ指定版(src_lenバイトのみ参照し、'\0'終端を必要としない)
+    static uint16_t bytes(const char* text, uint16_t text_len);              // 文字列バイト数の取得(最大text_lenバイト)
+    static uint16_t len(const char* text, uint16_t text_len);                // UTF8文字(1～4バイト)の文字数をカウントする
+    static uint16_t get(char *dst, const char *src, uint16_t src_len);       // 先頭からの1文字取得
+    static uint32_t utf8to32(const char* src, uint16_t src_len);             // utf8 1文字をutf32に変換する
+    static uint16_t roma_to_kana(char* dst, const char* src, uint16_t src_len,
+                                 uint16_t* dst_len = NULL);                  // ローマ字かな変換(dst_len:変換後バイト数)
+    static uint16_t roma_to_sjis(char* dst, const char* src, uint16_t src_len,
+                                 uint16_t* dst_len = NULL);                  // ローマ字かな変換(Shift-JIS出力)
+    static uint8_t  sjis_spellings(const char* kana, uint16_t kana_len,
+                                   const char** out, uint8_t max);           // かな(Shift-JIS)のローマ字綴りの取得
+
+    // 一括変換(UTF8のバイトパターンを直接書き換える。1文字毎のデコード/エンコードを行わない)
+    static uint32_t hira_to_kata(char* dst, const char* src, uint32_t src_len);  // ひらがな⇒カタカナ(変換文字数を返す)
+    static uint32_t kata_to_hira(char* dst, const char* src, uint32_t src_len);  // カタカナ⇒ひらがな(変換文字数を返す)
+    static uint32_t ascii_to_zen(char* dst, const char* src, uint32_t src_len);  // 半角英数記号⇒全角(出力バイト数を返す)
+    static uint32_t zen_to_ascii(char* dst, const char* src, uint32_t src_len);  // 全角英数記号⇒半角(出力バイト数を返す)
+    static int32_t  count_chars(const char* src, uint32_t src_len);              // 検証付きUTF8文字数カウント(不正時は-1)
+
+  private:
+    static uint16_t roma_convert(char* dst, const char* src, uint16_t src_len, uint16_t* dst_len,
+                                 const char* const* table, const char* hatsuon,
+                                 const char* sokuon);                        // ローマ字かな変換の本体
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,447 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ime_app.h"
+#include "draw_font.h"
+#include "ime_glyph.h"
+#include "profiler.h"
+#include "skk_async.h"
+
+#define RGB555(r,g,b) ((uint16_t)((r) | ((g) << 5) | ((b) << 10)))   // Same as libnds RGB15()
+
+void ImeApp::init(const Platform& platform, SKK* skk, SKKAsync* async, bool dev_buttons) {
+    m_platform = platform;
+    m_async = async;
+    m_core.init(skk, async);
+    m_dev_buttons = dev_buttons;
+    m_show_hud = false;
+    m_recording = false;
+    m_doc.init(platform.storage, platform.clock);
+    m_idle_frames = 0;
+    m_save_failed = false;
+    m_queue.clear();
+    m_redraw = true;
+    m_layout_arena.init(m_layout_mem, sizeof(m_layout_mem));
+    m_layout.init(&m_layout_arena, IME_APP_TEXT_RIGHT - IME_APP_TEXT_X, fontWidth);
+    m_layout_valid = false;
+    m_top_line = 0;
+    m_shown_preedit_len = 0;
+}
+
+bool ImeApp::frame() {
+    uint32_t frame_start = m_platform.clock->now_us();
+    prof_begin(PROF_INPUT);
+    bool alive = m_platform.input->fill(&m_queue);
+    if (!alive && m_queue.empty()) {
+        prof_end(PROF_INPUT);
+        return false;
+    }
+    if (m_recording && m_queue.empty()) {
+        ImeInput idle = {};
+        imeTrace_record(&m_trace, &idle);
+    }
+    m_idle_frames = m_queue.empty() ? m_idle_frames + 1 : 0;
+    prof_end(PROF_INPUT);
+
+    if (!drain()) {
+        close_document();
+        return false; // Exit main loop
+    }
+
+    // All events of the frame are coalesced into one conversion and one render;
+    // frames that changed nothing are not redrawn (the HUD changes every frame)
+    if (m_async)
+        m_core.poll_lookup();   // Candidates that arrived since the last frame
+    m_core.refresh();
+    if (m_redraw || m_show_hud || m_core.revision() != m_drawn_revision)
+        render();
+    if (m_async)
+        pump_lookups(frame_start);
+    if (m_doc.needs_flush() && m_idle_frames >= IME_APP_SAVE_IDLE_FRAMES)
+        autosave(frame_start);
+    prof_frame_end();
+    return alive;
+}
+
+// Without a worker thread, lookups run after the preedit is on screen, in the time left
+// in the frame (at least one per frame so that a slow lookup still completes)
+void ImeApp::pump_lookups(uint32_t frame_start) {
+    prof_begin(PROF_LOOKUP);
+    while (m_async->pump(1) > 0) {
+        if (m_platform.clock->now_us() - frame_start >= IME_APP_LOOKUP_BUDGET_US)
+            break;
+    }
+    m_async->dispatch();
+    prof_end(PROF_LOOKUP);
+}
+
+// Write-behind: dirty chunks of the document (or its journal) are written in frames after
+// typing paused, in the time left in the frame (at least one piece per frame)
+void ImeApp::autosave(uint32_t frame_start) {
+    prof_begin(PROF_SAVE);
+    bool ok;
+    while ((ok = m_doc.flush_step(m_core.text())) && m_doc.needs_flush()) {
+        if (m_platform.clock->now_us() - frame_start >= IME_APP_SAVE_BUDGET_US)
+            break;
+    }
+    if (!ok && !m_save_failed)   // Retried on later frames; reported once
+        m_platform.storage->log("Autosave failed");
+    m_save_failed = !ok;
+    prof_end(PROF_SAVE);
+}
+
+bool ImeApp::open_document(const char* path, const char* journal_path) {
+    close_document();
+    if (!m_doc.open(path, m_core.load_text(), journal_path))
+        return false;
+    m_layout_valid = false;
+    return true;
+}
+
+bool ImeApp::close_document() {
+    if (!m_doc.is_open())
+        return true;
+    ImeTextChange change;
+    if (m_core.take_text_change(&change)) { // Edits not rendered yet
+        m_doc.edited(change, m_core.text());
+        m_layout_valid = false;
+    }
+    return m_doc.close(m_core.text());
+}
+
+void ImeApp::settle() {
+    m_core.settle();
+    if (m_core.revision() != m_drawn_revision)
+        render();
+}
+
+// Process the queued events; false when START was pressed
+bool ImeApp::drain() {
+    ImeInput in;
+    while (m_queue.pop(&in)) {
+        if (m_dev_buttons)
+            handle_dev_buttons(in);
+        if (m_recording)
+            imeTrace_record(&m_trace, &in);   // One trace frame per event
+        if (!m_core.feed(in)) {
+            m_queue.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ImeApp::inject(const char* text) {
+    for (const char* p = text; *p; p++) {
+        if (m_queue.full() && !drain())
+            return false;
+        m_queue.push_key((uint8_t)*p);
+    }
+    if (!drain())
+        return false;
+    m_core.refresh();
+    render();
+    return true;
+}
+
+// Development functions handled outside the core (the core ignores these buttons)
+void ImeApp::handle_dev_buttons(const ImeInput& in) {
+    if (in.buttons & (IME_BTN_L | IME_BTN_X))
+        m_redraw = true;
+    if (in.buttons & IME_BTN_L) { // Toggle the profiler HUD
+        m_show_hud = !m_show_hud;
+    } else if (in.buttons & IME_BTN_R) { // Dump profiler data for offline analysis
+        static char csv[PROF_WINDOW * 64]; // 4 KB: too large for the ARM9 stack in DTCM
+        uint32_t len = prof_dump(csv, sizeof(csv));
+        if (len == 0 || !m_platform.storage->write_file(IME_APP_PROF_FILE, csv, len))
+            m_platform.storage->log("Profiler dump failed");
+    } else if (in.buttons & IME_BTN_X) { // Start / stop input trace recording
+        toggle_trace();
+    }
+}
+
+// Start recording, or stop and write the trace for tools/ime_replay
+void ImeApp::toggle_trace() {
+    if (!m_recording) {
+        imeTrace_begin(&m_trace, m_trace_buf, sizeof(m_trace_buf));
+        m_recording = true;
+        return;
+    }
+    m_recording = false;
+    uint32_t len = imeTrace_finish(&m_trace);
+    char msg[64];
+    if (len > 0 && m_platform.storage->write_file(IME_APP_TRACE_FILE, m_trace_buf, len))
+        snprintf(msg, sizeof(msg), "Trace saved (%lu bytes)", (unsigned long)len);
+    else
+        snprintf(msg, sizeof(msg), "Trace save failed");
+    m_platform.storage->log(msg);
+}
+
+// Draw glyph codes (they index the font directly); returns the x after the text
+int ImeApp::draw_glyphs(int x, int y, const uint16_t* text, int len, uint16_t color) {
+    uint16_t* buffer = m_platform.fb->pixels();
+    for (int i = 0; i < len; i++) {
+        x += drawFont(x, y, buffer, text[i], color);
+    }
+    return x;
+}
+
+// Helper function to draw a 0-terminated glyph string
+int ImeApp::draw_text(int x, int y, const uint16_t* text, uint16_t color) {
+    uint16_t* buffer = m_platform.fb->pixels();
+    for (int i = 0; text[i] != 0; i++) {
+        x += drawFont(x, y, buffer, text[i], color);
+    }
+    return x;
+}
+
+// Helper function to draw a label (Shift-JIS or ASCII bytes)
+int ImeApp::draw_string(int x, int y, const char* str, uint16_t color) {
+    uint16_t display_buffer[128];
+    imeGlyph_fromSjis(display_buffer, 128, str, strlen(str));
+    return draw_text(x, y, display_buffer, color);
+}
+
+// Draw the per-phase profiler statistics (microseconds, last PROF_WINDOW frames)
+void ImeApp::draw_hud(int y) {
+    char line[64];
+    ProfStats st;
+    for (int p = 0; p < PROF_PHASE_COUNT; p++) {
+        prof_get((ProfPhase)p, &st);
+        sprintf(line, "%-6s%5lu%5lu%6lu", prof_phase_name((ProfPhase)p),
+                (unsigned long)st.min, (unsigned long)st.avg, (unsigned long)st.max);
+        draw_string(10, y + p * 10, line, RGB555(31,31,0));
+    }
+}
+
+void ImeApp::clear_rect(int x, int y, int w, int h) {
+    uint16_t* p = m_platform.fb->pixels() + y * PLATFORM_FB_WIDTH + x;
+    for (int i = 0; i < h; i++, p += PLATFORM_FB_WIDTH)
+        memset(p, 0, w * sizeof(uint16_t));
+}
+
+void ImeApp::blit_rows(int dst_y, int src_y, int h) {
+    uint16_t* pixels = m_platform.fb->pixels();
+    memmove(pixels + dst_y * PLATFORM_FB_WIDTH, pixels + src_y * PLATFORM_FB_WIDTH,
+            h * PLATFORM_FB_WIDTH * sizeof(uint16_t));
+}
+
+// The committed text with the preedit inserted at the cursor, as laid out on screen
+class DisplayText : public ImeLayoutSource {
+ public:
+    DisplayText(const ImeText& text, const uint16_t* preedit, uint32_t preedit_len)
+        : m_text(text), m_preedit(preedit), m_preedit_len(preedit_len) {}
+    uint32_t length() const { return m_text.length() + m_preedit_len; }
+    uint16_t glyph(uint32_t pos) const {
+        uint32_t cursor = m_text.cursor();
+        if (pos < cursor)
+            return m_text.at(pos);
+        if (pos < cursor + m_preedit_len)
+            return m_preedit[pos - cursor];
+        return m_text.at(pos - m_preedit_len);
+    }
+ private:
+    const ImeText&  m_text;
+    const uint16_t* m_preedit;
+    uint32_t        m_preedit_len;
+};
+
+// Draw one line of the text area into its slot, with the caret when it is on the line
+void ImeApp::draw_line(int slot, uint32_t line, const ImeLayoutSource& src, uint32_t caret) {
+    int y = IME_APP_TEXT_Y + slot * IME_APP_LINE_H;
+    clear_rect(0, y, PLATFORM_FB_WIDTH, IME_APP_LINE_H);
+    if (line >= m_layout.lines())
+        return;
+    uint16_t* buffer = m_platform.fb->pixels();
+    uint32_t pos = m_layout.line_start(line);
+    uint32_t end = pos + m_layout.line_length(line);
+    int x = IME_APP_TEXT_X;
+    int caret_x = -1;
+    for (; pos < end; pos++) {
+        uint16_t g = src.glyph(pos);
+        if (pos == caret)
+            caret_x = x;
+        if (g != '\n')
+            x += drawFont(x, y, buffer, g, RGB555(31,31,31));
+    }
+    if (line == m_caret_line && caret_x < 0)
+        caret_x = x;    // Caret after the last glyph
+    if (caret_x >= 0) {
+        uint16_t* p = buffer + y * PLATFORM_FB_WIDTH + caret_x - 1;
+        for (int i = 0; i < IME_APP_LINE_H - 1; i++, p += PLATFORM_FB_WIDTH)
+            *p = RGB555(31,31,0);
+    }
+}
+
+// Map a line of the current layout to the line it was before the changes of this render
+uint32_t ImeApp::old_line(uint32_t line, const ImeLayoutChange* changes, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        if (line < changes[i].first)
+            continue;
+        if (line < changes[i].new_end)
+            return UINT32_MAX;      // Re-wrapped
+        line = line - changes[i].new_end + changes[i].old_end;
+    }
+    return line;
+}
+
+// Draw the committed text with the preedit at the cursor over IME_APP_TEXT_LINES lines.
+// Only the lines re-wrapped by the layout and the lines with the caret are drawn; lines
+// that only moved (scrolling, lines inserted or removed above them) are copied on screen.
+void ImeApp::render_text() {
+    const ImeText& text = m_core.text();
+    const uint16_t* preedit = m_core.preedit();
+    uint32_t preedit_len = m_core.preedit_len();
+    uint32_t cursor = text.cursor();
+    uint32_t caret = cursor + preedit_len;
+    DisplayText src(text, preedit, preedit_len);
+    ImeTextChange change;
+    bool changed = m_core.take_text_change(&change);
+    if (changed && m_doc.is_open())
+        m_doc.edited(change, m_core.text());
+    bool preedit_changed = preedit_len != m_shown_preedit_len ||
+        memcmp(preedit, m_shown_preedit, preedit_len * sizeof(uint16_t)) != 0;
+    ImeLayoutChange changes[IME_APP_TEXT_LINES + 2];
+    int nchanges = 0;
+    bool full = !m_layout_valid;
+
+    if (full) {
+        m_layout.reset(src);
+    } else if (changed || preedit_changed || (cursor != m_shown_cursor && preedit_len + m_shown_preedit_len > 0)) {
+        // The display text changed between the first glyph that differs and a tail that is
+        // the same in both: text changes and both preedit positions lie in between
+        uint32_t f = changed ? change.from : cursor;
+        uint32_t t = changed ? change.to : cursor;
+        int32_t  d = changed ? change.delta : 0;
+        uint32_t from = f < cursor ? f : cursor;
+        if (m_shown_cursor < from)
+            from = m_shown_cursor;
+        uint32_t end_new = t;
+        uint32_t end_old = t - d;
+        if (cursor > end_new) {
+            end_new = cursor;
+            end_old = cursor - d;
+        }
+        if (m_shown_cursor > end_old) {
+            end_old = m_shown_cursor;
+            end_new = m_shown_cursor + d;
+        }
+        m_layout.edit(src, from, end_old + m_shown_preedit_len, end_new + preedit_len,
+                      IME_APP_TEXT_LINES + 1, &changes[nchanges++]);
+    } else if (caret == m_shown_caret) {
+        return;             // The text area on screen is up to date
+    }
+
+    // Scroll to the caret, re-wrapping the stale lines that come into view
+    uint32_t top = m_top_line;
+    for (;;) {
+        uint32_t start;
+        m_caret_line = m_layout.line_of(caret, &start);
+        if (m_caret_line < top)
+            top = m_caret_line;
+        else if (m_caret_line >= top + IME_APP_TEXT_LINES)
+            top = m_caret_line - IME_APP_TEXT_LINES + 1;
+        uint32_t stale = top;
+        while (stale < top + IME_APP_TEXT_LINES && !m_layout.line_stale(stale))
+            stale++;
+        if (stale == top + IME_APP_TEXT_LINES || nchanges == IME_APP_TEXT_LINES + 2)
+            break;
+        m_layout.refresh(src, stale, IME_APP_TEXT_LINES + 1, &changes[nchanges++]);
+    }
+
+    if (full)
+        m_platform.fb->clear();
+    int source[IME_APP_TEXT_LINES];     // Slot each line is on now (-1: draw it)
+    for (int slot = 0; slot < IME_APP_TEXT_LINES; slot++) {
+        uint32_t line = top + slot;
+        uint32_t old = full ? UINT32_MAX : old_line(line, changes, nchanges);
+        source[slot] = -1;
+        if (old != UINT32_MAX && old != m_shown_caret_line && line != m_caret_line &&
+            old >= m_top_line && old < m_top_line + IME_APP_TEXT_LINES)
+            source[slot] = old - m_top_line;
+    }
+    // Lines moving up are copied top down, then lines moving down bottom up, so that no
+    // line is overwritten before it is copied
+    for (int slot = 0; slot < IME_APP_TEXT_LINES; slot++) {
+        if (source[slot] > slot)
+            blit_rows(IME_APP_TEXT_Y + slot * IME_APP_LINE_H, IME_APP_TEXT_Y + source[slot] * IME_APP_LINE_H,
+                      IME_APP_LINE_H);
+    }
+    for (int slot = IME_APP_TEXT_LINES - 1; slot >= 0; slot--) {
+        if (source[slot] >= 0 && source[slot] < slot)
+            blit_rows(IME_APP_TEXT_Y + slot * IME_APP_LINE_H, IME_APP_TEXT_Y + source[slot] * IME_APP_LINE_H,
+                      IME_APP_LINE_H);
+    }
+    for (int slot = 0; slot < IME_APP_TEXT_LINES; slot++) {
+        if (source[slot] < 0)
+            draw_line(slot, top + slot, src, caret);
+    }
+
+    m_layout_valid = true;
+    m_top_line = top;
+    m_shown_cursor = cursor;
+    m_shown_caret = caret;
+    m_shown_caret_line = m_caret_line;
+    memcpy(m_shown_preedit, preedit, preedit_len * sizeof(uint16_t));
+    m_shown_preedit_len = preedit_len;
+}
+
+void ImeApp::render() {
+    prof_begin(PROF_DRAW);
+    m_drawn_revision = m_core.revision();
+    m_redraw = false;
+
+    // The text area is updated line by line; everything below it is redrawn every time
+    render_text();
+    clear_rect(0, IME_APP_INFO_Y, PLATFORM_FB_WIDTH, PLATFORM_FB_HEIGHT - IME_APP_INFO_Y);
+
+    // Draw SKK candidates (if any), below the HUD when it is shown
+    int candidate_y = IME_APP_INFO_Y + (m_show_hud ? PROF_PHASE_COUNT * 10 + 10 : 30);
+    for (int i = 0; i < m_core.num_candidates() && candidate_y + i * 10 + 13 <= PLATFORM_FB_HEIGHT; i++) {
+        int len;
+        const uint16_t* text = m_core.candidate_text(i, &len); // Decoded once per lookup
+        if (len > 0) {
+            uint16_t color = RGB555(31,31,31);
+            bool selected = i == m_core.candidate_index();
+            if (selected) {
+                color = RGB555(0,31,0); // Highlight selected candidate
+            }
+            int x = draw_glyphs(10, candidate_y + (i * 10), text, len, color);
+            if (selected) {
+                // Only the selected candidate's annotation is read from the dictionary
+                int annot_len;
+                const uint16_t* annot = m_core.annotation(&annot_len);
+                if (annot_len > 0)
+                    draw_glyphs(x + 6, candidate_y + (i * 10), annot, annot_len, RGB555(16,16,16));
+            }
+        }
+    }
+
+    if (m_show_hud) {
+        // Profiler HUD in place of the debug lines
+        draw_hud(IME_APP_INFO_Y);
+    } else {
+        // Draw debug info
+        char debug_str[80];
+        const char* mode_prompt = "";
+        switch (m_core.mode()) {
+            case IME_MODE_HIRAGANA: mode_prompt = "HIRAGANA: "; break;
+            case IME_MODE_KATAKANA: mode_prompt = "KATAKANA: "; break;
+            case IME_MODE_ENGLISH:  mode_prompt = "ENGLISH:  ";  break;
+            case IME_MODE_DEBUG:    mode_prompt = "DEBUG:    ";    break;
+            case IME_MODE_ABBREV:   mode_prompt = "ABBREV:   ";   break;
+        }
+
+        sprintf(debug_str, "%s%sRomaji: %s", m_recording ? "REC " : "", mode_prompt, m_core.romaji());
+        draw_string(10, IME_APP_INFO_Y, debug_str, RGB555(31,31,31));
+
+        int list_x = draw_string(10, IME_APP_INFO_Y + 10, "SKK List: ", RGB555(31,31,31));
+        draw_text(list_x, IME_APP_INFO_Y + 10, m_core.candidate_list(), RGB555(31,31,31));
+
+        sprintf(debug_str, "SKK Num: %d, Idx: %d", m_core.num_candidates(), m_core.candidate_index());
+        draw_string(10, IME_APP_INFO_Y + 20, debug_str, RGB555(31,31,31));
+    }
+
+    m_platform.fb->present();
+    prof_end(PROF_DRAW);
+}
@@ -0,0 +1,96 @@
+//
+// IME application: one frame = poll input, update ImeCore, render
+//  Runs on any Platform (platform_nds.h on the DS, platform_linux.h on a workstation).
+//
+#ifndef IME_APP_H
+#define IME_APP_H
+
+#include "ime_core.h"
+#include "ime_document.h"
+#include "ime_layout.h"
+#include "ime_trace.h"
+#include "platform.h"
+
+#define IME_APP_PROF_FILE   "/nds_skk_prof.csv"   // Profiler dump written with the R button
+#define IME_APP_TRACE_FILE  "/nds_skk_trace.bin"  // Input trace written when recording stops (X button)
+#define IME_APP_TRACE_SIZE  (64 * 1024)           // Trace recording buffer
+#define IME_APP_DOC_FILE    "/nds_skk_doc.txt"    // Committed text, loaded at start and autosaved (Shift-JIS)
+#define IME_APP_JOURNAL_FILE "/nds_skk_doc.jnl"   // Edits of the document since its last checkpoint
+#define IME_APP_LOOKUP_BUDGET_US 14000            // Async lookups run until this much of the 16.7 ms frame is used
+#define IME_APP_SAVE_BUDGET_US   14000            // Autosave writes chunks until this much of the frame is used
+#define IME_APP_SAVE_IDLE_FRAMES 30               // Autosave starts after this many frames without input
+
+// Text area: the committed text with the preedit at the cursor, wrapped into lines
+#define IME_APP_TEXT_X      10
+#define IME_APP_TEXT_Y      10
+#define IME_APP_TEXT_RIGHT  246                   // Lines wrap before this x
+#define IME_APP_LINE_H      13                    // Rows per line (tallest glyph)
+#define IME_APP_TEXT_LINES  6
+#define IME_APP_INFO_Y      (IME_APP_TEXT_Y + IME_APP_TEXT_LINES * IME_APP_LINE_H + 7) // Debug lines / HUD
+#define IME_APP_LAYOUT_ARENA (64 * 1024)          // Line table of the layout
+
+class ImeApp {
+ public:
+	// async: run dictionary lookups on it (a thread, or the end of each frame without threads)
+	// dev_buttons: handle L (profiler HUD), R (profiler dump) and X (trace recording)
+	void init(const Platform& platform, SKK* skk, SKKAsync* async = NULL, bool dev_buttons = true);
+	bool frame();                                 // false when START was pressed or input ended
+	bool inject(const char* text);               // Type a romaji string through the pipeline, one render at the end
+	void settle();                                // Wait for pending lookups and redraw
+	// Load the text from path and autosave it there (through a journal at journal_path if given)
+	bool open_document(const char* path, const char* journal_path = NULL);
+	bool close_document();                        // Save the rest now and close (also done on START)
+
+	uint32_t dropped_inputs() const { return m_queue.dropped(); }
+
+	const ImeCore& core() const { return m_core; }
+	const ImeDocument& document() const { return m_doc; }
+	void set_hud(bool show) { m_show_hud = show; }
+
+ private:
+	bool drain();
+	void handle_dev_buttons(const ImeInput& in);
+	void toggle_trace();
+	void pump_lookups(uint32_t frame_start);
+	void autosave(uint32_t frame_start);
+	void render();
+	void render_text();
+	void draw_line(int slot, uint32_t line, const ImeLayoutSource& src, uint32_t caret);
+	static uint32_t old_line(uint32_t line, const ImeLayoutChange* changes, int count);
+	void clear_rect(int x, int y, int w, int h);
+	void blit_rows(int dst_y, int src_y, int h);
+	void draw_hud(int y);
+	int  draw_text(int x, int y, const uint16_t* text, uint16_t color);
+	int  draw_glyphs(int x, int y, const uint16_t* text, int len, uint16_t color);
+	int  draw_string(int x, int y, const char* str, uint16_t color);
+
+	Platform       m_platform;
+	ImeCore        m_core;
+	SKKAsync*      m_async;
+	ImeInputQueue  m_queue;
+	uint32_t       m_drawn_revision; // ImeCore::revision() shown on screen
+	bool           m_redraw;         // App state shown on screen changed
+	bool           m_dev_buttons;
+	bool           m_show_hud;       // Profiler HUD instead of the debug lines (L button)
+	bool           m_recording;      // Recording an input trace (X button)
+	ImeDocument    m_doc;
+	uint32_t       m_idle_frames;    // Frames since the last input event
+	bool           m_save_failed;    // The last autosave write failed (reported)
+
+	// Text area as drawn, so that only changed lines are redrawn
+	ImeLayout      m_layout;
+	ImeArena       m_layout_arena;
+	uint32_t       m_layout_mem[IME_APP_LAYOUT_ARENA / 4];
+	bool           m_layout_valid;   // m_layout and the screen match the fields below
+	uint32_t       m_top_line;       // Line in the first slot
+	uint32_t       m_caret_line;
+	uint32_t       m_shown_cursor;   // ImeText cursor
+	uint32_t       m_shown_caret;    // Caret position in the laid out text (after the preedit)
+	uint32_t       m_shown_caret_line;
+	uint16_t       m_shown_preedit[IME_TEXT_MAX];
+	uint32_t       m_shown_preedit_len;
+	ImeTraceWriter m_trace;
+	uint8_t        m_trace_buf[IME_APP_TRACE_SIZE];
+};
+
+#endif // IME_APP_H
@@ -0,0 +1,38 @@
+#include <string.h>
+
+#include "ime_arena.h"
+
+void ImeArena::init(void* mem, uint32_t size) {
+    m_base = (uint8_t*)mem;
+    m_size = size;
+    m_top = 0;
+    memset(m_free, 0, sizeof(m_free));
+}
+
+void* ImeArena::alloc(uint32_t size, uint32_t* got) {
+    uint32_t shift = IME_ARENA_MIN_SHIFT;
+    while ((1u << shift) < size) {
+        if (++shift >= 31)
+            return NULL;
+    }
+    uint32_t block = 1u << shift;
+    void* p = m_free[shift];
+    if (p != NULL) {
+        m_free[shift] = *(void**)p;
+    } else {
+        if (block > m_size - m_top)
+            return NULL;
+        p = m_base + m_top;
+        m_top += block;
+    }
+    *got = block;
+    return p;
+}
+
+void ImeArena::free(void* block, uint32_t size) {
+    uint32_t shift = IME_ARENA_MIN_SHIFT;
+    while ((1u << shift) < size)
+        shift++;
+    *(void**)block = m_free[shift];
+    m_free[shift] = block;
+}
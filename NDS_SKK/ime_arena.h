@@ -0,0 +1,30 @@
+//
+// IME memory arena: growable buffers without the C heap
+//  Blocks are powers of two (at least IME_ARENA_MIN_BLOCK bytes) carved from one fixed region.
+//  A freed block goes on the free list of its size and is reused before new space is taken,
+//  so a buffer that doubles as it grows costs at most twice its final size.
+//
+#ifndef IME_ARENA_H
+#define IME_ARENA_H
+
+#include <stdint.h>
+
+#define IME_ARENA_MIN_SHIFT 8                          // Smallest block: 256 bytes
+#define IME_ARENA_MIN_BLOCK (1u << IME_ARENA_MIN_SHIFT)
+
+class ImeArena {
+ public:
+	void     init(void* mem, uint32_t size);           // mem must be 4-byte aligned
+	void*    alloc(uint32_t size, uint32_t* got);      // NULL when exhausted; *got is the block size
+	void     free(void* block, uint32_t size);         // size as returned in *got
+	uint32_t used() const { return m_top; }            // Bytes carved so far (free blocks included)
+	uint32_t capacity() const { return m_size; }
+
+ private:
+	uint8_t* m_base;
+	uint32_t m_size;
+	uint32_t m_top;
+	void*    m_free[32];                               // Free blocks by size shift, linked through their first word
+};
+
+#endif // IME_ARENA_H
@@ -0,0 +1,566 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ime_core.h"
+#include "ime_glyph.h"
+#include "romakana_map.h"
+#include "skk.h"
+#include "skk_async.h"
+#include "profiler.h"
+
+// Longest romakana_map entry at the start of romaji; returns its length (0: no match)
+static int match_romaji(const char* romaji, int len, uint16_t* sjis) {
+    int best_match_len = 0;
+    for (int i = 0; romakana_map[i].romaji != NULL; i++) {
+        int romaji_len = strlen(romakana_map[i].romaji);
+        if (romaji_len > best_match_len && romaji_len <= len &&
+            strncmp(romaji, romakana_map[i].romaji, romaji_len) == 0)
+        {
+            best_match_len = romaji_len;
+            *sjis = romakana_map[i].sjis_code;
+        }
+    }
+    return best_match_len;
+}
+
+// Hiragana SJIS bytes of romaji (the dictionary key encoding); -1 when some romaji is left over
+static int romaji_to_sjis(char* dst, int cap, const char* romaji, int len) {
+    int n = 0;
+    for (int pos = 0; pos < len; ) {
+        uint16_t sjis;
+        int match = match_romaji(&romaji[pos], len - pos, &sjis);
+        if (match == 0 || n + 2 > cap)
+            return -1;
+        dst[n++] = (char)(sjis >> 8);
+        dst[n++] = (char)sjis;
+        pos += match;
+    }
+    return n;
+}
+
+// Romaji for a hiragana SJIS code (the first romakana_map entry, e.g. "nn" for ん)
+static const char* kana_romaji(uint16_t sjis) {
+    for (int i = 0; romakana_map[i].romaji != NULL; i++) {
+        if (romakana_map[i].sjis_code == sjis)
+            return romakana_map[i].romaji;
+    }
+    return NULL;
+}
+
+bool ImeInputQueue::push(const ImeInput& in) {
+    if (full()) {
+        m_dropped++;
+        return false;
+    }
+    m_buf[m_tail++ & (IME_QUEUE_SIZE - 1)] = in;
+    return true;
+}
+
+bool ImeInputQueue::push_key(uint8_t key) {
+    ImeInput in = {};
+    in.key = key;
+    return push(in);
+}
+
+bool ImeInputQueue::pop(ImeInput* in) {
+    if (empty())
+        return false;
+    *in = m_buf[m_head++ & (IME_QUEUE_SIZE - 1)];
+    return true;
+}
+
+void ImeCore::init(SKK* skk, SKKAsync* async) {
+    m_skk = skk;
+    m_async = async;
+    m_lookup_ticket = 0;
+    m_prefetch_enabled = true;
+    m_fuzzy = IME_FUZZY_DISTANCE;
+    m_prefetch_base_len = -1;
+    m_prefetch_count = 0;
+    memset(&m_prefetch_stats, 0, sizeof(m_prefetch_stats));
+    m_mode = IME_MODE_HIRAGANA;
+    m_abbrev_from = IME_MODE_HIRAGANA;
+    m_romaji_len = 0;
+    m_romaji[0] = '\0';
+    m_converted_len = 0;
+    m_converted[0] = 0;
+    reset_candidates();
+    m_arena.init(m_arena_mem, sizeof(m_arena_mem));
+    m_text.init(&m_arena);
+    m_dirty = false;
+    m_revision = 0;
+}
+
+// Reset SKK candidates
+void ImeCore::reset_candidates() {
+    cancel_lookup();
+    m_candidate_index = 0;
+    m_num_candidates = 0;
+    m_key_index = -1;
+    m_annot_for = -1;
+    m_kouho_list[0] = '\0';
+    m_okuri[0] = '\0';
+    m_list_len = 0;
+    m_list[0] = 0;
+}
+
+// Function to switch input modes. The committed text is the saved document, so it is kept
+void ImeCore::switch_mode() {
+    if (m_mode == IME_MODE_ABBREV)
+        m_mode = m_abbrev_from;
+    m_mode = (ImeMode)((m_mode + 1) % 4);
+    m_romaji_len = 0;
+    m_romaji[0] = '\0';
+    m_converted_len = 0;
+    m_converted[0] = 0;
+    reset_candidates();
+}
+
+// Back to the kana mode abbrev mode was entered from, dropping the reading
+void ImeCore::leave_abbrev() {
+    m_mode = m_abbrev_from;
+    m_romaji_len = 0;
+    m_romaji[0] = '\0';
+    reset_candidates();
+}
+
+// Insert text at the cursor of the committed text (dropped whole when the arena is full)
+void ImeCore::commit(const uint16_t* text, int len) {
+    if (len > 0)
+        m_text.insert(text, len);
+}
+
+const uint16_t* ImeCore::candidate_text(uint16_t index, int* len) const {
+    if (index >= m_num_candidates) {
+        *len = 0;
+        return m_list + m_list_len;
+    }
+    *len = m_cand_start[index + 1] - 1 - m_cand_start[index];
+    return m_list + m_cand_start[index];
+}
+
+int ImeCore::candidate(uint16_t index, uint16_t* dst) const {
+    int len;
+    const uint16_t* text = candidate_text(index, &len);
+    memcpy(dst, text, len * sizeof(uint16_t));
+    dst[len] = 0;
+    return len;
+}
+
+// Decode the candidate list from the dictionary into glyph codes, once per lookup.
+// m_cand_start[i] is where candidate i starts (after the i + 1th ','); a sentinel one past
+// the end of the list keeps candidate_text() branch free.
+void ImeCore::load_candidates() {
+    m_list_len = imeGlyph_fromSjis(m_list, IME_TEXT_MAX, m_kouho_list, sizeof(m_kouho_list));
+    m_num_candidates = 0;
+    m_annot_for = -1;
+    for (int i = 0; i < m_list_len && m_num_candidates < IME_CAND_MAX; i++) {
+        if (m_list[i] == ',')
+            m_cand_start[m_num_candidates++] = i + 1;
+    }
+    m_cand_start[m_num_candidates] = m_list_len + 1;
+}
+
+// The annotation is kept out of the candidate list and looked up by candidate only when that
+// candidate is selected, so lookups never copy or decode it
+const uint16_t* ImeCore::annotation(int* len) {
+    if (m_annot_for != m_candidate_index) {
+        char sjis[IME_ANNOT_MAX * 2];
+        m_annot_len = 0;
+        m_annot[0] = 0;
+        if (m_key_index >= 0 && m_candidate_index < m_num_candidates) {
+            uint16_t n = m_skk->get_annotation(sjis, sizeof(sjis), m_key_index, m_candidate_index);
+            if (n > 0)
+                m_annot_len = imeGlyph_fromSjis(m_annot, IME_ANNOT_MAX, sjis, n);
+        }
+        m_annot_for = m_candidate_index;
+    }
+    *len = m_annot_len;
+    return m_annot;
+}
+
+bool ImeCore::update(const ImeInput& in) {
+    if (!feed(in))
+        return false; // Exit main loop
+    refresh();
+    return true;
+}
+
+// Only the input state is changed here; the conversion is redone once by refresh()
+// after a run of events. Keys that act on the candidates refresh first, so a batch
+// gives the same result as one event per frame.
+bool ImeCore::feed(const ImeInput& in) {
+    if (in.key == 0 && in.buttons == 0)
+        return true;
+    prof_begin(PROF_INPUT);
+
+    // --- Input Handling ---
+    if (in.buttons & IME_BTN_START) {
+        prof_end(PROF_INPUT);
+        return false; // Exit main loop
+    }
+    if ((m_dirty || m_lookup_ticket) &&
+        ((in.buttons & (IME_BTN_UP | IME_BTN_DOWN)) || in.key == '\n' || in.key == ' ')) {
+        prof_end(PROF_INPUT);
+        settle();
+        prof_begin(PROF_INPUT);
+    }
+    invalidate();
+
+    // Mode switching and candidate cycling
+    if (in.buttons & IME_BTN_TOUCH) {
+        if (in.touch_x > (256 - 56) && in.touch_y < 20) {
+            switch_mode();
+        }
+    } else if (in.buttons & IME_BTN_SELECT) {
+        switch_mode();
+    } else if (in.buttons & IME_BTN_UP) { // Cycle through candidates
+        if (m_num_candidates > 0) {
+            m_candidate_index = (m_candidate_index + 1) % m_num_candidates;
+        }
+    } else if (in.buttons & IME_BTN_DOWN) { // Cycle through candidates (reverse)
+        if (m_num_candidates > 0) {
+            m_candidate_index = (m_candidate_index + m_num_candidates - 1) % m_num_candidates;
+        }
+    } else if (in.buttons & (IME_BTN_LEFT | IME_BTN_RIGHT)) { // Move the cursor in the committed text
+        if (m_romaji_len == 0) {
+            m_text.move_cursor((in.buttons & IME_BTN_LEFT) ? -1 : 1);
+        }
+    }
+
+    // --- Character Processing ---
+    int key = in.key;
+    if (key > 0) {
+        if (key == '\b') {
+            if (m_romaji_len > 0) {
+                m_romaji_len--;
+                m_romaji[m_romaji_len] = '\0';
+            } else if (m_mode == IME_MODE_ABBREV) {
+                leave_abbrev();
+            } else {
+                m_text.erase_before(1);
+            }
+            // Reset SKK candidates on backspace
+            reset_candidates();
+        } else if (key == '\n') { // Enter key: commit
+            if (m_num_candidates > 0) { // If SKK candidates exist, commit the selected one
+                int len;
+                const uint16_t* text = candidate_text(m_candidate_index, &len);
+                commit(text, len);
+            } else if (m_converted_len > 0) { // If no SKK candidates, commit romakana conversion
+                commit(m_converted, m_converted_len);
+            } else if (m_romaji_len == 0) { // Nothing to commit: line break
+                m_text.insert((uint16_t)'\n');
+            }
+            // Reset input and candidates after commit
+            m_romaji_len = 0;
+            m_romaji[0] = '\0';
+            reset_candidates();
+            if (m_mode == IME_MODE_ABBREV)
+                leave_abbrev();
+        } else if (key == ' ') { // Space key: advance candidate or commit space
+            if (m_num_candidates > 0) { // If SKK candidates exist, advance to next
+                m_candidate_index = (m_candidate_index + 1) % m_num_candidates;
+            } else if (m_converted_len > 0) { // If no SKK candidates, commit romakana conversion
+                commit(m_converted, m_converted_len);
+                m_text.insert((uint16_t)' '); // Half-width space
+                m_romaji_len = 0;
+                m_romaji[0] = '\0';
+                if (m_mode == IME_MODE_ABBREV)
+                    leave_abbrev();
+            }
+            // Reset candidates after space (unless advancing candidate)
+            if (m_num_candidates == 0) { // Only reset if not advancing candidate
+                reset_candidates();
+            }
+        } else if (key == '/' && m_romaji_len == 0 &&
+                   (m_mode == IME_MODE_HIRAGANA || m_mode == IME_MODE_KATAKANA)) {
+            m_abbrev_from = m_mode; // SKK abbrev: the ASCII that follows is the reading
+            m_mode = IME_MODE_ABBREV;
+            reset_candidates();
+        } else {
+            if (m_mode == IME_MODE_ABBREV && key > ' ' && key < 0x7f) {
+                if (m_romaji_len < 30) {
+                    m_romaji[m_romaji_len++] = (char)key;
+                    m_romaji[m_romaji_len] = '\0';
+                }
+            } else if ((key >= 'a' && key <= 'z') || (key >= 'A' && key <= 'Z') || key == '-' || key == '\'') {
+                if (m_romaji_len < 30) {
+                    m_romaji[m_romaji_len++] = (char)key;
+                    m_romaji[m_romaji_len] = '\0';
+                }
+            } else { // Directly commit other keys as-is (e.g. symbols)
+                m_text.insert((uint16_t)key);
+            }
+            // Reset SKK candidates on new input
+            reset_candidates();
+        }
+    }
+    prof_end(PROF_INPUT);
+    return true;
+}
+
+void ImeCore::refresh() {
+    if (!m_dirty)
+        return;
+    m_dirty = false;
+    m_revision++;
+
+    // --- Conversion Logic ---
+    m_converted_len = 0;
+    m_converted[0] = 0;
+
+    if (m_mode == IME_MODE_HIRAGANA || m_mode == IME_MODE_KATAKANA) {
+        if (m_romaji_len > 0) {
+            // Perform SKK lookup only if there are no candidates currently loaded
+            if (m_num_candidates == 0) {
+                lookup();
+            }
+            prefetch();
+
+            if (m_num_candidates > 0) { // If SKK candidates are loaded, display the selected one
+                prof_begin(PROF_LAYOUT);
+                m_converted_len = candidate(m_candidate_index, m_converted);
+                prof_end(PROF_LAYOUT);
+            } else { // No SKK candidates, fall back to romakana_map conversion
+                prof_begin(PROF_ROMAJI);
+                convert_romaji();
+                prof_end(PROF_ROMAJI);
+            }
+        }
+    } else if (m_mode == IME_MODE_ENGLISH || m_mode == IME_MODE_ABBREV) {
+        if (m_romaji_len > 0 && m_mode == IME_MODE_ABBREV && m_num_candidates == 0)
+            lookup();
+        if (m_num_candidates > 0) {
+            prof_begin(PROF_LAYOUT);
+            m_converted_len = candidate(m_candidate_index, m_converted);
+            prof_end(PROF_LAYOUT);
+        } else if (m_romaji_len > 0) {
+            prof_begin(PROF_ROMAJI);
+            int buffer_idx = 0;
+            for (int i = 0; i < m_romaji_len && buffer_idx < IME_TEXT_MAX - 1; i++) {
+                m_converted[buffer_idx++] = (uint16_t)m_romaji[i];
+            }
+            m_converted_len = buffer_idx;
+            m_converted[m_converted_len] = 0;
+            prof_end(PROF_ROMAJI);
+        }
+    }
+}
+
+// Look up the romaji buffer, or submit it to the async worker once per reading
+void ImeCore::lookup() {
+    prof_begin(PROF_LOOKUP);
+    if (m_async == NULL) {
+        // Only the leading candidates that fit are read (the most frequent in a ranked dictionary)
+        uint32_t index;
+        uint8_t skk_rc;
+        if (m_mode == IME_MODE_ABBREV) {
+            m_okuri[0] = '\0';
+            skk_rc = m_skk->get_abbrev_index(&index, m_romaji, m_romaji_len);
+        } else {
+            skk_rc = m_skk->get_kouho_list_index(&index, m_okuri, m_romaji, m_romaji_len);
+        }
+        if (skk_rc > 0) {
+            m_skk->get_top_kouho(m_kouho_list, sizeof(m_kouho_list), index, IME_CAND_MAX);
+            m_key_index = index;
+            load_candidates();
+        } else if (fuzzy_distance() > 0 &&
+                   m_skk->get_fuzzy_kouho(m_kouho_list, sizeof(m_kouho_list), &index,
+                                          m_romaji, m_romaji_len, fuzzy_distance(), IME_CAND_MAX) > 0) {
+            // A typo: the candidates of the nearest readings
+            m_okuri[0] = '\0';
+            m_key_index = index;
+            load_candidates();
+        } else {
+            m_num_candidates = 0;
+        }
+    } else if (m_lookup_ticket == 0 && !m_lookup_done) {
+        if (m_mode == IME_MODE_ABBREV)
+            m_lookup_ticket = m_async->submit_abbrev(m_romaji, m_romaji_len);
+        else
+            m_lookup_ticket = m_async->submit(m_romaji, m_romaji_len, NULL, NULL, fuzzy_distance());
+        if (m_lookup_ticket == 0)
+            m_lookup_done = true;   // Queue full: no candidates for this reading
+    }
+    prof_end(PROF_LOOKUP);
+}
+
+// Edit distance for a fuzzy lookup of the romaji buffer (0: exact only). Only readings that end
+// like a complete kana are tried, so a half-typed syllable ("kak") never jumps to a near word
+uint8_t ImeCore::fuzzy_distance() const {
+    if (m_mode == IME_MODE_ABBREV || m_romaji_len < IME_FUZZY_MIN_LEN)
+        return 0;
+    char c = m_romaji[m_romaji_len - 1];
+    bool complete = strchr("aiueo-", c) != NULL ||
+                    (c == 'n' && m_romaji[m_romaji_len - 2] == 'n');
+    return complete ? m_fuzzy : 0;
+}
+
+// Drop the pending async lookup (the romaji changed)
+void ImeCore::cancel_lookup() {
+    if (m_lookup_ticket != 0)
+        m_async->cancel(m_lookup_ticket);
+    m_lookup_ticket = 0;
+    m_lookup_done = false;
+}
+
+void ImeCore::apply_lookup(uint8_t rc, const char* kouho_list, const char* okuri, uint32_t index) {
+    m_lookup_ticket = 0;
+    m_lookup_done = true;
+    if (rc > 0) {
+        strcpy(m_kouho_list, kouho_list);
+        strcpy(m_okuri, okuri);
+        m_key_index = index;
+        load_candidates();
+    }
+    invalidate();
+}
+
+// Once the romaji forms a complete kana reading, prefetch the one-character extensions the
+// dictionary index shows as most common, so the next keystroke finds its lookup in the SKK cache
+void ImeCore::prefetch() {
+    char prefix[64];
+    if (m_async == NULL || !m_prefetch_enabled)
+        return;
+    if (m_prefetch_base_len == m_romaji_len && memcmp(m_prefetch_base, m_romaji, m_romaji_len) == 0)
+        return; // Already done for this reading
+    int prefix_len = romaji_to_sjis(prefix, sizeof(prefix) - 2, m_romaji, m_romaji_len);
+    if (prefix_len < 0)
+        return; // Incomplete reading (e.g. "kak")
+
+    bool hit = false;
+    for (int i = 0; i < m_prefetch_count; i++) {
+        if (m_prefetch_ticket[i] != 0 && strcmp(m_prefetch_token[i], m_romaji) == 0) {
+            m_prefetch_ticket[i] = 0; // Used
+            hit = true;
+        }
+    }
+    if (hit)
+        m_prefetch_stats.hits++;
+    else
+        m_prefetch_stats.misses++;
+    retire_prefetch();
+    memcpy(m_prefetch_base, m_romaji, m_romaji_len);
+    m_prefetch_base_len = m_romaji_len;
+
+    uint16_t next[IME_PREFETCH_MAX];
+    int n = m_skk->predict_next(next, IME_PREFETCH_MAX, prefix, prefix_len);
+    for (int i = 0; i < n; i++) {
+        const char* ext = kana_romaji(next[i]);
+        if (ext == NULL)
+            continue;
+        int ext_len = strlen(ext);
+        if (m_romaji_len + ext_len > 30)
+            continue;
+        char* token = m_prefetch_token[m_prefetch_count];
+        memcpy(token, m_romaji, m_romaji_len);
+        memcpy(token + m_romaji_len, ext, ext_len + 1);
+
+        // The extension must not change how the reading itself converts ("kan" + "i")
+        char check[64];
+        if (romaji_to_sjis(check, sizeof(check), token, m_romaji_len + ext_len) != prefix_len + 2 ||
+            memcmp(check, prefix, prefix_len) != 0)
+            continue;
+        uint32_t ticket = m_async->prefetch(token, m_romaji_len + ext_len);
+        if (ticket == 0)
+            break; // No room left for speculative work
+        m_prefetch_ticket[m_prefetch_count++] = ticket;
+        m_prefetch_stats.issued++;
+    }
+}
+
+// Drop the prefetches of the previous reading; the unused ones were wasted work
+void ImeCore::retire_prefetch() {
+    for (int i = 0; i < m_prefetch_count; i++) {
+        if (m_prefetch_ticket[i] != 0) {
+            m_async->cancel(m_prefetch_ticket[i]);
+            m_prefetch_stats.wasted++;
+        }
+    }
+    m_prefetch_count = 0;
+}
+
+bool ImeCore::poll_lookup() {
+    SKKLookupResult result;
+    if (m_lookup_ticket == 0 || !m_async->poll(m_lookup_ticket, &result))
+        return false;
+    apply_lookup(result.rc, result.kouho_list, result.okuri, result.index);
+    return true;
+}
+
+// Candidate keys act on the finished lookup, so the result does not depend on timing
+void ImeCore::settle() {
+    refresh();
+    if (m_lookup_ticket == 0)
+        return;
+    SKKLookupResult result;
+    prof_begin(PROF_LOOKUP);
+    bool ok = m_async->wait(m_lookup_ticket, &result);
+    prof_end(PROF_LOOKUP);
+    if (ok)
+        apply_lookup(result.rc, result.kouho_list, result.okuri, result.index);
+    else
+        m_lookup_ticket = 0;
+    refresh();
+}
+
+// Longest-match romakana_map conversion of the romaji buffer into m_converted
+void ImeCore::convert_romaji() {
+    int current_romaji_pos = 0;
+    int buffer_idx = 0;
+
+    while (current_romaji_pos < m_romaji_len && buffer_idx < IME_TEXT_MAX - 1) {
+        uint16_t best_match_sjis = 0;
+        int best_match_len = match_romaji(&m_romaji[current_romaji_pos], m_romaji_len - current_romaji_pos,
+                                          &best_match_sjis);
+
+        if (best_match_len > 0) {
+            uint16_t sjis_code = best_match_sjis;
+            if (m_mode == IME_MODE_KATAKANA) {
+                sjis_code = imeGlyph_katakana(sjis_code);
+            }
+            m_converted[buffer_idx++] = sjis_code;
+            current_romaji_pos += best_match_len;
+        } else { // If no match, display raw romaji char
+            m_converted[buffer_idx++] = (uint16_t)m_romaji[current_romaji_pos];
+            current_romaji_pos++;
+        }
+    }
+    m_converted_len = buffer_idx;
+    m_converted[m_converted_len] = 0;
+}
+
+// FNV-1a over the user-visible state, for comparing replays
+uint32_t ImeCore::checksum() const {
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < m_text.length(); i++) { // Committed text, as little endian glyph codes
+        uint16_t g = m_text.at(i);
+        h ^= (uint8_t)g;
+        h *= 16777619u;
+        h ^= (uint8_t)(g >> 8);
+        h *= 16777619u;
+    }
+    h ^= 0xff;
+    h *= 16777619u;
+    const uint8_t* parts[3] = {
+        (const uint8_t*)m_converted, (const uint8_t*)m_romaji, (const uint8_t*)m_kouho_list,
+    };
+    const size_t sizes[3] = {
+        m_converted_len * sizeof(uint16_t), (size_t)m_romaji_len, strlen(m_kouho_list),
+    };
+    for (int p = 0; p < 3; p++) {
+        for (size_t i = 0; i < sizes[p]; i++) {
+            h ^= parts[p][i];
+            h *= 16777619u;
+        }
+        h ^= 0xff;          // Separator so that moving bytes between parts changes the hash
+        h *= 16777619u;
+    }
+    const uint32_t tail[3] = { (uint32_t)m_mode, m_candidate_index, m_num_candidates };
+    for (int i = 0; i < 3; i++) {
+        h ^= tail[i];
+        h *= 16777619u;
+    }
+    return h;
+}
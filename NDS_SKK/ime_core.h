@@ -0,0 +1,178 @@
+//
+// IME core: input handling, romaji conversion and dictionary lookup without libnds
+//  ImeApp (ime_app.h) feeds it the queued ImeInputs of each frame on the DS and on Linux.
+//
+#ifndef IME_CORE_H
+#define IME_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+#include "ime_text.h"
+#endif
+
+// Input Modes
+typedef enum {
+	IME_MODE_HIRAGANA,
+	IME_MODE_KATAKANA,
+	IME_MODE_ENGLISH,
+	IME_MODE_DEBUG,
+	IME_MODE_ABBREV,   // ASCII reading looked up as is ('/' in a kana mode), back to that mode on commit
+} ImeMode;
+
+// Button bits, same layout as libnds KEY_* so keysDown() can be passed as is
+#define IME_BTN_A       (1 << 0)
+#define IME_BTN_B       (1 << 1)
+#define IME_BTN_SELECT  (1 << 2)
+#define IME_BTN_START   (1 << 3)
+#define IME_BTN_RIGHT   (1 << 4)
+#define IME_BTN_LEFT    (1 << 5)
+#define IME_BTN_UP      (1 << 6)
+#define IME_BTN_DOWN    (1 << 7)
+#define IME_BTN_R       (1 << 8)
+#define IME_BTN_L       (1 << 9)
+#define IME_BTN_X       (1 << 10)
+#define IME_BTN_Y       (1 << 11)
+#define IME_BTN_TOUCH   (1 << 12)
+
+// One frame of input
+typedef struct {
+	uint8_t  key;        // Character from the software keyboard (0: none)
+	uint16_t buttons;    // Buttons newly pressed this frame (IME_BTN_*)
+	uint8_t  touch_x;    // Touch position, valid when IME_BTN_TOUCH is set
+	uint8_t  touch_y;
+} ImeInput;
+
+#define IME_TEXT_MAX 256   // Preedit text capacity in glyph codes
+#define IME_ARENA_SIZE (64 * 1024) // Arena for the committed text (up to 16K glyphs while doubling)
+#define IME_QUEUE_SIZE 128 // Input queue capacity in events (power of two)
+#define IME_PREFETCH_MAX 3 // One-character extensions prefetched per reading
+#define IME_CAND_MAX 128   // Candidates kept per lookup (a 256 byte list has fewer)
+#define IME_ANNOT_MAX 64   // Annotation capacity in glyph codes
+#define IME_FUZZY_DISTANCE 1 // Romaji edit distance of the near readings tried on a miss (default)
+#define IME_FUZZY_MIN_LEN 3  // Shortest romaji looked up fuzzily (shorter ones are near too many readings)
+
+// Speculative prefetch counters, for tuning the heuristic
+typedef struct {
+	uint32_t issued;     // Prefetch lookups submitted
+	uint32_t hits;       // Complete readings that had been prefetched
+	uint32_t misses;     // Complete readings that had not
+	uint32_t wasted;     // Prefetched readings that were never typed
+} ImePrefetchStats;
+
+#ifdef __cplusplus
+class SKK;
+class SKKAsync;
+
+// Ring buffer of pending input events, filled by the platform layer and by text injection
+class ImeInputQueue {
+ public:
+	ImeInputQueue() : m_head(0), m_tail(0), m_dropped(0) {}
+	bool     push(const ImeInput& in);             // false when full (the event is dropped and counted)
+	bool     push_key(uint8_t key);                // Queue a software keyboard character
+	bool     pop(ImeInput* in);                    // Oldest event; false when empty
+	uint32_t count() const { return m_tail - m_head; }
+	bool     empty() const { return m_tail == m_head; }
+	bool     full() const { return count() == IME_QUEUE_SIZE; }
+	uint32_t dropped() const { return m_dropped; }
+	void     clear() { m_head = m_tail; }
+
+ private:
+	ImeInput m_buf[IME_QUEUE_SIZE];
+	uint32_t m_head;                // Free-running read / write counters
+	uint32_t m_tail;
+	uint32_t m_dropped;
+};
+
+class ImeCore {
+ public:
+	// Reset all state and attach the dictionary. With async, lookups are submitted to it and
+	// the romaji preedit stays on screen until the candidates arrive (SKK must then only be
+	// searched by the async worker).
+	void init(SKK* skk, SKKAsync* async = NULL);
+	bool feed(const ImeInput& in);                 // Apply one input event; false when START was pressed
+	void refresh();                                // Bring conversion and candidates up to date
+	bool update(const ImeInput& in);               // feed() then refresh(), for one event per frame
+	bool poll_lookup();                            // Apply a finished async lookup; true when one was applied
+	void settle();                                 // Wait for the pending lookup and refresh
+	bool lookup_pending() const { return m_lookup_ticket != 0; }
+	void enable_prefetch(bool enable) { m_prefetch_enabled = enable; }
+	// On a miss, offer the candidates of the nearest readings within max_dist typos (0: off)
+	void enable_fuzzy(uint8_t max_dist) { m_fuzzy = max_dist; }
+	const ImePrefetchStats& prefetch_stats() const { return m_prefetch_stats; }
+
+	ImeMode         mode() const { return m_mode; }
+	const ImeText&  text() const { return m_text; }              // Committed text (SJIS glyph codes)
+	bool            take_text_change(ImeTextChange* out) { return m_text.take_change(out); }
+	ImeText*        load_text() { invalidate(); return &m_text; }  // Committed text to replace with a loaded document
+	const uint16_t* preedit() const { return m_converted; }     // Uncommitted text (SJIS glyph codes)
+	int             preedit_len() const { return m_converted_len; }
+	const char*     romaji() const { return m_romaji; }
+	const char*     kouho_list() const { return m_kouho_list; }
+	uint16_t        num_candidates() const { return m_num_candidates; }
+	uint16_t        candidate_index() const { return m_candidate_index; }
+	const uint16_t* candidate_list() const { return m_list; }      // Whole candidate list as glyph codes
+	const uint16_t* candidate_text(uint16_t index, int* len) const; // Candidate in place, not terminated
+	int             candidate(uint16_t index, uint16_t* dst) const; // Candidate as glyph codes, returns length (0: none)
+	// Annotation of the selected candidate, read from the dictionary when the selection changes
+	// (the image is read only, so this is safe while the async worker searches). len 0: none
+	const uint16_t* annotation(int* len);
+	uint32_t        checksum() const;                              // Hash of the user-visible state
+	uint32_t        revision() const { return m_revision; }        // Changes whenever refresh() updates the state
+
+ private:
+	void switch_mode();
+	void leave_abbrev();
+	void reset_candidates();
+	void commit(const uint16_t* text, int len);
+	void convert_romaji();
+	void invalidate() { m_dirty = true; }
+	void lookup();
+	uint8_t fuzzy_distance() const;
+	void cancel_lookup();
+	void apply_lookup(uint8_t rc, const char* kouho_list, const char* okuri, uint32_t index);
+	void load_candidates();
+	void prefetch();
+	void retire_prefetch();
+
+	SKK*     m_skk;
+	SKKAsync* m_async;
+	uint32_t m_lookup_ticket;       // Pending async lookup (0: none)
+	bool     m_lookup_done;         // Lookup for the current romaji finished (async only)
+
+	// Readings prefetched for the last complete reading (m_prefetch_base)
+	bool     m_prefetch_enabled;
+	uint8_t  m_fuzzy;                // Edit distance of fuzzy lookups (0: off)
+	ImeMode  m_abbrev_from;          // Kana mode that abbrev mode returns to
+	char     m_prefetch_base[32];
+	int      m_prefetch_base_len;
+	char     m_prefetch_token[IME_PREFETCH_MAX][32];
+	uint32_t m_prefetch_ticket[IME_PREFETCH_MAX];
+	int      m_prefetch_count;
+	ImePrefetchStats m_prefetch_stats;
+	ImeMode  m_mode;
+	char     m_romaji[32];
+	int      m_romaji_len;
+	uint16_t m_converted[IME_TEXT_MAX];
+	int      m_converted_len;
+	char     m_kouho_list[256];     // Stored candidate list from SKK
+	char     m_okuri[32];           // Stored okuri from SKK
+	uint16_t m_list[IME_TEXT_MAX];  // m_kouho_list decoded to glyph codes
+	int      m_list_len;
+	uint16_t m_cand_start[IME_CAND_MAX + 1]; // Start of each candidate in m_list
+	uint16_t m_candidate_index;     // Index of the currently selected candidate
+	uint16_t m_num_candidates;      // Total number of candidates
+	int32_t  m_key_index;           // Dictionary entry of the candidates (-1: none)
+	uint16_t m_annot[IME_ANNOT_MAX]; // Annotation of candidate m_annot_for
+	int      m_annot_len;
+	int32_t  m_annot_for;           // Candidate whose annotation is in m_annot (-1: not read)
+	ImeText  m_text;                // Committed text with the cursor
+	ImeArena m_arena;
+	uint32_t m_arena_mem[IME_ARENA_SIZE / 4];
+	bool     m_dirty;               // Input changed since the last refresh()
+	uint32_t m_revision;
+};
+#endif
+
+#endif // IME_CORE_H
@@ -0,0 +1,305 @@
+#include <string.h>
+
+#include "ime_document.h"
+#include "ime_glyph.h"
+
+#define RECORD_EDIT 1           // Journal record: from, glyphs erased, glyphs inserted
+
+void ImeDocument::init(PlatformStorage* storage, PlatformClock* clock) {
+    m_storage = storage;
+    m_clock = clock;
+    m_journal.init(storage);
+    m_file = -1;
+    m_open = false;
+    m_dirty = false;
+    m_checkpoint = false;
+    m_unjournaled = false;
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+static uint32_t chunk_count(uint32_t length) {
+    uint32_t n = (length + IME_DOC_CHUNK - 1) / IME_DOC_CHUNK;
+    return n < IME_DOC_CHUNKS ? n : IME_DOC_CHUNKS;   // Text beyond the table is not saved
+}
+
+// Read m_file into text; length and crc of the file are for the journal
+bool ImeDocument::load(ImeText* text, uint32_t* length, uint32_t* crc) {
+    uint8_t buf[IME_DOC_CHUNK * 2];
+    uint16_t glyphs[IME_DOC_CHUNK * 2];
+    uint32_t offset = 0;
+    int lead = -1;              // Lead byte of a character split between two reads
+    bool exact = true;          // The file is what saving the text would write
+
+    *crc = 0;
+    text->clear();
+    for (;;) {
+        int32_t n = m_storage->read_at(m_file, offset, buf, sizeof(buf));
+        if (n < 0)              // Do not overwrite a file that could not be read
+            return false;
+        if (n == 0) {
+            exact = exact && lead < 0;
+            break;
+        }
+        offset += n;
+        *crc = ImeJournal::crc32(*crc, buf, n);
+        uint32_t count = 0;
+        for (int32_t i = 0; i < n; i++) {
+            uint8_t b = buf[i];
+            if (lead >= 0) {
+                glyphs[count++] = (uint16_t)(lead << 8 | b);
+                lead = -1;
+            } else if (imeGlyph_sjisLead[b]) {
+                lead = b;
+            } else if (b == '\r' || b == '\0') {
+                exact = false;  // Dropped; the file is rewritten on the next save
+            } else {
+                glyphs[count++] = b;
+            }
+        }
+        if (!text->insert(glyphs, count)) {
+            exact = false;      // Out of memory: keep what fits
+            break;
+        }
+    }
+    *length = offset;
+    ImeTextChange change;
+    text->take_change(&change); // Loaded, not edited
+
+    uint32_t chunks = chunk_count(text->length());
+    m_offset[0] = 0;
+    for (uint32_t c = 0; c < chunks; c++) {
+        uint32_t end = (c + 1) * IME_DOC_CHUNK < text->length() ? (c + 1) * IME_DOC_CHUNK : text->length();
+        uint32_t bytes = 0;
+        for (uint32_t i = c * IME_DOC_CHUNK; i < end; i++)
+            bytes += text->at(i) < 0x100 ? 1 : 2;
+        m_offset[c + 1] = m_offset[c] + bytes;
+    }
+    m_dirty = false;
+    if (!exact || m_offset[chunks] != offset) {
+        m_dirty = true;
+        m_first = 0;
+        m_last = UINT32_MAX;
+        m_dirty_since = m_clock->now_us();
+    }
+    return true;
+}
+
+bool ImeDocument::open(const char* path, ImeText* text, const char* journal_path) {
+    uint32_t length, crc;
+
+    if (strlen(path) >= IME_DOC_PATH_MAX)
+        return false;
+    strcpy(m_path, path);
+    strcpy(m_tmp_path, path);
+    strcat(m_tmp_path, ".tmp");
+    // A checkpoint stopped between removing the file and renaming the new one over it
+    if (journal_path != NULL && m_storage->read_file(m_path, NULL, 0) < 0 &&
+        m_storage->read_file(m_tmp_path, NULL, 0) >= 0)
+        m_storage->rename_file(m_tmp_path, m_path);
+
+    m_file = m_storage->open_file(path);
+    if (m_file < 0)
+        return false;
+    if (!load(text, &length, &crc)) {
+        m_storage->close_file(m_file);
+        m_file = -1;
+        return false;
+    }
+    m_open = true;
+    m_checkpoint = false;
+    m_unjournaled = false;
+
+    uint32_t replayed;
+    if (journal_path == NULL || !m_journal.open(journal_path, length, crc, replay_edit, text, &replayed))
+        return true;            // Chunks are written into the open file
+    m_storage->close_file(m_file);
+    m_file = -1;                // Opened again at checkpoints
+    if (replayed > 0) {
+        ImeTextChange change;
+        text->take_change(&change);
+        if (!m_dirty) {
+            m_dirty = true;
+            m_dirty_since = m_clock->now_us();
+        }
+    }
+    if (m_dirty)                // The journal is kept until the file holds its edits
+        start_checkpoint();
+    return true;
+}
+
+bool ImeDocument::replay_edit(void* user, uint8_t type, const uint8_t* data, uint16_t len) {
+    ImeText* text = (ImeText*)user;
+    uint32_t head[2];
+    uint16_t glyphs[IME_DOC_CHUNK];
+    if (type != RECORD_EDIT || len < sizeof(head) || (len - sizeof(head)) / 2 > IME_DOC_CHUNK)
+        return false;
+    memcpy(head, data, sizeof(head));
+    uint32_t n = (len - sizeof(head)) / 2;
+    memcpy(glyphs, data + sizeof(head), n * 2);
+    if (head[0] > text->length() || head[1] > text->length() - head[0])
+        return false;
+    text->set_cursor(head[0]);
+    text->erase_after(head[1]);
+    return text->insert(glyphs, n);
+}
+
+void ImeDocument::edited(const ImeTextChange& change, const ImeText& text) {
+    if (change.from == change.to && change.delta == 0)
+        return;
+    uint32_t first = change.from / IME_DOC_CHUNK;
+    uint32_t last = UINT32_MAX; // A length change moves everything after the edit
+    if (change.delta == 0)
+        last = (change.to - 1) / IME_DOC_CHUNK;
+    if (!m_dirty) {
+        m_dirty = true;
+        m_first = first;
+        m_last = last;
+        m_dirty_since = m_clock->now_us();
+    } else {
+        if (first < m_first)
+            m_first = first;
+        if (last > m_last)
+            m_last = last;
+    }
+    if (!journaled())
+        return;
+    if (m_checkpoint)
+        start_checkpoint();     // What was written may be stale
+    if (m_unjournaled)          // Records after a missing one would be replayed onto the wrong text
+        return;
+
+    // Replaces glyphs [from, from + erased) of the text before the edit with [from, to)
+    uint32_t record[2 + IME_DOC_CHUNK / 2];
+    uint32_t n = change.to - change.from;
+    record[0] = change.from;
+    record[1] = (uint32_t)((int32_t)n - change.delta);
+    if (n > IME_DOC_CHUNK)
+        m_unjournaled = true;   // A long paste: written by a checkpoint instead
+    else if (text.copy(change.from, n, (uint16_t*)&record[2]) != n ||
+             !m_journal.append(RECORD_EDIT, record, (uint16_t)(2 * sizeof(uint32_t) + n * 2)))
+        m_unjournaled = true;
+}
+
+bool ImeDocument::needs_flush() const {
+    if (!journaled())
+        return m_dirty;
+    return m_checkpoint || m_unjournaled || m_journal.pending() ||
+           (m_dirty && m_journal.used() >= IME_DOC_CHECKPOINT_USED);
+}
+
+void ImeDocument::start_checkpoint() {
+    m_checkpoint = true;
+    m_first = 0;
+    m_offset[0] = 0;
+    m_crc = 0;
+}
+
+// Write the first dirty chunk, or when all are written, trim the file and sync it
+bool ImeDocument::write_chunk(const ImeText& text) {
+    uint32_t chunks = chunk_count(text.length());
+    if (m_first < chunks) {
+        uint16_t glyphs[IME_DOC_CHUNK];
+        char bytes[IME_DOC_CHUNK * 2 + 1];
+        uint32_t n = text.copy(m_first * IME_DOC_CHUNK, IME_DOC_CHUNK, glyphs);
+        uint32_t len = imeGlyph_toSjis(bytes, sizeof(bytes), glyphs, n);
+        if (!m_storage->write_at(m_file, m_offset[m_first], bytes, len))
+            return false;
+        // The next chunk needs writing if it was edited or its offset moved
+        uint32_t next = m_first + 1;
+        uint32_t end = m_offset[m_first] + len;
+        bool more = m_checkpoint || next <= m_last || end != m_offset[next];
+        m_offset[next] = end;
+        m_first = more ? next : chunks;
+        m_crc = ImeJournal::crc32(m_crc, bytes, len);
+        m_stats.writes++;
+        m_stats.bytes_written += len;
+        return true;
+    }
+    if (!m_storage->truncate(m_file, m_offset[chunks]) || !m_storage->sync(m_file))
+        return false;
+    m_dirty = false;
+    m_stats.saves++;
+    return true;
+}
+
+// Write the text into path.tmp chunk by chunk, then replace path with it and empty the journal
+bool ImeDocument::checkpoint_step(const ImeText& text) {
+    if (m_file < 0) {
+        m_file = m_storage->open_file(m_tmp_path);
+        if (m_file < 0)
+            return false;
+    }
+    bool last = m_first >= chunk_count(text.length());
+    if (!write_chunk(text)) {
+        start_checkpoint();
+        return false;
+    }
+    if (!last)
+        return true;
+    uint32_t length = m_offset[chunk_count(text.length())];
+    bool ok = m_storage->close_file(m_file);
+    m_file = -1;
+    ok = ok && (m_storage->remove_file(m_path) || m_storage->read_file(m_path, NULL, 0) < 0) &&
+         m_storage->rename_file(m_tmp_path, m_path);
+    if (ok && !m_journal.reset(length, m_crc)) {
+        m_unjournaled = true;   // The journal is for the old file: stop adding to it
+        ok = false;
+    }
+    if (!ok) {
+        m_dirty = true;
+        start_checkpoint();
+        return false;
+    }
+    m_checkpoint = false;
+    m_unjournaled = false;
+    return true;
+}
+
+bool ImeDocument::flush_step(const ImeText& text) {
+    if (!m_open || !needs_flush())
+        return false;
+    uint32_t start = m_clock->now_us();
+    bool ok;
+    if (!journaled()) {
+        ok = write_chunk(text);
+    } else if (m_journal.pending()) {
+        ok = m_journal.sync();
+    } else {
+        if (!m_checkpoint)
+            start_checkpoint();
+        ok = checkpoint_step(text);
+    }
+    uint32_t now = m_clock->now_us();
+    m_stats.steps++;
+    m_stats.step_us_total += now - start;
+    if (now - start > m_stats.step_us_max)
+        m_stats.step_us_max = now - start;
+    if (ok && !m_dirty && now - m_dirty_since > m_stats.lag_us_max)
+        m_stats.lag_us_max = now - m_dirty_since;
+    if (!ok)
+        m_stats.failures++;
+    return ok;
+}
+
+bool ImeDocument::save(const ImeText& text) {
+    if (journaled() && m_dirty && !m_checkpoint)
+        start_checkpoint();
+    while (needs_flush()) {
+        if (!flush_step(text))
+            return false;
+    }
+    return true;
+}
+
+bool ImeDocument::close(const ImeText& text) {
+    if (!m_open)
+        return true;
+    bool ok = save(text);
+    if (m_file >= 0)
+        ok = m_storage->close_file(m_file) && ok;
+    m_file = -1;
+    m_journal.close();
+    m_open = false;
+    m_checkpoint = false;
+    return ok;
+}
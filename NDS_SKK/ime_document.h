@@ -0,0 +1,87 @@
+//
+// IME document: the committed text saved to a Shift-JIS file in fixed-size chunks
+//  The text is split into chunks of IME_DOC_CHUNK glyphs, each written as one piece of at most
+//  2 * IME_DOC_CHUNK bytes (one 512-byte sector). Edits only mark chunks dirty; flush_step()
+//  writes one dirty chunk at a time, so the application can spread a save over idle frames
+//  (write-behind) and typing never waits for the storage. A chunk is written only when the
+//  chunks before it are clean, which keeps its file offset known; an edit that changes the
+//  length dirties the chunks after it as well, up to the first one whose offset is unchanged.
+//
+//  With a journal (open() with journal_path), each edit is instead appended to the journal as
+//  one small record (position, glyphs erased, glyphs inserted), and a flush_step() only syncs
+//  the journal. The file is rewritten rarely (a checkpoint: when the journal fills up, and on
+//  close) into path.tmp, one chunk per step, which is then renamed over path; an edit during
+//  a checkpoint restarts it. open() replays the journal onto the file after a power loss.
+//
+#ifndef IME_DOCUMENT_H
+#define IME_DOCUMENT_H
+
+#include <stdint.h>
+
+#include "ime_journal.h"
+#include "ime_text.h"
+#include "platform.h"
+
+#define IME_DOC_CHUNK   256                                   // Glyphs per chunk
+#define IME_DOC_CHUNKS  (IME_ARENA_SIZE / 4 / IME_DOC_CHUNK)  // Chunks of the longest text
+#define IME_DOC_CHECKPOINT_USED  (IME_JOURNAL_SECTORS / 2 * IME_JOURNAL_SECTOR) // Journal bytes that start a checkpoint
+#define IME_DOC_PATH_MAX 64
+
+// Save statistics (microseconds from the platform clock)
+typedef struct {
+	uint32_t bytes_written;
+	uint32_t writes;            // Chunks written
+	uint32_t saves;             // Saves completed (the file matched the text); checkpoints with a journal
+	uint32_t steps;             // flush_step() calls that did work (chunks, journal syncs, checkpoint steps)
+	uint32_t step_us_max;       // Longest flush_step()
+	uint32_t step_us_total;
+	uint32_t lag_us_max;        // Longest time from the first unsaved edit to the end of its save
+	uint32_t failures;
+} ImeDocStats;
+
+class ImeDocument {
+ public:
+	void init(PlatformStorage* storage, PlatformClock* clock);
+	// Replace text with the file (a missing file is created empty) and keep it open for saving.
+	// With journal_path, edits are journaled there and the file is written at checkpoints; the
+	// document still opens (without the journal) when the journal cannot be used.
+	bool open(const char* path, ImeText* text, const char* journal_path = NULL);
+	bool is_open() const { return m_open; }
+	bool journaled() const { return m_journal.is_open(); }
+	bool close(const ImeText& text);                 // Save everything and close
+	// The text changed (ImeText::take_change()); text is read for the journal record
+	void edited(const ImeTextChange& change, const ImeText& text);
+	bool dirty() const { return m_dirty; }           // The file differs from the text
+	bool needs_flush() const;                        // flush_step() has something to write
+	uint32_t dirty_since() const { return m_dirty_since; } // Clock time of the first unsaved edit
+	bool flush_step(const ImeText& text);            // Write one piece; false when clean or on error
+	bool save(const ImeText& text);                  // Write all dirty chunks (checkpoint) now
+	const ImeDocStats& stats() const { return m_stats; }
+	const ImeJournalStats& journal_stats() const { return m_journal.stats(); }
+
+ private:
+	bool load(ImeText* text, uint32_t* length, uint32_t* crc);
+	bool write_chunk(const ImeText& text);
+	bool checkpoint_step(const ImeText& text);
+	void start_checkpoint();
+	static bool replay_edit(void* user, uint8_t type, const uint8_t* data, uint16_t len);
+
+	PlatformStorage* m_storage;
+	PlatformClock*   m_clock;
+	ImeJournal m_journal;
+	char     m_path[IME_DOC_PATH_MAX];
+	char     m_tmp_path[IME_DOC_PATH_MAX + 4];
+	int32_t  m_file;                     // path (without a journal) or path.tmp (during a checkpoint)
+	bool     m_open;
+	bool     m_dirty;
+	bool     m_checkpoint;               // Rewriting the file (journal)
+	bool     m_unjournaled;              // An edit did not fit the journal: it needs a checkpoint
+	uint32_t m_crc;                      // Of the file written so far (checkpoint)
+	uint32_t m_first;                    // First dirty chunk
+	uint32_t m_last;                     // Last chunk dirtied by an edit (UINT32_MAX: to the end)
+	uint32_t m_dirty_since;
+	uint32_t m_offset[IME_DOC_CHUNKS + 1]; // File offset of each saved chunk, and the file length
+	ImeDocStats m_stats;
+};
+
+#endif // IME_DOCUMENT_H
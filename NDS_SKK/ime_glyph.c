@@ -0,0 +1,70 @@
+#include "ime_glyph.h"
+
+const uint8_t imeGlyph_sjisLead[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 00
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 10
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 20
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 30
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 40
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 50
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 60
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 70
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 80
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 90
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // A0
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // B0
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // C0
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // D0
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // E0
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0,  // F0
+};
+
+// ぁ..ん to ァ..ン
+const uint16_t imeGlyph_hiraKata[IME_GLYPH_HIRA_LAST - IME_GLYPH_HIRA_FIRST + 1] = {
+	0x8340, 0x8341, 0x8342, 0x8343, 0x8344, 0x8345, 0x8346, 0x8347,
+	0x8348, 0x8349, 0x834A, 0x834B, 0x834C, 0x834D, 0x834E, 0x834F,
+	0x8350, 0x8351, 0x8352, 0x8353, 0x8354, 0x8355, 0x8356, 0x8357,
+	0x8358, 0x8359, 0x835A, 0x835B, 0x835C, 0x835D, 0x835E, 0x835F,
+	0x8360, 0x8361, 0x8362, 0x8363, 0x8364, 0x8365, 0x8366, 0x8367,
+	0x8368, 0x8369, 0x836A, 0x836B, 0x836C, 0x836D, 0x836E, 0x836F,
+	0x8370, 0x8371, 0x8372, 0x8373, 0x8374, 0x8375, 0x8376, 0x8377,
+	0x8378, 0x8379, 0x837A, 0x837B, 0x837C, 0x837D, 0x837E, 0x8380,
+	0x8381, 0x8382, 0x8383, 0x8384, 0x8385, 0x8386, 0x8387, 0x8388,
+	0x8389, 0x838A, 0x838B, 0x838C, 0x838D, 0x838E, 0x838F, 0x8390,
+	0x8391, 0x8392, 0x8393,
+};
+
+int imeGlyph_fromSjis(uint16_t* dst, int cap, const char* src, int len) {
+	const uint8_t* p = (const uint8_t*)src;
+	int n = 0;
+	int i = 0;
+	while (i < len && p[i] != '\0' && n < cap - 1) {
+		if (imeGlyph_sjisLead[p[i]] && i + 1 < len && p[i + 1] != '\0') {
+			dst[n++] = (uint16_t)((p[i] << 8) | p[i + 1]);
+			i += 2;
+		} else {
+			dst[n++] = p[i++];
+		}
+	}
+	dst[n] = 0;
+	return n;
+}
+
+int imeGlyph_toSjis(char* dst, int cap, const uint16_t* src, int len) {
+	int n = 0;
+	for (int i = 0; i < len; i++) {
+		uint16_t g = src[i];
+		if (g >= 0x100) {
+			if (n + 2 > cap - 1)
+				break;
+			dst[n++] = (char)(g >> 8);
+			dst[n++] = (char)g;
+		} else {
+			if (n + 1 > cap - 1)
+				break;
+			dst[n++] = (char)g;
+		}
+	}
+	dst[n] = '\0';
+	return n;
+}
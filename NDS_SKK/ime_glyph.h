@@ -0,0 +1,47 @@
+//
+// IME glyph codes: the single text representation from input to screen
+//
+//  Text is carried as arrays of uint16_t glyph codes. A glyph code is the Shift-JIS code of
+//  the character (bytes below 0x80 are ASCII), which is also the font index and the dictionary
+//  encoding, so romaji conversion, candidate display and drawing work on it directly.
+//  Bytes are decoded or encoded only at the edges, through the tables below:
+//   - candidate lists from the dictionary, once per lookup (imeGlyph_fromSjis)
+//   - text export (imeGlyph_toSjis)
+//
+#ifndef IME_GLYPH_H
+#define IME_GLYPH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define IME_GLYPH_HIRA_FIRST 0x829F   // ぁ
+#define IME_GLYPH_HIRA_LAST  0x82F1   // ん
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const uint8_t  imeGlyph_sjisLead[256];   // 1 for Shift-JIS lead bytes
+extern const uint16_t imeGlyph_hiraKata[IME_GLYPH_HIRA_LAST - IME_GLYPH_HIRA_FIRST + 1];
+
+// Katakana for a hiragana glyph (other glyphs are returned as is). The katakana row skips
+// the trail byte 0x7F, so this is a table rather than an offset.
+static inline uint16_t imeGlyph_katakana(uint16_t g) {
+	if (g >= IME_GLYPH_HIRA_FIRST && g <= IME_GLYPH_HIRA_LAST)
+		return imeGlyph_hiraKata[g - IME_GLYPH_HIRA_FIRST];
+	return g;
+}
+
+// Decode len bytes of Shift-JIS (stops at '\0'); writes at most cap - 1 glyphs plus a 0
+// terminator and returns the glyph count
+int imeGlyph_fromSjis(uint16_t* dst, int cap, const char* src, int len);
+
+// Encode len glyphs as Shift-JIS; writes at most cap - 1 bytes plus '\0' (a glyph that
+// does not fit is dropped whole) and returns the byte count
+int imeGlyph_toSjis(char* dst, int cap, const uint16_t* src, int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IME_GLYPH_H
@@ -0,0 +1,229 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "ime_journal.h"
+
+#define JOURNAL_MAGIC   0x4A4B4B53u     // "SKKJ"
+#define JOURNAL_VERSION 1
+#define RECORD_HEADER   12
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sectors;
+    uint32_t generation;        // Records carry it; bumped by reset()
+    uint32_t base_len;          // File state the records apply to
+    uint32_t base_crc;
+    uint32_t crc;               // Of the fields above
+} JournalHeader;
+
+uint32_t ImeJournal::crc32(uint32_t crc, const void* data, uint32_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+    while (len-- > 0) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 15];
+        crc = (crc >> 4) ^ table[crc & 15];
+    }
+    return ~crc;
+}
+
+static uint32_t record_size(uint16_t len) {
+    return RECORD_HEADER + ((len + 3u) & ~3u);
+}
+
+static uint32_t record_crc(uint32_t generation, uint8_t type, uint16_t len, const void* data) {
+    uint8_t head[7] = { (uint8_t)generation, (uint8_t)(generation >> 8), (uint8_t)(generation >> 16),
+                        (uint8_t)(generation >> 24), type, (uint8_t)len, (uint8_t)(len >> 8) };
+    return ImeJournal::crc32(ImeJournal::crc32(0, head, sizeof(head)), data, len);
+}
+
+void ImeJournal::init(PlatformStorage* storage) {
+    m_storage = storage;
+    m_file = -1;
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool ImeJournal::write_sectors(uint32_t sector, const void* data, uint32_t count) {
+    if (!m_storage->write_at(m_file, sector * IME_JOURNAL_SECTOR, data, count * IME_JOURNAL_SECTOR))
+        return false;
+    m_stats.sectors_written += count;
+    return true;
+}
+
+bool ImeJournal::write_header() {
+    uint32_t sector[IME_JOURNAL_SECTOR / 4];
+    JournalHeader* h = (JournalHeader*)sector;
+    memset(sector, 0, sizeof(sector));
+    h->magic = JOURNAL_MAGIC;
+    h->version = JOURNAL_VERSION;
+    h->sectors = IME_JOURNAL_SECTORS;
+    h->generation = m_generation;
+    h->base_len = m_base_len;
+    h->base_crc = m_base_crc;
+    h->crc = crc32(0, h, offsetof(JournalHeader, crc));
+    return write_sectors(0, sector, 1) && m_storage->sync(m_file);
+}
+
+bool ImeJournal::open(const char* path, uint32_t base_len, uint32_t base_crc,
+                      ImeJournalApply apply, void* user, uint32_t* replayed) {
+    uint8_t* buf = (uint8_t*)m_buf;
+    JournalHeader h;
+
+    *replayed = 0;
+    close();
+    m_file = m_storage->open_file(path);
+    if (m_file < 0)
+        return false;
+
+    // A new (or short) file is written out at full size once, so syncs never grow it
+    if (m_storage->read_at(m_file, (IME_JOURNAL_SECTORS - 1) * IME_JOURNAL_SECTOR, buf, IME_JOURNAL_SECTOR)
+        != IME_JOURNAL_SECTOR) {
+        memset(m_buf, 0, sizeof(m_buf));
+        for (uint32_t s = 0; s < IME_JOURNAL_SECTORS; s += IME_JOURNAL_BUFFER) {
+            if (!m_storage->write_at(m_file, s * IME_JOURNAL_SECTOR, m_buf, sizeof(m_buf))) {
+                close();
+                return false;
+            }
+            m_stats.preallocated += sizeof(m_buf);
+        }
+    }
+
+    bool valid = m_storage->read_at(m_file, 0, &h, sizeof(h)) == (int32_t)sizeof(h) &&
+                 h.magic == JOURNAL_MAGIC && h.version == JOURNAL_VERSION &&
+                 h.sectors == IME_JOURNAL_SECTORS && h.crc == crc32(0, &h, offsetof(JournalHeader, crc));
+    m_generation = valid ? h.generation : 0;
+    m_end = 0;
+    bool torn = false;          // The stream ended with a damaged record of this generation
+    if (valid && h.base_len == base_len && h.base_crc == base_crc) {
+        for (;;) {
+            uint32_t head[RECORD_HEADER / 4];
+            if (m_end + RECORD_HEADER > capacity() ||
+                m_storage->read_at(m_file, IME_JOURNAL_SECTOR + m_end, head, RECORD_HEADER) != RECORD_HEADER ||
+                head[0] != m_generation)
+                break;
+            uint8_t type = (uint8_t)head[1];
+            uint16_t len = (uint16_t)(head[1] >> 16);
+            torn = true;
+            if (len > IME_JOURNAL_RECORD_MAX || m_end + record_size(len) > capacity() ||
+                m_storage->read_at(m_file, IME_JOURNAL_SECTOR + m_end + RECORD_HEADER, buf, len) != len ||
+                head[2] != record_crc(m_generation, type, len, buf))
+                break;
+            torn = false;
+            if (!apply(user, type, buf, len)) {
+                torn = true;    // Unusable: overwritten by the next records
+                break;
+            }
+            m_end += record_size(len);
+            (*replayed)++;
+        }
+    }
+    m_stats.replayed += *replayed;
+    if (*replayed == 0) {       // Nothing to keep: start a generation for this file state
+        m_synced = m_end = 0;
+        if (!reset(base_len, base_crc)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    m_base_len = base_len;
+    m_base_crc = base_crc;
+    m_synced = m_end;
+    m_buf_start = m_end / IME_JOURNAL_SECTOR * IME_JOURNAL_SECTOR;
+    memset(m_buf, 0, sizeof(m_buf));
+    if (m_end > m_buf_start &&
+        m_storage->read_at(m_file, IME_JOURNAL_SECTOR + m_buf_start, buf, m_end - m_buf_start)
+        != (int32_t)(m_end - m_buf_start)) {
+        close();
+        return false;
+    }
+    if (torn) {
+        // Records after a damaged one may still look valid; clear them so that the records
+        // appended from here on are never followed by them
+        const uint8_t* clear = buf + IME_JOURNAL_SECTOR;   // m_buf after the partly filled sector
+        uint32_t s = 1 + m_buf_start / IME_JOURNAL_SECTOR;
+        bool ok = s >= IME_JOURNAL_SECTORS || write_sectors(s++, buf, 1);
+        while (ok && s < IME_JOURNAL_SECTORS) {
+            uint32_t n = IME_JOURNAL_SECTORS - s < IME_JOURNAL_BUFFER - 1 ? IME_JOURNAL_SECTORS - s
+                                                                          : IME_JOURNAL_BUFFER - 1;
+            ok = write_sectors(s, clear, n);
+            s += n;
+        }
+        if (!ok || !m_storage->sync(m_file)) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ImeJournal::close() {
+    if (m_file < 0)
+        return;
+    m_storage->close_file(m_file);
+    m_file = -1;
+}
+
+bool ImeJournal::append(uint8_t type, const void* data, uint16_t len) {
+    uint32_t size = record_size(len);
+    if (m_file < 0 || len > IME_JOURNAL_RECORD_MAX || m_end + size > capacity() ||
+        m_end + size > m_buf_start + sizeof(m_buf))
+        return false;
+    uint8_t* p = (uint8_t*)m_buf + (m_end - m_buf_start);
+    uint32_t head[RECORD_HEADER / 4] = { m_generation, (uint32_t)type | (uint32_t)len << 16,
+                                         record_crc(m_generation, type, len, data) };
+    memcpy(p, head, RECORD_HEADER);
+    memcpy(p + RECORD_HEADER, data, len);
+    m_end += size;
+    m_stats.records++;
+    return true;
+}
+
+// Rewrites the last partly filled sector and writes the ones after it
+bool ImeJournal::sync() {
+    if (m_file < 0)
+        return false;
+    if (!pending())
+        return true;
+    uint32_t first = m_synced / IME_JOURNAL_SECTOR;
+    uint32_t last = (m_end + IME_JOURNAL_SECTOR - 1) / IME_JOURNAL_SECTOR;
+    const uint8_t* buf = (const uint8_t*)m_buf + (first * IME_JOURNAL_SECTOR - m_buf_start);
+    if (!write_sectors(1 + first, buf, last - first) || !m_storage->sync(m_file))
+        return false;
+    m_synced = m_end;
+    m_stats.syncs++;
+
+    uint32_t tail = m_end / IME_JOURNAL_SECTOR * IME_JOURNAL_SECTOR;
+    if (tail > m_buf_start) {   // Keep only the partly filled sector
+        uint8_t* b = (uint8_t*)m_buf;
+        memmove(b, b + (tail - m_buf_start), m_end - tail);
+        memset(b + (m_end - tail), 0, sizeof(m_buf) - (m_end - tail));
+        m_buf_start = tail;
+    }
+    return true;
+}
+
+bool ImeJournal::reset(uint32_t base_len, uint32_t base_crc) {
+    if (m_file < 0)
+        return false;
+    uint32_t old_len = m_base_len, old_crc = m_base_crc;
+    m_generation++;
+    m_base_len = base_len;
+    m_base_crc = base_crc;
+    if (!write_header()) {      // The old header (and records) still hold
+        m_generation--;
+        m_base_len = old_len;
+        m_base_crc = old_crc;
+        return false;
+    }
+    m_end = m_synced = m_buf_start = 0;
+    memset(m_buf, 0, sizeof(m_buf));
+    m_stats.resets++;
+    return true;
+}
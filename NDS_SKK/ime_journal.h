@@ -0,0 +1,74 @@
+//
+// IME journal: small writes appended to one preallocated file, applied to their files later
+//  Each small update (an edit of the document) is appended as a record, and sync() writes the
+//  new records as whole sectors into a file that was created at its full size, so a sync
+//  neither allocates clusters nor rewrites partial sectors of the real files. The real files
+//  are brought up to date now and then (a checkpoint) by their owner, who then calls reset().
+//  After a power loss, open() hands the records of the last generation back for replay.
+//
+//  Layout: sector 0 is the header (generation, and the length and CRC of the file state the
+//  records apply to); records follow from sector 1. A record is a 12-byte header (generation,
+//  type, length, CRC) and its payload padded to 4 bytes. The record stream ends at the first
+//  record of another generation or with a bad CRC (a torn write).
+//
+#ifndef IME_JOURNAL_H
+#define IME_JOURNAL_H
+
+#include <stdint.h>
+
+#include "platform.h"
+
+#define IME_JOURNAL_SECTOR      512
+#define IME_JOURNAL_SECTORS     64      // File size in sectors (header + records)
+#define IME_JOURNAL_BUFFER      8       // Sectors of records kept in RAM between syncs
+#define IME_JOURNAL_RECORD_MAX  (IME_JOURNAL_BUFFER * IME_JOURNAL_SECTOR - IME_JOURNAL_SECTOR - 12) // Payload bytes
+
+typedef struct {
+	uint32_t records;           // Records appended
+	uint32_t syncs;
+	uint32_t sectors_written;   // Record and header sectors (not the preallocation)
+	uint32_t preallocated;      // Bytes written once to create the file at full size
+	uint32_t resets;            // Checkpoints completed
+	uint32_t replayed;          // Records handed back by open()
+} ImeJournalStats;
+
+// Replays one record; false stops the replay (the records after it are dropped)
+typedef bool (*ImeJournalApply)(void* user, uint8_t type, const uint8_t* data, uint16_t len);
+
+class ImeJournal {
+ public:
+	void init(PlatformStorage* storage);
+	// Open the journal at path, creating it at full size. Records written for the file state
+	// base_len/base_crc are passed to apply in order; records for another state are dropped.
+	// Returns false when the journal cannot be used (the owner then writes its files directly).
+	bool open(const char* path, uint32_t base_len, uint32_t base_crc,
+	          ImeJournalApply apply, void* user, uint32_t* replayed);
+	bool is_open() const { return m_file >= 0; }
+	void close();
+	bool append(uint8_t type, const void* data, uint16_t len); // false: no room until sync() or reset()
+	bool pending() const { return m_end != m_synced; }         // Appended records not written yet
+	bool sync();                                               // Write the appended records
+	bool reset(uint32_t base_len, uint32_t base_crc);          // The files hold all records: drop them
+	uint32_t used() const { return m_end; }                    // Bytes of records
+	uint32_t capacity() const { return (IME_JOURNAL_SECTORS - 1) * IME_JOURNAL_SECTOR; }
+	const ImeJournalStats& stats() const { return m_stats; }
+
+	static uint32_t crc32(uint32_t crc, const void* data, uint32_t len); // Start with crc = 0
+
+ private:
+	bool write_header();
+	bool write_sectors(uint32_t sector, const void* data, uint32_t count);
+
+	PlatformStorage* m_storage;
+	int32_t  m_file;
+	uint32_t m_generation;
+	uint32_t m_base_len;        // File state of the records (header)
+	uint32_t m_base_crc;
+	uint32_t m_end;             // Record area offset after the last record
+	uint32_t m_synced;          // Record area bytes written to the file
+	uint32_t m_buf_start;       // Record area offset of m_buf (a sector boundary)
+	ImeJournalStats m_stats;
+	uint32_t m_buf[IME_JOURNAL_BUFFER * IME_JOURNAL_SECTOR / 4]; // Records from the last written sector
+};
+
+#endif // IME_JOURNAL_H
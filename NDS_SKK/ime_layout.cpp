@@ -0,0 +1,145 @@
+#include <string.h>
+
+#include "ime_layout.h"
+
+void ImeLayout::init(ImeArena* arena, int width, int (*glyph_width)(uint16_t)) {
+    m_count.init(arena);
+    m_width = width;
+    m_glyph_width = glyph_width;
+    m_open_end = true;
+    m_anchor_line = 0;
+    m_anchor_start = 0;
+}
+
+uint32_t ImeLayout::line_length(uint32_t line) const {
+    return line < m_count.length() ? (m_count.at(line) & ~IME_LAYOUT_STALE) : 0;
+}
+
+// Glyphs that fit on a line starting at pos (at least one)
+uint32_t ImeLayout::wrap(const ImeLayoutSource& src, uint32_t pos, uint32_t len) const {
+    int x = 0;
+    uint32_t n = 0;
+    while (pos + n < len) {
+        uint16_t g = src.glyph(pos + n);
+        if (g == '\n')
+            return n + 1;
+        int w = m_glyph_width(g);
+        if (n > 0 && x + w > m_width)
+            break;
+        x += w;
+        n++;
+    }
+    return n;
+}
+
+void ImeLayout::update_end(const ImeLayoutSource& src) {
+    uint32_t len = src.length();
+    m_open_end = len == 0 || src.glyph(len - 1) == '\n';
+}
+
+void ImeLayout::reset(const ImeLayoutSource& src) {
+    uint32_t len = src.length();
+    m_count.clear();
+    for (uint32_t p = 0; p < len; ) {
+        uint32_t n = wrap(src, p, len);
+        m_count.insert((uint16_t)n);
+        p += n;
+    }
+    m_anchor_line = 0;
+    m_anchor_start = 0;
+    update_end(src);
+}
+
+// Re-wrap from line (starting at start) until a line start matches an old one. Old line starts
+// at or after old_end moved by delta; the ones before old_end are gone.
+void ImeLayout::relayout(const ImeLayoutSource& src, uint32_t line, uint32_t start, uint32_t old_end,
+                         int32_t delta, uint32_t max_lines, ImeLayoutChange* out) {
+    uint16_t fresh[IME_LAYOUT_BATCH + 1];
+    uint32_t len = src.length();
+    uint32_t count = m_count.length();
+    uint32_t k = line;      // First old line not replaced yet, starting at os (old coordinates)
+    uint32_t os = start;
+    uint32_t p = start;
+    uint32_t n = 0;
+
+    if (max_lines > IME_LAYOUT_BATCH)
+        max_lines = IME_LAYOUT_BATCH;
+    while (p < len) {
+        uint32_t l = wrap(src, p, len);
+        fresh[n++] = (uint16_t)l;
+        p += l;
+        while (k < count && (os < old_end || os + delta < p)) {
+            os += m_count.at(k) & ~IME_LAYOUT_STALE;
+            k++;
+        }
+        if (k < count && os + delta == p && !(m_count.at(k) & IME_LAYOUT_STALE))
+            break;          // Stable break: the following lines are unchanged
+        if (n == max_lines) {
+            // Leave the glyphs up to the next old line start for refresh()
+            uint32_t q = k < count ? os + delta : len;
+            if (q > p) {
+                uint32_t piece = q - p < IME_LAYOUT_STALE ? q - p : IME_LAYOUT_STALE - 1;
+                fresh[n++] = (uint16_t)(piece | IME_LAYOUT_STALE);
+            }
+            break;
+        }
+    }
+    if (p >= len)
+        k = count;          // The old lines left cover nothing
+
+    m_count.set_cursor(line);
+    m_count.erase_after(k - line);
+    m_count.insert(fresh, n);
+    out->first = line;
+    out->old_end = k;
+    out->new_end = line + n;
+    m_anchor_line = line;
+    m_anchor_start = start;
+    update_end(src);
+}
+
+void ImeLayout::edit(const ImeLayoutSource& src, uint32_t from, uint32_t old_end, uint32_t new_end,
+                     uint32_t max_lines, ImeLayoutChange* out) {
+    // The line before the edit may take glyphs from the start of the edited line
+    uint32_t start;
+    uint32_t line = line_of(from, &start);
+    if (line > 0) {
+        line--;
+        start -= line_length(line);
+    }
+    relayout(src, line, start, old_end, (int32_t)(new_end - old_end), max_lines, out);
+}
+
+void ImeLayout::refresh(const ImeLayoutSource& src, uint32_t line, uint32_t max_lines, ImeLayoutChange* out) {
+    uint32_t start = line_start(line);
+    relayout(src, line, start, start, 0, max_lines, out);
+}
+
+uint32_t ImeLayout::line_start(uint32_t line) {
+    while (m_anchor_line < line) {
+        m_anchor_start += line_length(m_anchor_line);
+        m_anchor_line++;
+    }
+    while (m_anchor_line > line) {
+        m_anchor_line--;
+        m_anchor_start -= line_length(m_anchor_line);
+    }
+    return m_anchor_start;
+}
+
+uint32_t ImeLayout::line_of(uint32_t pos, uint32_t* start) {
+    uint32_t count = m_count.length();
+    while (m_anchor_line > 0 && m_anchor_start > pos) {
+        m_anchor_line--;
+        m_anchor_start -= line_length(m_anchor_line);
+    }
+    while (m_anchor_line < count) {
+        uint32_t end = m_anchor_start + line_length(m_anchor_line);
+        if (pos < end || (pos == end && m_anchor_line + 1 == count && !m_open_end))
+            break;          // A caret at the end of the text stays on the last line
+        m_anchor_start = end;
+        m_anchor_line++;
+    }
+    *start = m_anchor_start;
+    return m_anchor_line;
+}
@@ -0,0 +1,69 @@
+//
+// IME layout: line wrapping of the displayed text, updated incrementally
+//  Lines are stored as glyph counts in a gap buffer (ImeText), so an edit replaces only the
+//  counts of the lines it touches. Re-wrapping starts at the line before the edit and stops at
+//  the first line start that matches an old one (a stable break), or after a fixed number of
+//  lines. In the latter case the glyphs up to the next old line start become one short line
+//  marked IME_LAYOUT_STALE, which is re-wrapped when it is shown (refresh()). The cost of an
+//  edit thus depends on the lines on screen, not on the length of the document.
+//  '\n' ends a line; other glyphs wrap when the line is full.
+//
+#ifndef IME_LAYOUT_H
+#define IME_LAYOUT_H
+
+#include <stdint.h>
+
+#include "ime_text.h"
+
+#define IME_LAYOUT_STALE   0x8000   // Line length flag: not wrapped yet
+#define IME_LAYOUT_BATCH   32       // Most lines re-wrapped by one edit() / refresh()
+
+// Glyphs to lay out (the committed text with the preedit at the cursor)
+class ImeLayoutSource {
+ public:
+	virtual ~ImeLayoutSource() {}
+	virtual uint32_t length() const = 0;
+	virtual uint16_t glyph(uint32_t pos) const = 0;
+};
+
+// Lines replaced by edit() / refresh(): [first, old_end) before, [first, new_end) after
+typedef struct {
+	uint32_t first;
+	uint32_t old_end;
+	uint32_t new_end;
+} ImeLayoutChange;
+
+class ImeLayout {
+ public:
+	// width: line width in pixels; glyph_width: advance of a glyph
+	void     init(ImeArena* arena, int width, int (*glyph_width)(uint16_t));
+	void     reset(const ImeLayoutSource& src);      // Wrap the whole source
+	// Glyphs [from, old_end) of the previous source were replaced by [from, new_end);
+	// re-wrap at most max_lines lines
+	void     edit(const ImeLayoutSource& src, uint32_t from, uint32_t old_end, uint32_t new_end,
+	              uint32_t max_lines, ImeLayoutChange* out);
+	void     refresh(const ImeLayoutSource& src, uint32_t line, uint32_t max_lines,
+	                 ImeLayoutChange* out);          // Re-wrap from a stale line
+
+	// Lines including the empty one after a final '\n' (or of an empty source)
+	uint32_t lines() const { return m_count.length() + (m_open_end ? 1 : 0); }
+	uint32_t line_length(uint32_t line) const;
+	bool     line_stale(uint32_t line) const { return line < m_count.length() && (m_count.at(line) & IME_LAYOUT_STALE); }
+	uint32_t line_start(uint32_t line);              // Walks from the last line looked up
+	uint32_t line_of(uint32_t pos, uint32_t* start); // Line showing the caret at pos
+
+ private:
+	uint32_t wrap(const ImeLayoutSource& src, uint32_t pos, uint32_t len) const;
+	void     relayout(const ImeLayoutSource& src, uint32_t line, uint32_t start, uint32_t old_end,
+	                  int32_t delta, uint32_t max_lines, ImeLayoutChange* out);
+	void     update_end(const ImeLayoutSource& src);
+
+	ImeText  m_count;              // Glyphs per line (| IME_LAYOUT_STALE)
+	int      m_width;
+	int      (*m_glyph_width)(uint16_t);
+	bool     m_open_end;           // An empty line follows the last one
+	uint32_t m_anchor_line;        // A line whose start is known
+	uint32_t m_anchor_start;
+};
+
+#endif // IME_LAYOUT_H
@@ -0,0 +1,131 @@
+#include <string.h>
+
+#include "ime_text.h"
+
+void ImeText::init(ImeArena* arena) {
+    m_arena = arena;
+    m_buf = NULL;
+    m_cap = 0;
+    m_gap_start = 0;
+    m_gap_end = 0;
+    m_changed = false;
+}
+
+void ImeText::clear() {
+    uint32_t len = length();
+    m_gap_start = 0;
+    m_gap_end = m_cap;
+    if (len > 0)
+        changed(0, 0, -(int32_t)len);
+}
+
+uint32_t ImeText::copy(uint32_t pos, uint32_t n, uint16_t* dst) const {
+    uint32_t len = length();
+    if (pos >= len)
+        return 0;
+    if (n > len - pos)
+        n = len - pos;
+    uint32_t done = 0;
+    if (pos < m_gap_start) {  // Part before the gap
+        done = m_gap_start - pos < n ? m_gap_start - pos : n;
+        memcpy(dst, &m_buf[pos], done * sizeof(uint16_t));
+    }
+    if (done < n)             // Part after the gap
+        memcpy(&dst[done], &m_buf[pos + done + (m_gap_end - m_gap_start)], (n - done) * sizeof(uint16_t));
+    return n;
+}
+
+// Make room for n more glyphs, doubling the buffer
+bool ImeText::reserve(uint32_t n) {
+    if (m_gap_end - m_gap_start >= n)
+        return true;
+    uint32_t len = length();
+    uint32_t cap = m_cap ? m_cap * 2 : IME_TEXT_MIN_CAP;
+    while (cap < len + n)
+        cap *= 2;
+    uint32_t got;
+    uint16_t* buf = (uint16_t*)m_arena->alloc(cap * sizeof(uint16_t), &got);
+    if (buf == NULL)
+        return false;
+    cap = got / sizeof(uint16_t);
+    uint32_t tail = m_cap - m_gap_end;
+    if (m_buf != NULL) {
+        memcpy(buf, m_buf, m_gap_start * sizeof(uint16_t));
+        memcpy(&buf[cap - tail], &m_buf[m_gap_end], tail * sizeof(uint16_t));
+        m_arena->free(m_buf, m_cap * sizeof(uint16_t));
+    }
+    m_buf = buf;
+    m_cap = cap;
+    m_gap_end = cap - tail;
+    return true;
+}
+
+bool ImeText::insert(const uint16_t* text, uint32_t n) {
+    if (n == 0)
+        return true;
+    if (!reserve(n))
+        return false;
+    memcpy(&m_buf[m_gap_start], text, n * sizeof(uint16_t));
+    m_gap_start += n;
+    changed(m_gap_start - n, m_gap_start, (int32_t)n);
+    return true;
+}
+
+uint32_t ImeText::erase_before(uint32_t n) {
+    if (n > m_gap_start)
+        n = m_gap_start;
+    m_gap_start -= n;
+    if (n > 0)
+        changed(m_gap_start, m_gap_start, -(int32_t)n);
+    return n;
+}
+
+uint32_t ImeText::erase_after(uint32_t n) {
+    if (n > m_cap - m_gap_end)
+        n = m_cap - m_gap_end;
+    m_gap_end += n;
+    if (n > 0)
+        changed(m_gap_start, m_gap_start, -(int32_t)n);
+    return n;
+}
+
+void ImeText::set_cursor(uint32_t pos) {
+    uint32_t gap = m_gap_end - m_gap_start;
+    if (pos > length())
+        pos = length();
+    if (pos < m_gap_start) {        // Glyphs [pos, gap start) move behind the gap
+        uint32_t n = m_gap_start - pos;
+        memmove(&m_buf[m_gap_end - n], &m_buf[pos], n * sizeof(uint16_t));
+    } else if (pos > m_gap_start) { // Glyphs after the gap move in front of it
+        uint32_t n = pos - m_gap_start;
+        memmove(&m_buf[m_gap_start], &m_buf[m_gap_end], n * sizeof(uint16_t));
+    }
+    m_gap_start = pos;
+    m_gap_end = pos + gap;
+}
+
+// Merge an edit into the pending change. Spans are in the coordinates after the edit.
+void ImeText::changed(uint32_t from, uint32_t to, int32_t delta) {
+    if (!m_changed) {
+        m_change.from = from;
+        m_change.to = to;
+        m_change.delta = delta;
+        m_changed = true;
+        return;
+    }
+    uint32_t old_to = m_change.to;
+    if (old_to > from)              // The earlier span ends after this edit: it moved with it
+        old_to = (int32_t)old_to + delta > (int32_t)to ? old_to + delta : to;
+    if (from < m_change.from)
+        m_change.from = from;
+    m_change.to = old_to > to ? old_to : to;
+    m_change.delta += delta;
+}
+
+bool ImeText::take_change(ImeTextChange* out) {
+    if (!m_changed)
+        return false;
+    *out = m_change;
+    m_changed = false;
+    return true;
+}
@@ -0,0 +1,55 @@
+//
+// IME text: committed text as a gap buffer of glyph codes (ime_glyph.h)
+//  The gap sits at the cursor, so inserting and deleting there is O(1) amortized; moving the
+//  cursor moves the gap. The buffer grows by doubling in an ImeArena. Edits are collected into
+//  one changed span that the renderer takes with take_change() and redraws from.
+//
+#ifndef IME_TEXT_H
+#define IME_TEXT_H
+
+#include <stdint.h>
+
+#include "ime_arena.h"
+
+#define IME_TEXT_MIN_CAP 128   // Glyphs allocated on the first insert
+
+// Text changed since the last take_change(): glyphs [from, to) are new, and everything that
+// followed the edit moved by delta glyphs. Several edits are merged into one covering span.
+typedef struct {
+	uint32_t from;
+	uint32_t to;
+	int32_t  delta;
+} ImeTextChange;
+
+class ImeText {
+ public:
+	void     init(ImeArena* arena);                      // Empty, nothing allocated yet
+	void     clear();                                    // Remove all text (the buffer is kept)
+	uint32_t length() const { return m_cap - (m_gap_end - m_gap_start); }
+	uint32_t cursor() const { return m_gap_start; }
+	uint16_t at(uint32_t i) const { return m_buf[i < m_gap_start ? i : i + (m_gap_end - m_gap_start)]; }
+	uint32_t copy(uint32_t pos, uint32_t n, uint16_t* dst) const; // Glyphs [pos, pos + n) to dst; returns count
+
+	bool     insert(const uint16_t* text, uint32_t n);   // At the cursor; false (nothing inserted) when out of memory
+	bool     insert(uint16_t glyph) { return insert(&glyph, 1); }
+	uint32_t erase_before(uint32_t n);                   // Backspace; returns glyphs erased
+	uint32_t erase_after(uint32_t n);                    // Delete; returns glyphs erased
+	void     set_cursor(uint32_t pos);                   // Clamped to the length
+	void     move_cursor(int32_t delta) { set_cursor(delta < 0 && (uint32_t)-delta > cursor() ? 0 : cursor() + delta); }
+
+	bool     take_change(ImeTextChange* out);            // false when unchanged since the last call
+
+ private:
+	bool     reserve(uint32_t n);
+	void     changed(uint32_t from, uint32_t to, int32_t delta);
+
+	ImeArena* m_arena;
+	uint16_t* m_buf;
+	uint32_t  m_cap;             // Glyphs in m_buf
+	uint32_t  m_gap_start;       // Gap [m_gap_start, m_gap_end) in m_buf
+	uint32_t  m_gap_end;
+	bool      m_changed;
+	ImeTextChange m_change;
+};
+
+#endif // IME_TEXT_H
@@ -0,0 +1,130 @@
+#include <string.h>
+
+#include "ime_trace.h"
+
+#define IME_TRACE_MAX_RECORD 11   // varint (5) + flags + key + buttons (2) + touch (2)
+
+static void put_varint(uint8_t* p, uint32_t* len, uint32_t v) {
+	while (v >= 0x80) {
+		p[(*len)++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	p[(*len)++] = (uint8_t)v;
+}
+
+static bool get_varint(const uint8_t* p, uint32_t len, uint32_t* pos, uint32_t* v) {
+	uint32_t shift = 0;
+	*v = 0;
+	while (*pos < len && shift < 35) {
+		uint8_t b = p[(*pos)++];
+		*v |= (uint32_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return true;
+		shift += 7;
+	}
+	return false;
+}
+
+static void put_record(ImeTraceWriter* w, uint8_t flags, const ImeInput* in) {
+	if (w->overflow || w->len + IME_TRACE_MAX_RECORD > w->cap) {
+		w->overflow = true;
+		return;
+	}
+	put_varint(w->buf, &w->len, w->frame - w->last_frame);
+	w->last_frame = w->frame;
+	w->buf[w->len++] = flags;
+	if (flags & IME_TRACE_KEY)
+		w->buf[w->len++] = in->key;
+	if (flags & IME_TRACE_BUTTONS) {
+		w->buf[w->len++] = (uint8_t)in->buttons;
+		w->buf[w->len++] = (uint8_t)(in->buttons >> 8);
+	}
+	if (flags & IME_TRACE_TOUCH) {
+		w->buf[w->len++] = in->touch_x;
+		w->buf[w->len++] = in->touch_y;
+	}
+}
+
+void imeTrace_begin(ImeTraceWriter* w, uint8_t* buf, uint32_t cap) {
+	w->buf = buf;
+	w->cap = cap;
+	w->len = 0;
+	w->frame = 0;
+	w->last_frame = 0;
+	w->overflow = cap < 4 + IME_TRACE_MAX_RECORD;
+	if (!w->overflow) {
+		memcpy(buf, IME_TRACE_MAGIC, 4);
+		w->len = 4;
+	}
+}
+
+void imeTrace_record(ImeTraceWriter* w, const ImeInput* in) {
+	uint8_t flags = 0;
+	if (in->key)
+		flags |= IME_TRACE_KEY;
+	if (in->buttons)
+		flags |= IME_TRACE_BUTTONS;
+	if (in->buttons & IME_BTN_TOUCH)
+		flags |= IME_TRACE_TOUCH;
+	if (flags)
+		put_record(w, flags, in);
+	w->frame++;
+}
+
+uint32_t imeTrace_finish(ImeTraceWriter* w) {
+	put_record(w, IME_TRACE_END, NULL);
+	return w->overflow ? 0 : w->len;
+}
+
+// Decode the next record into r->next / r->next_frame
+static void read_record(ImeTraceReader* r) {
+	uint32_t delta;
+	if (!get_varint(r->buf, r->len, &r->pos, &delta) || r->pos >= r->len) {
+		r->ended = true;
+		return;
+	}
+	r->next_frame += delta;
+	r->next_flags = r->buf[r->pos++];
+	memset(&r->next, 0, sizeof(r->next));
+
+	uint32_t need = ((r->next_flags & IME_TRACE_KEY) ? 1 : 0) +
+	                ((r->next_flags & IME_TRACE_BUTTONS) ? 2 : 0) +
+	                ((r->next_flags & IME_TRACE_TOUCH) ? 2 : 0);
+	if (r->pos + need > r->len) {
+		r->ended = true;
+		return;
+	}
+	if (r->next_flags & IME_TRACE_KEY)
+		r->next.key = r->buf[r->pos++];
+	if (r->next_flags & IME_TRACE_BUTTONS) {
+		r->next.buttons = r->buf[r->pos] | (r->buf[r->pos + 1] << 8);
+		r->pos += 2;
+	}
+	if (r->next_flags & IME_TRACE_TOUCH) {
+		r->next.touch_x = r->buf[r->pos++];
+		r->next.touch_y = r->buf[r->pos++];
+	}
+}
+
+bool imeTrace_open(ImeTraceReader* r, const uint8_t* buf, uint32_t len) {
+	memset(r, 0, sizeof(*r));
+	if (len < 4 || memcmp(buf, IME_TRACE_MAGIC, 4) != 0)
+		return false;
+	r->buf = buf;
+	r->len = len;
+	r->pos = 4;
+	read_record(r);
+	return !r->ended;
+}
+
+bool imeTrace_next(ImeTraceReader* r, ImeInput* in) {
+	if (r->ended || (r->frame == r->next_frame && (r->next_flags & IME_TRACE_END)))
+		return false;
+	memset(in, 0, sizeof(*in));
+	if (r->frame == r->next_frame) {
+		*in = r->next;
+		read_record(r);
+	}
+	r->frame++;
+	return true;
+}
@@ -0,0 +1,64 @@
+//
+// IME input trace: compact frame-stamped event log for deterministic replay
+//
+//  Format (little endian):
+//   "IMT1"
+//   records: varint frames since the previous record, flags byte, then
+//            key (u8)        if flags & IME_TRACE_KEY
+//            buttons (u16)   if flags & IME_TRACE_BUTTONS
+//            touch x, y (u8) if flags & IME_TRACE_TOUCH
+//   the last record has IME_TRACE_END; its frame is the session length
+//  Frames without input are not stored.
+//
+#ifndef IME_TRACE_H
+#define IME_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ime_core.h"
+
+#define IME_TRACE_MAGIC    "IMT1"
+#define IME_TRACE_KEY      0x01
+#define IME_TRACE_BUTTONS  0x02
+#define IME_TRACE_TOUCH    0x04
+#define IME_TRACE_END      0x80
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	uint8_t* buf;
+	uint32_t cap;
+	uint32_t len;
+	uint32_t frame;          // Frames recorded so far
+	uint32_t last_frame;     // Frame of the previous record
+	bool     overflow;       // Buffer full; later events were dropped
+} ImeTraceWriter;
+
+typedef struct {
+	const uint8_t* buf;
+	uint32_t len;
+	uint32_t pos;
+	uint32_t frame;          // Frame returned by the next imeTrace_next()
+	uint32_t next_frame;     // Frame of the pending record
+	uint8_t  next_flags;
+	ImeInput next;           // Input of the pending record
+	bool     ended;          // Reached the end record (or a malformed record)
+} ImeTraceReader;
+
+// Recording: call imeTrace_record() once per frame, then imeTrace_finish()
+void     imeTrace_begin(ImeTraceWriter* w, uint8_t* buf, uint32_t cap);
+void     imeTrace_record(ImeTraceWriter* w, const ImeInput* in);
+uint32_t imeTrace_finish(ImeTraceWriter* w);   // Returns the trace size in bytes (0 on overflow)
+
+// Replay: imeTrace_next() yields the input of each recorded frame in order
+bool     imeTrace_open(ImeTraceReader* r, const uint8_t* buf, uint32_t len);
+bool     imeTrace_next(ImeTraceReader* r, ImeInput* in);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IME_TRACE_H
@@ -1,6 +1,8 @@
 #ifndef KANA_IME_H
 #define KANA_IME_H
 
+#include "ime_core.h"  // ImeMode
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -19,17 +21,12 @@ void kanaIME_showKeyboard(void);
 // キーボードを非表示にする関数
 void kanaIME_hideKeyboard(void);
 
+// ローマ字列をまとめて入力する関数（スクリプト入力・貼り付け用）
+bool kanaIME_injectText(const char* text);
+
 // 入力された文字を取得する関数（仮）
 char kanaIME_getChar(void);
 
-// Input Modes
-typedef enum {
-	IME_MODE_HIRAGANA,
-	IME_MODE_KATAKANA,
-	IME_MODE_ENGLISH,
-	IME_MODE_DEBUG,
-} ImeMode;
-
 extern ImeMode currentImeMode; // Global variable to hold the current mode
 
 #ifdef __cplusplus
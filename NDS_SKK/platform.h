@@ -0,0 +1,79 @@
+//
+// Platform interfaces used by the IME application (ime_app.h)
+//  platform_nds.h implements them with libnds, platform_linux.h with the C library
+//  and an in-memory framebuffer for benchmarks and replay tools.
+//
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ime_core.h"
+
+#define PLATFORM_FB_WIDTH  256   // Same as libnds SCREEN_WIDTH (drawFont() stride)
+#define PLATFORM_FB_HEIGHT 192
+
+// Per-frame input source
+class PlatformInput {
+ public:
+	virtual ~PlatformInput() {}
+	virtual bool poll(ImeInput* in) = 0;         // Input for the next frame; false when the source is exhausted
+
+	// Queue every event available this frame; false when the source is exhausted.
+	// Sources that can deliver more than one event per frame override this.
+	virtual bool fill(ImeInputQueue* queue) {
+		ImeInput in;
+		if (!poll(&in))
+			return false;
+		if (in.key || in.buttons)
+			queue->push(in);
+		return true;
+	}
+};
+
+// 16-bit RGB555 framebuffer of PLATFORM_FB_WIDTH x PLATFORM_FB_HEIGHT pixels
+class PlatformFramebuffer {
+ public:
+	virtual ~PlatformFramebuffer() {}
+	virtual uint16_t* pixels() = 0;
+	virtual void      clear() = 0;               // Fill with black
+	virtual void      present() = 0;             // Frame finished
+};
+
+// Monotonic microsecond clock
+class PlatformClock {
+ public:
+	virtual ~PlatformClock() {}
+	virtual uint32_t now_us() = 0;
+};
+
+#define PLATFORM_MAX_FILES 4   // Files open at the same time through open_file()
+
+// Files and diagnostic messages
+class PlatformStorage {
+ public:
+	virtual ~PlatformStorage() {}
+	virtual bool    write_file(const char* path, const void* data, uint32_t len) = 0;
+	virtual int32_t read_file(const char* path, void* buf, uint32_t cap) = 0;   // Bytes read, -1 on error
+	virtual void    log(const char* msg) = 0;
+
+	// Files kept open and accessed in pieces (documents saved chunk by chunk)
+	virtual int32_t open_file(const char* path) = 0;      // Open for update, created if missing; handle or -1
+	virtual int32_t read_at(int32_t file, uint32_t offset, void* buf, uint32_t len) = 0; // Bytes read, -1 on error
+	virtual bool    write_at(int32_t file, uint32_t offset, const void* data, uint32_t len) = 0;
+	virtual bool    truncate(int32_t file, uint32_t len) = 0;
+	virtual bool    sync(int32_t file) = 0;               // Written data reaches the medium
+	virtual bool    close_file(int32_t file) = 0;
+	virtual bool    rename_file(const char* from, const char* to) = 0; // to must not exist
+	virtual bool    remove_file(const char* path) = 0;
+};
+
+struct Platform {
+	PlatformInput*       input;
+	PlatformFramebuffer* fb;
+	PlatformClock*       clock;
+	PlatformStorage*     storage;
+};
+
+#endif // PLATFORM_H
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "platform_linux.h"
+
+bool TraceInput::open(const uint8_t* trace, uint32_t len) {
+    return imeTrace_open(&m_reader, trace, len);
+}
+
+bool TraceInput::poll(ImeInput* in) {
+    return imeTrace_next(&m_reader, in);
+}
+
+void MemoryFramebuffer::clear() {
+    memset(m_pixels, 0, sizeof(m_pixels));
+}
+
+void MemoryFramebuffer::present() {
+    m_frames++;
+}
+
+// FNV-1a over the pixels
+uint32_t MemoryFramebuffer::checksum() const {
+    const uint8_t* p = (const uint8_t*)m_pixels;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(m_pixels); i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+uint32_t PosixClock::now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+}
+
+// Device paths are absolute ("/nds_skk_trace.bin"); place them under the base directory
+void FileStorage::full_path(char* dst, uint32_t size, const char* path) {
+    while (*path == '/')
+        path++;
+    snprintf(dst, size, "%s/%s", m_base, path);
+}
+
+bool FileStorage::write_file(const char* path, const void* data, uint32_t len) {
+    char full[512];
+    full_path(full, sizeof(full), path);
+    FILE* fp = fopen(full, "wb");
+    if (fp == NULL)
+        return false;
+    bool ok = fwrite(data, 1, len, fp) == len;
+    return (fclose(fp) == 0) && ok;
+}
+
+int32_t FileStorage::read_file(const char* path, void* buf, uint32_t cap) {
+    char full[512];
+    full_path(full, sizeof(full), path);
+    FILE* fp = fopen(full, "rb");
+    if (fp == NULL)
+        return -1;
+    int32_t n = (int32_t)fread(buf, 1, cap, fp);
+    fclose(fp);
+    return n;
+}
+
+void FileStorage::log(const char* msg) {
+    fprintf(stderr, "%s\n", msg);
+}
+
+int32_t FileStorage::open_file(const char* path) {
+    char full[512];
+    full_path(full, sizeof(full), path);
+    int32_t file = 0;
+    while (file < PLATFORM_MAX_FILES && m_files[file] != NULL)
+        file++;
+    if (file == PLATFORM_MAX_FILES)
+        return -1;
+    FILE* fp = fopen(full, "r+b");
+    if (fp == NULL)
+        fp = fopen(full, "w+b");
+    if (fp == NULL)
+        return -1;
+    m_files[file] = fp;
+    return file;
+}
+
+int32_t FileStorage::read_at(int32_t file, uint32_t offset, void* buf, uint32_t len) {
+    FILE* fp = m_files[file];
+    if (fseek(fp, offset, SEEK_SET) != 0)
+        return -1;
+    size_t n = fread(buf, 1, len, fp);
+    return (n < len && ferror(fp)) ? -1 : (int32_t)n;
+}
+
+bool FileStorage::write_at(int32_t file, uint32_t offset, const void* data, uint32_t len) {
+    FILE* fp = m_files[file];
+    m_writes++;
+    m_bytes_written += len;
+    return fseek(fp, offset, SEEK_SET) == 0 && fwrite(data, 1, len, fp) == len;
+}
+
+bool FileStorage::truncate(int32_t file, uint32_t len) {
+    FILE* fp = m_files[file];
+    return fflush(fp) == 0 && ftruncate(fileno(fp), len) == 0;
+}
+
+bool FileStorage::sync(int32_t file) {
+    m_syncs++;
+    return fflush(m_files[file]) == 0;   // The page cache is the medium here
+}
+
+bool FileStorage::close_file(int32_t file) {
+    FILE* fp = m_files[file];
+    m_files[file] = NULL;
+    return fclose(fp) == 0;
+}
+
+bool FileStorage::rename_file(const char* from, const char* to) {
+    char full_from[512], full_to[512];
+    full_path(full_from, sizeof(full_from), from);
+    full_path(full_to, sizeof(full_to), to);
+    return rename(full_from, full_to) == 0;
+}
+
+bool FileStorage::remove_file(const char* path) {
+    char full[512];
+    full_path(full, sizeof(full), path);
+    return remove(full) == 0;
+}
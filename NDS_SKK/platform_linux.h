@@ -0,0 +1,72 @@
+//
+// Linux implementation of the platform interfaces
+//  Input comes from a recorded trace (ime_trace.h) and frames are drawn into memory,
+//  so the whole IME pipeline runs at full host speed without libnds.
+//
+#ifndef PLATFORM_LINUX_H
+#define PLATFORM_LINUX_H
+
+#include <stdio.h>
+
+#include "platform.h"
+#include "ime_trace.h"
+
+// Replays an input trace; exhausted at the end of the recorded session
+class TraceInput : public PlatformInput {
+ public:
+	bool open(const uint8_t* trace, uint32_t len);
+	bool poll(ImeInput* in);
+	uint32_t frame() const { return m_reader.frame; }
+ private:
+	ImeTraceReader m_reader;
+};
+
+// In-memory framebuffer
+class MemoryFramebuffer : public PlatformFramebuffer {
+ public:
+	uint16_t* pixels() { return m_pixels; }
+	void      clear();
+	void      present();
+	uint32_t  frames() const { return m_frames; }
+	uint32_t  checksum() const;                  // Hash of the current pixels
+ private:
+	uint16_t  m_pixels[PLATFORM_FB_WIDTH * PLATFORM_FB_HEIGHT];
+	uint32_t  m_frames = 0;
+};
+
+// clock_gettime(CLOCK_MONOTONIC)
+class PosixClock : public PlatformClock {
+ public:
+	uint32_t now_us();
+};
+
+// stdio files relative to a base directory; messages go to stderr
+class FileStorage : public PlatformStorage {
+ public:
+	explicit FileStorage(const char* base_dir = ".") : m_base(base_dir) {}
+	bool    write_file(const char* path, const void* data, uint32_t len);
+	int32_t read_file(const char* path, void* buf, uint32_t cap);
+	void    log(const char* msg);
+	int32_t open_file(const char* path);
+	int32_t read_at(int32_t file, uint32_t offset, void* buf, uint32_t len);
+	bool    write_at(int32_t file, uint32_t offset, const void* data, uint32_t len);
+	bool    truncate(int32_t file, uint32_t len);
+	bool    sync(int32_t file);
+	bool    close_file(int32_t file);
+	bool    rename_file(const char* from, const char* to);
+	bool    remove_file(const char* path);
+
+	// Traffic through write_at() / sync(), for measuring autosave
+	uint64_t bytes_written() const { return m_bytes_written; }
+	uint32_t writes() const { return m_writes; }
+	uint32_t syncs() const { return m_syncs; }
+ private:
+	void    full_path(char* dst, uint32_t size, const char* path);
+	const char* m_base;
+	FILE*   m_files[PLATFORM_MAX_FILES] = {};
+	uint64_t m_bytes_written = 0;
+	uint32_t m_writes = 0;
+	uint32_t m_syncs = 0;
+};
+
+#endif // PLATFORM_LINUX_H
@@ -0,0 +1,142 @@
+#include <nds.h>
+#include <fat.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "platform_nds.h"
+
+void NdsInput::init() {
+    consoleDemoInit();
+    keyboardDemoInit();
+    keyboardShow();
+}
+
+bool NdsInput::poll(ImeInput* in) {
+    scanKeys();
+    int key = keyboardUpdate();
+
+    in->key = (key > 0 && key < 0x100) ? (uint8_t)key : 0;
+    in->buttons = (uint16_t)keysDown();   // KEY_* has the IME_BTN_* layout
+    in->touch_x = in->touch_y = 0;
+    if (in->buttons & KEY_TOUCH) {
+        touchPosition touch;
+        touchRead(&touch);
+        in->touch_x = (uint8_t)touch.px;
+        in->touch_y = (uint8_t)touch.py;
+    }
+    return true;
+}
+
+void NdsInput::show_keyboard() { keyboardShow(); }
+void NdsInput::hide_keyboard() { keyboardHide(); }
+
+void NdsFramebuffer::init() {
+    videoSetMode(MODE_FB0);
+    vramSetBankA(VRAM_A_LCD);
+    m_pixels = (uint16_t*)VRAM_A;
+}
+
+void NdsFramebuffer::clear() {
+    dmaFillWords(0, m_pixels, PLATFORM_FB_WIDTH * PLATFORM_FB_HEIGHT * 2);
+}
+
+void NdsClock::init() {
+    cpuStartTiming(0);
+    m_last_ticks = 0;
+    m_total_ticks = 0;
+}
+
+// The timer wraps every 2^32 bus clock ticks (about 128 s); the unsigned difference
+// from the previous read survives one wrap, so it is added to a 64-bit total.
+// The application reads the clock every frame.
+uint32_t NdsClock::now_us() {
+    uint32_t ticks = cpuGetTiming();
+    m_total_ticks += (uint32_t)(ticks - m_last_ticks);
+    m_last_ticks = ticks;
+    return (uint32_t)(m_total_ticks * 1000000 / BUS_CLOCK);
+}
+
+bool NdsStorage::mount() {
+    if (!m_mounted)
+        m_mounted = fatInitDefault();
+    return m_mounted;
+}
+
+bool NdsStorage::write_file(const char* path, const void* data, uint32_t len) {
+    if (!mount())
+        return false;
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL)
+        return false;
+    bool ok = fwrite(data, 1, len, fp) == len;
+    return (fclose(fp) == 0) && ok;
+}
+
+int32_t NdsStorage::read_file(const char* path, void* buf, uint32_t cap) {
+    if (!mount())
+        return -1;
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+    int32_t n = (int32_t)fread(buf, 1, cap, fp);
+    fclose(fp);
+    return n;
+}
+
+void NdsStorage::log(const char* msg) {
+    iprintf("%s\n", msg);
+}
+
+int32_t NdsStorage::open_file(const char* path) {
+    if (!mount())
+        return -1;
+    int32_t file = 0;
+    while (file < PLATFORM_MAX_FILES && m_files[file] != NULL)
+        file++;
+    if (file == PLATFORM_MAX_FILES)
+        return -1;
+    FILE* fp = fopen(path, "r+b");
+    if (fp == NULL)
+        fp = fopen(path, "w+b");
+    if (fp == NULL)
+        return -1;
+    m_files[file] = fp;
+    return file;
+}
+
+int32_t NdsStorage::read_at(int32_t file, uint32_t offset, void* buf, uint32_t len) {
+    FILE* fp = m_files[file];
+    if (fseek(fp, offset, SEEK_SET) != 0)
+        return -1;
+    size_t n = fread(buf, 1, len, fp);
+    return (n < len && ferror(fp)) ? -1 : (int32_t)n;
+}
+
+bool NdsStorage::write_at(int32_t file, uint32_t offset, const void* data, uint32_t len) {
+    FILE* fp = m_files[file];
+    return fseek(fp, offset, SEEK_SET) == 0 && fwrite(data, 1, len, fp) == len;
+}
+
+bool NdsStorage::truncate(int32_t file, uint32_t len) {
+    FILE* fp = m_files[file];
+    return fflush(fp) == 0 && ftruncate(fileno(fp), len) == 0;
+}
+
+bool NdsStorage::sync(int32_t file) {
+    FILE* fp = m_files[file];
+    return fflush(fp) == 0 && fsync(fileno(fp)) == 0;   // libfat writes its sector cache back
+}
+
+bool NdsStorage::close_file(int32_t file) {
+    FILE* fp = m_files[file];
+    m_files[file] = NULL;
+    return fclose(fp) == 0;
+}
+
+bool NdsStorage::rename_file(const char* from, const char* to) {
+    return mount() && rename(from, to) == 0;
+}
+
+bool NdsStorage::remove_file(const char* path) {
+    return mount() && remove(path) == 0;
+}
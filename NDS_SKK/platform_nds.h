@@ -0,0 +1,61 @@
+//
+// libnds implementation of the platform interfaces (ARM9 only)
+//
+#ifndef PLATFORM_NDS_H
+#define PLATFORM_NDS_H
+
+#include <stdio.h>
+
+#include "platform.h"
+
+// Buttons and the libnds software keyboard on the bottom screen
+class NdsInput : public PlatformInput {
+ public:
+	void init();
+	bool poll(ImeInput* in);
+	void show_keyboard();
+	void hide_keyboard();
+};
+
+// Main screen in framebuffer mode (VRAM bank A)
+class NdsFramebuffer : public PlatformFramebuffer {
+ public:
+	void      init();
+	uint16_t* pixels() { return m_pixels; }
+	void      clear();
+	void      present() {}
+ private:
+	uint16_t* m_pixels = NULL;
+};
+
+// Timers 0 and 1 cascaded, counting at the bus clock
+class NdsClock : public PlatformClock {
+ public:
+	void     init();
+	uint32_t now_us();
+ private:
+	uint32_t m_last_ticks = 0;    // Timer value at the previous read
+	uint64_t m_total_ticks = 0;   // Ticks since init()
+};
+
+// libfat (initialized on first use); messages go to the bottom screen console
+class NdsStorage : public PlatformStorage {
+ public:
+	bool    write_file(const char* path, const void* data, uint32_t len);
+	int32_t read_file(const char* path, void* buf, uint32_t cap);
+	void    log(const char* msg);
+	int32_t open_file(const char* path);
+	int32_t read_at(int32_t file, uint32_t offset, void* buf, uint32_t len);
+	bool    write_at(int32_t file, uint32_t offset, const void* data, uint32_t len);
+	bool    truncate(int32_t file, uint32_t len);
+	bool    sync(int32_t file);
+	bool    close_file(int32_t file);
+	bool    rename_file(const char* from, const char* to);
+	bool    remove_file(const char* path);
+ private:
+	bool    mount();
+	bool    m_mounted = false;
+	FILE*   m_files[PLATFORM_MAX_FILES] = {};
+};
+
+#endif // PLATFORM_NDS_H
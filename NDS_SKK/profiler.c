@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARM9
+#include <nds.h>
+#else
+#include <time.h>
+#endif
+
+#include "profiler.h"
+
+static const char* const s_phase_names[PROF_PHASE_COUNT] = {
+	"INPUT", "ROMAJI", "LOOKUP", "LAYOUT", "DRAW", "SAVE",
+};
+
+static uint32_t s_start[PROF_PHASE_COUNT];                  // Start time of the open scope
+static uint32_t s_frame[PROF_PHASE_COUNT];                  // Time accumulated in the current frame
+static uint32_t s_window[PROF_WINDOW][PROF_PHASE_COUNT];    // Per-frame totals, ring buffer
+static uint32_t s_frames = 0;                               // Frames recorded so far
+#ifdef ARM9
+static uint32_t s_last_ticks = 0;                           // Timer value at the previous read
+static uint64_t s_total_ticks = 0;                          // Ticks since prof_init(), 64-bit
+#endif
+
+// Current time in microseconds (wraps after about 71 minutes; only differences are used)
+static uint32_t prof_now_us(void) {
+#ifdef ARM9
+	// Timers 0 and 1 cascaded by cpuStartTiming() count at the bus clock and wrap
+	// every 2^32 ticks (about 128 s). The unsigned difference from the previous read
+	// survives one wrap, so it is summed in 64 bits; prof_begin()/prof_end() read the
+	// timer every frame, far more often than that.
+	uint32_t ticks = cpuGetTiming();
+	s_total_ticks += (uint32_t)(ticks - s_last_ticks);
+	s_last_ticks = ticks;
+	return (uint32_t)(s_total_ticks * 1000000 / BUS_CLOCK);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+#endif
+}
+
+void prof_init(void) {
+#ifdef ARM9
+	cpuStartTiming(0);
+	s_last_ticks = 0;
+	s_total_ticks = 0;
+#endif
+	memset(s_frame, 0, sizeof(s_frame));
+	memset(s_window, 0, sizeof(s_window));
+	s_frames = 0;
+}
+
+void prof_begin(ProfPhase phase) {
+	s_start[phase] = prof_now_us();
+}
+
+void prof_end(ProfPhase phase) {
+	s_frame[phase] += prof_now_us() - s_start[phase];
+}
+
+void prof_frame_end(void) {
+	memcpy(s_window[s_frames % PROF_WINDOW], s_frame, sizeof(s_frame));
+	memset(s_frame, 0, sizeof(s_frame));
+	s_frames++;
+}
+
+void prof_get(ProfPhase phase, ProfStats* stats) {
+	uint32_t n = (s_frames < PROF_WINDOW) ? s_frames : PROF_WINDOW;
+	uint32_t sum = 0;
+
+	memset(stats, 0, sizeof(*stats));
+	if (n == 0)
+		return;
+	stats->last = s_window[(s_frames - 1) % PROF_WINDOW][phase];
+	stats->min = UINT32_MAX;
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t t = s_window[i][phase];
+		sum += t;
+		if (t < stats->min)
+			stats->min = t;
+		if (t > stats->max)
+			stats->max = t;
+	}
+	stats->avg = sum / n;
+}
+
+const char* prof_phase_name(ProfPhase phase) {
+	return (phase < PROF_PHASE_COUNT) ? s_phase_names[phase] : "?";
+}
+
+// One row per frame, oldest first: frame number followed by each phase in microseconds
+uint32_t prof_dump(char* buf, uint32_t cap) {
+	uint32_t len = 0;
+	int n;
+
+#define PROF_APPEND(...) \
+	do { \
+		n = snprintf(buf + len, cap - len, __VA_ARGS__); \
+		if (n < 0 || (uint32_t)n >= cap - len) \
+			return 0; \
+		len += n; \
+	} while (0)
+
+	if (cap == 0)
+		return 0;
+	PROF_APPEND("frame");
+	for (int p = 0; p < PROF_PHASE_COUNT; p++)
+		PROF_APPEND(",%s", s_phase_names[p]);
+	PROF_APPEND("\n");
+
+	uint32_t frames = (s_frames < PROF_WINDOW) ? s_frames : PROF_WINDOW;
+	for (uint32_t f = s_frames - frames; f < s_frames; f++) {
+		PROF_APPEND("%lu", (unsigned long)f);
+		for (int p = 0; p < PROF_PHASE_COUNT; p++)
+			PROF_APPEND(",%lu", (unsigned long)s_window[f % PROF_WINDOW][p]);
+		PROF_APPEND("\n");
+	}
+#undef PROF_APPEND
+	return len;
+}
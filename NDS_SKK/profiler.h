@@ -0,0 +1,56 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 計測する処理段階
+typedef enum {
+	PROF_INPUT,      // キー・タッチ入力の走査
+	PROF_ROMAJI,     // ローマ字かな変換
+	PROF_LOOKUP,     // 辞書検索
+	PROF_LAYOUT,     // 表示文字列の組み立て
+	PROF_DRAW,       // 描画
+	PROF_SAVE,       // 文書の自動保存(書き出し)
+	PROF_PHASE_COUNT,
+} ProfPhase;
+
+#define PROF_WINDOW 64   // 最小・平均・最大を求めるフレーム数
+
+// 処理段階毎の直近 PROF_WINDOW フレームの統計(単位: マイクロ秒)
+typedef struct {
+	uint32_t last;
+	uint32_t min;
+	uint32_t avg;
+	uint32_t max;
+} ProfStats;
+
+// 計測の初期化(実機ではハードウェアタイマー0,1を使う)
+void prof_init(void);
+
+// 処理段階の計測開始・終了(1フレーム内で複数回呼んだ場合は合計する)
+void prof_begin(ProfPhase phase);
+void prof_end(ProfPhase phase);
+
+// 1フレーム分の計測を確定し、統計に加える
+void prof_frame_end(void);
+
+// 処理段階の統計の取得
+void prof_get(ProfPhase phase, ProfStats* stats);
+
+// 処理段階の名前
+const char* prof_phase_name(ProfPhase phase);
+
+// 直近 PROF_WINDOW フレームの計測値をCSV形式で buf に書き出す
+//  戻り値: 書き出したバイト数(buf が足りない場合は0)
+uint32_t prof_dump(char* buf, uint32_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILER_H
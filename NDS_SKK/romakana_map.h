@@ -2,11 +2,12 @@
 #ifndef ROMAKANA_MAP_H_
 #define ROMAKANA_MAP_H_
 
-#include <nds.h>
+#include <stdint.h>
+#include <stddef.h>
 
 typedef struct {
     const char* romaji;
-    u16 sjis_code;
+    uint16_t sjis_code;
 } RomajiKanaMap;
 
 const RomajiKanaMap romakana_map[] = {
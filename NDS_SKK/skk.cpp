@@ -6,37 +6,139 @@
 #include <string.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <stdlib.h>
+#ifdef ARM9
 #include <fat.h> // For NDS file I/O
+#endif
 
 #include "JString.h"
 #include "skk.h"
+#ifdef SKK_DICT_INCBIN
+// skk_dict_compiler -s で生成したアセンブラ(.incbin)からリンクする辞書イメージ
+extern "C" const unsigned char embedded_skk_dict[];
+extern "C" const unsigned char embedded_skk_dict_end[];
+#define EMBEDDED_SKK_DICT_SIZE ((uint32_t)(embedded_skk_dict_end - embedded_skk_dict))
+#else
 #include "test_skk_dict_data.h" // Include embedded dictionary data
+#define EMBEDDED_SKK_DICT_SIZE ((uint32_t)sizeof(embedded_skk_dict))
+#endif
 
 // #define SSK_BINDIC_FILE 	"ssk_mdic.bin" // Defined in skk.h
-#define SSK_BIN_HEAD_SIZE 12
 
 // skkの開始
 //  引数 param_path: 辞書ファイルの格納ディレクトリ (ignored for embedded dict)
+//       verify_order: true の場合、キーが整列済みかを検査する(O(n))
 //
-uint32_t SKK::begin(const char* param_path) {
+uint32_t SKK::begin(const char* param_path, bool verify_order) {
 	// char path[64] = ""; // Not needed for embedded dict
 	uint32_t rc; // Declared here
 
 	// For embedded dictionary, we don't need to open a file
 	// We just set the internal pointer to the start of the array
-	fp_skk_data = (const unsigned char*)embedded_skk_dict;
-
-	rc = load_skk_header();
+	rc = begin((const unsigned char*)embedded_skk_dict, EMBEDDED_SKK_DICT_SIZE, verify_order);
   //Serial.println("ok");
 	return rc;
 }
 
+// メモリ上の辞書イメージを使ってskkを開始する
+//  引数
+//   image:        辞書イメージ(skk_dict_compiler の出力形式)
+//   image_size:   辞書イメージのバイト数
+//   verify_order: true の場合、キーが整列済みかを検査する(O(n))
+//  戻り値
+//   辞書登録単語数(イメージが不正、または binfind() で検索できない順序の場合は0)
+//
+uint32_t SKK::begin(const unsigned char* image, uint32_t image_size, bool verify_order) {
+	size_keyword = 0;
+	clear_cache();                      // 前の辞書の検索結果は使えない
+	if (image == NULL || image_size < SSK_BIN_HEAD_SIZE)
+		return 0;
+	fp_skk_data = image;
+	size_image = image_size;
+	if (!load_skk_header())
+		return 0;
+
+	// binfind() と異なる順序で整列された辞書は使わない
+	if (key_comparator != SKK_CMP_UNKNOWN && key_comparator != SKK_CMP_BYTES)
+		size_keyword = 0;
+	else if (verify_order && !check_order())
+		size_keyword = 0;
+	build_sample_index();
+	return size_keyword;
+}
+
+// 辞書のキーが binfind() の比較順序(strcmp順)で整列済みかの検査
+//  隣接するキーを順に比較する(O(n))
+//  戻り値
+//   1:整列済み 0:整列されていない(または同じキーが重複している)
+//
+uint8_t SKK::check_order() {
+	uint32_t pos;
+
+	for (uint32_t i = 1; i < size_keyword; i++) {
+		memcpy(&pos, fp_skk_data + keyword_index_top + (i-1)*4, 4);
+		const unsigned char* prev = fp_skk_data + keyword_data_top + pos;
+		uint16_t prev_len = 0;
+		while (prev[prev_len] != ',' && prev[prev_len] != '\0')
+			prev_len++;
+		if (cmp_keyword((const char*)prev, prev_len, i) >= 0)
+			return 0;
+	}
+	return 1;
+}
+
 // skkの終了
 uint8_t SKK::end() {
 	// No file to close for embedded dict
+	clear_cache();
 	return 0;
 }
 
+// 検索結果キャッシュの消去
+//  辞書を変更した場合に呼び出す(begin() では自動的に消去する)
+//
+void SKK::clear_cache() {
+	memset(cache, 0, sizeof(cache));
+	cache_clock = 0;
+}
+
+// 検索結果キャッシュの使用/不使用
+//  引数
+//   enable: 1:使用する 0:使用しない(キャッシュは消去する)
+//
+void SKK::enable_cache(uint8_t enable) {
+	cache_enabled = enable;
+	clear_cache();
+}
+
+// 検索結果キャッシュの統計情報の取得
+//  引数
+//   stats(out): 統計情報の格納先
+//
+void SKK::get_cache_stats(SKKCacheStats* stats) {
+	*stats = cache_stats;
+	uint32_t total = cache_stats.hits + cache_stats.misses;
+	stats->hit_ratio = total ? (uint16_t)((uint64_t)cache_stats.hits * 1000 / total) : 0;
+}
+
+// Shift-JIS の2バイト文字の1バイト目か
+static inline uint8_t is_sjis_lead(unsigned char c) {
+	return (c >= 0x81 && c <= 0x9f) || (c >= 0xe0 && c <= 0xfc);
+}
+
+// 前のかなと合わせて綴る小書きのかな(ぁぃぅぇぉゃゅょゎ)の番号(-1:それ以外)
+static inline int8_t small_kana_index(uint16_t code) {
+	if (code >= 0x829f && code <= 0x82a7 && (code & 1))
+		return (code - 0x829f) >> 1;                               // ぁぃぅぇぉ
+	if (code == 0x82e1 || code == 0x82e3 || code == 0x82e5)
+		return 5 + ((code - 0x82e1) >> 1);                         // ゃゅょ
+	return code == 0x82ec ? 8 : -1;                                // ゎ
+}
+
+static inline uint8_t is_vowel(char c) {
+	return c == 'a' || c == 'i' || c == 'u' || c == 'e' || c == 'o';
+}
+
 // skk辞書ファイルのヘッダー読み込み
 uint32_t SKK::load_skk_header() {
 	// ヘッダー情報の格納
@@ -44,9 +146,385 @@ uint32_t SKK::load_skk_header() {
 	memcpy(&size_keyword, fp_skk_data + 0, 4);
 	memcpy(&keyword_index_top, fp_skk_data + 4, 4);
 	memcpy(&keyword_data_top, fp_skk_data + 8, 4);
+	if (keyword_index_top < SSK_BIN_HEAD_SIZE || keyword_data_top > size_image ||
+	    keyword_index_top + size_keyword*4 > keyword_data_top) {
+		// ヘッダーがイメージのサイズと矛盾する
+		size_keyword = 0;
+	}
+	header_size = find_header_size();
+	section_count = 0;
+	key_comparator = read_header(SKK_HEAD_COMPARATOR);
+
+	// 略語の索引: 先頭が英字(0x80 未満)の見出し語の範囲
+	uint32_t lo = 0, hi = size_keyword;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (key_at(mid)[0] < 0x80)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	abbrev_count = lo;
+	load_bloom();
+	load_scores();
+	load_annotations();
+
+	// 近似検索で使うかなの綴り(1文字と、小書きのかなと合わせた2文字)
+	uint8_t rows = 0, nspell = 0;
+	for (uint16_t code = SKK_FUZZY_KANA_FIRST; code <= SKK_FUZZY_KANA_LAST; code++) {
+		uint16_t i = code - SKK_FUZZY_KANA_FIRST;
+		char kana[4] = { (char)(code >> 8), (char)code };
+		fuzzy_nspell[i] = JString::sjis_spellings(kana, 2, fuzzy_spell[i], SKK_FUZZY_SPELLINGS);
+		fuzzy_combines[i] = 0;
+		if (rows >= SKK_FUZZY_COMBINING)
+			continue;
+		for (uint16_t small = SKK_FUZZY_KANA_FIRST; small <= SKK_FUZZY_KANA_LAST; small++) {
+			int8_t s = small_kana_index(small);
+			const char* sp[SKK_FUZZY_SPELLINGS];
+			if (s < 0)
+				continue;
+			kana[2] = (char)(small >> 8);
+			kana[3] = (char)small;
+			uint8_t n = JString::sjis_spellings(kana, 4, sp, SKK_FUZZY_SPELLINGS);
+			if (n == 0 || nspell + n > SKK_FUZZY_PAIR_SPELLINGS)
+				continue;
+			if (fuzzy_combines[i] == 0) {
+				memset(fuzzy_pair_count[rows], 0, sizeof(fuzzy_pair_count[0]));
+				fuzzy_combines[i] = ++rows;
+			}
+			fuzzy_pair_first[rows - 1][s] = nspell;
+			fuzzy_pair_count[rows - 1][s] = n;
+			memcpy(&fuzzy_pair_spell[nspell], sp, n * sizeof(sp[0]));
+			nspell += n;
+		}
+	}
 	return size_keyword;
 }
 
+// Bloomフィルタ部の読み込み(内部処理用)
+//  Bloomフィルタ部はヘッダーとキーワードインデックスの間に格納されている。
+//  形式が不正な種類のフィルタは使わない(常に「ありうる」と判定する)。
+//  読めた種類までがほかの部と重なる場合は、フィルタを1つも使わない。
+//
+void SKK::load_bloom() {
+	uint32_t top = read_header(SKK_HEAD_BLOOM);
+	uint32_t start = top;
+	uint32_t nclass, nbits, nhash;
+	uint32_t i;
+
+	for (i = 0; i < SKK_BLOOM_CLASSES; i++)
+		bloom_bits[i] = NULL;
+	if (top < header_size || top > keyword_index_top - 4)
+		return;
+	memcpy(&nclass, fp_skk_data + top, 4);
+	top += 4;
+	for (i = 0; i < nclass && i < SKK_BLOOM_CLASSES; i++) {
+		if (top + 8 > keyword_index_top)
+			break;
+		memcpy(&nbits, fp_skk_data + top, 4);
+		memcpy(&nhash, fp_skk_data + top + 4, 4);
+		top += 8;
+		if (nbits < SKK_BLOOM_MIN_BITS || nbits > SKK_BLOOM_MAX_BITS || (nbits & 31) ||
+		    nhash == 0 || nhash > SKK_BLOOM_MAX_HASH || top + nbits / 8 > keyword_index_top)
+			break;
+		bloom_bits[i] = fp_skk_data + top;
+		bloom_nbits[i] = nbits;
+		bloom_nhash[i] = nhash;
+		top += nbits / 8;
+	}
+	if (!claim_section(start, top)) {
+		for (i = 0; i < SKK_BLOOM_CLASSES; i++)
+			bloom_bits[i] = NULL;
+	}
+}
+
+// 候補スコア部の読み込み(内部処理用)
+//  候補スコア部はヘッダーとキーワードインデックスの間に格納されている。
+//  形式が不正な場合はスコアなし(候補は格納順)として扱う。
+//
+void SKK::load_scores() {
+	uint32_t top = read_header(SKK_HEAD_SCORE);
+	uint32_t nentries, nblocks, last, i;
+
+	score_base = NULL;
+	if (size_keyword == 0 || top < header_size || top > keyword_index_top - 4)
+		return;
+	memcpy(&nentries, fp_skk_data + top, 4);
+	nblocks = (size_keyword + SKK_SCORE_BLOCK - 1) / SKK_SCORE_BLOCK;
+	if (nentries != size_keyword || top + 4 + nblocks * 4 + size_keyword > keyword_index_top)
+		return;
+	const unsigned char* base = fp_skk_data + top + 4;
+	const unsigned char* count = base + nblocks * 4;
+	const unsigned char* data = count + size_keyword;
+
+	// 最後のブロックの終わりがスコアの終わり
+	memcpy(&last, base + (nblocks - 1) * 4, 4);
+	for (i = (nblocks - 1) * SKK_SCORE_BLOCK; i < size_keyword; i++)
+		last += count[i];
+	if (last > (uint32_t)(fp_skk_data + keyword_index_top - data) ||
+	    !claim_section(top, (uint32_t)(data - fp_skk_data) + last))
+		return;
+	score_base = base;
+	score_count = count;
+	score_data = data;
+	score_size = last;
+}
+
+// 注釈部の読み込み(内部処理用)
+//  注釈部は候補スコア部と同じくヘッダーとキーワードインデックスの間に格納されている。
+//  注釈は候補が選ばれたときだけ読むので、ここでは位置を確かめるだけで内容には触れない。
+//
+void SKK::load_annotations() {
+	uint32_t top = read_header(SKK_HEAD_ANNOT);
+	uint32_t n, last;
+
+	annot_ids = NULL;
+	if (top < header_size || top > keyword_index_top - 8)
+		return;
+	memcpy(&n, fp_skk_data + top, 4);
+	if (n == 0 || n > (keyword_index_top - top - 8) / 8)
+		return;
+	const unsigned char* offsets = fp_skk_data + top + 4 + n * 4;
+	const unsigned char* text = offsets + (n + 1) * 4;
+	memcpy(&last, offsets + n * 4, 4);
+	if (last > (uint32_t)(fp_skk_data + keyword_index_top - text) ||
+	    !claim_section(top, (uint32_t)(text - fp_skk_data) + last))
+		return;
+	annot_ids = fp_skk_data + top + 4;
+	annot_offsets = offsets;
+	annot_text = text;
+	annot_count = n;
+}
+
+// 先頭8バイトを比較用の整数にする
+//  バイト列順と整数の大小が一致するようビッグエンディアンで詰め、8バイトに満たない分は0とする
+//  (辞書のキーは0を含まないので、strcmp() の終端と同じ扱いになる)
+//
+static uint64_t key_prefix(const unsigned char* key, uint16_t key_len) {
+	uint64_t v = 0;
+	for (uint16_t i = 0; i < 8; i++) {
+		v <<= 8;
+		if (i < key_len)
+			v |= key[i];
+	}
+	return v;
+}
+
+// 標本インデックスの作成(内部処理用)
+//  辞書の読み込み時に一度だけ、標本間隔毎のキーの先頭8バイトをコピーする
+//
+void SKK::build_sample_index() {
+	uint32_t pos;
+	uint16_t len;
+
+	sample_count = 0;
+	if (!sample_enabled || size_keyword == 0)
+		return;
+	sample_shift = 0;
+	while (((uint32_t)1 << sample_shift) < SKK_SAMPLE_STRIDE)
+		sample_shift++;
+	while (((size_keyword - 1) >> sample_shift) + 1 > SKK_SAMPLE_MAX)
+		sample_shift++;
+
+	for (uint32_t i = 0; i < size_keyword; i += (uint32_t)1 << sample_shift) {
+		memcpy(&pos, fp_skk_data + keyword_index_top + i*4, 4);
+		const unsigned char* d = fp_skk_data + keyword_data_top + pos;
+		for (len = 0; len < 8 && d[len] != ',' && d[len] != '\0'; len++)
+			;
+		sample_key[sample_count++] = key_prefix(d, len);
+	}
+}
+
+// 標本インデックスによる検索範囲の絞り込み(内部処理用)
+//  先頭8バイトが key より小さい最後の標本と、大きい最初の標本の間に key はある。
+//  先頭8バイトが等しい標本では大小が決まらないので、その標本の区間は範囲に含める。
+//  引数
+//   key, key_len: 検索キー
+//   first(out), last(out): 検索範囲(両端を含む)
+//
+void SKK::sample_range(const char* key, uint16_t key_len, int32_t* first, int32_t* last) {
+	uint64_t k = key_prefix((const unsigned char*)key, key_len);
+	uint32_t lo = 0, hi = sample_count;     // 先頭8バイトが k 以上となる最初の標本
+	uint32_t mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) >> 1;
+		if (sample_key[mid] < k)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*first = (lo > 0) ? ((lo - 1) << sample_shift) + 1 : 0;
+
+	hi = sample_count;                      // 先頭8バイトが k より大きい最初の標本
+	while (lo < hi) {
+		mid = (lo + hi) >> 1;
+		if (sample_key[mid] <= k)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*last = (lo < sample_count) ? (int32_t)(lo << sample_shift) - 1 : (int32_t)size_keyword - 1;
+}
+
+// 標本インデックスの使用/不使用
+//  引数
+//   enable: 1:使用する 0:使用しない
+//
+void SKK::enable_sample_index(uint8_t enable) {
+	sample_enabled = enable;
+	build_sample_index();
+}
+
+// binfind() のキーワード比較回数の累計
+uint32_t SKK::get_probe_count() {
+	return probe_count;
+}
+
+// Bloomフィルタ用キーのハッシュ値(FNV-1a)
+//  skk_dict_compiler と同じ計算をすること
+//
+uint32_t SKK::key_hash(const char* key, uint16_t key_len) {
+	uint32_t h = 2166136261u;
+	for (uint16_t i = 0; i < key_len; i++) {
+		h ^= (unsigned char)key[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+// Bloomフィルタ用2つ目のハッシュ値
+//  key_hash() の値を攪拌して作る(奇数にする)
+//
+uint32_t SKK::bloom_step(uint32_t hash) {
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+	return hash | 1;
+}
+
+// Bloomフィルタ用キーの種類
+//  戻り値
+//   SKK_BLOOM_KANA:0x80以上のバイトを含む SKK_BLOOM_ASCII:ASCIIのみ
+//
+uint8_t SKK::key_class(const char* key, uint16_t key_len) {
+	for (uint16_t i = 0; i < key_len; i++) {
+		if ((unsigned char)key[i] & 0x80)
+			return SKK_BLOOM_KANA;
+	}
+	return SKK_BLOOM_ASCII;
+}
+
+// Bloomフィルタによる存在判定(内部処理用)
+//  1回のハッシュ計算から2つのハッシュ値を作り、ハッシュ数分のビットを調べる
+//  ビット位置は除算を使わず (ハッシュ値×ビット数)>>32 で求める
+//  戻り値
+//   0:辞書にない 1:辞書にある可能性がある(フィルタがない場合も1)
+//
+uint8_t SKK::may_contain(const char* key, uint16_t key_len) {
+	uint8_t c = key_class(key, key_len);
+	const unsigned char* bits = bloom_bits[c];
+	if (bits == NULL)
+		return 1;
+
+	uint32_t h1 = key_hash(key, key_len);
+	uint32_t h2 = bloom_step(h1);
+	for (uint8_t i = 0; i < bloom_nhash[c]; i++) {
+		uint32_t bit = ((uint64_t)(h1 + i * h2) * bloom_nbits[c]) >> 32;
+		if (!(bits[bit >> 3] & (1 << (bit & 7)))) {
+			cache_stats.filtered++;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// 拡張ヘッダー項目の取得(内部処理用)
+//  引数
+//   offset: ヘッダー内の位置 (SKK_HEAD_*)
+//  戻り値
+//   項目の値(旧形式などでヘッダーに項目がない場合は0)
+//
+uint32_t SKK::read_header(uint32_t offset) {
+	uint32_t value = 0;
+	if (offset + 4 <= header_size)
+		memcpy(&value, fp_skk_data + offset, 4);
+	return value;
+}
+
+// ヘッダーのバイト数の取得(内部処理用)
+//  SKK_HEAD_LENGTH より前の項目を順に読み、キーワードインデックスとそれまでに読んだ各部の位置の
+//  うち最も前のものに届いたところをヘッダーの終わりとする(旧形式では各部がヘッダーの直後にある)。
+//  SKK_HEAD_LENGTH まで読めた場合は、そこに記録されたバイト数を使う。
+//  戻り値
+//   ヘッダーのバイト数
+//
+uint32_t SKK::find_header_size() {
+	uint32_t limit = keyword_index_top < size_image ? keyword_index_top : size_image;  // ヘッダーの終わりの上限
+	uint32_t offset, value;
+
+	for (offset = SKK_HEAD_COMPARATOR; offset < SKK_HEAD_LENGTH; offset += 4) {
+		if (offset + 4 > limit)
+			return offset;
+		memcpy(&value, fp_skk_data + offset, 4);
+		if (offset != SKK_HEAD_COMPARATOR && value != 0 && value < limit)
+			limit = value;
+	}
+	if (SKK_HEAD_LENGTH + 4 > limit)
+		return SKK_HEAD_LENGTH;
+	memcpy(&value, fp_skk_data + SKK_HEAD_LENGTH, 4);
+	if (value < SKK_HEAD_LENGTH + 4 || value > limit)
+		return SKK_HEAD_LENGTH;                // 記録が不正: SKK_HEAD_LENGTH より前の項目だけを使う
+	return value;
+}
+
+// 部の範囲の検査と登録(内部処理用)
+//  ヘッダーとキーワードインデックスの間にあり、登録済みの部と重ならない範囲だけを登録する。
+//  引数
+//   top: 部の先頭位置
+//   end: 部の終わりの位置(含まない)
+//  戻り値
+//   1:登録した 0:範囲が不正
+//
+uint8_t SKK::claim_section(uint32_t top, uint32_t end) {
+	if (top < header_size || end < top || end > keyword_index_top || section_count >= SKK_SECTIONS)
+		return 0;
+	for (uint8_t i = 0; i < section_count; i++) {
+		if (top < section_end[i] && section_top[i] < end)
+			return 0;
+	}
+	section_top[section_count] = top;
+	section_end[section_count] = end;
+	section_count++;
+	return 1;
+}
+
+// 指定キーワードインデックスのキーワードデータの位置とサイズ(内部処理用)
+//  引数
+//   index: キーワードのインデックス番号
+//   pos:   キーワードデータ先頭からの位置の格納先
+//   size:  キーワードデータのバイト数('\0'を含む)の格納先
+//  戻り値
+//   1:取得出来た 0:インデックスが範囲外
+//
+uint8_t SKK::entry_range(uint32_t index, uint32_t* pos, uint32_t* size) {
+	uint32_t pos_next;
+
+	if (index >= size_keyword)
+		return 0;
+	memcpy(pos, fp_skk_data + keyword_index_top + index*4, 4);
+	if (index != size_keyword-1) {
+		memcpy(&pos_next, fp_skk_data + keyword_index_top + (index+1)*4, 4);
+	} else {
+		// 最終データはイメージの末尾まで
+		pos_next = size_image - keyword_data_top;
+	}
+	*size = pos_next - *pos;
+	return 1;
+}
+
 // 指定キーワードインデックスのキーワードの取得
 // 引数
 //  keyowrd: キーワード格納先
@@ -60,7 +538,7 @@ uint8_t SKK::get_keyword(const char* keyword, uint32_t index) {
 	uint8_t c;
 
 	// Read from embedded_skk_dict array
-	memcpy(&pos, fp_skk_data + SSK_BIN_HEAD_SIZE + index*4, 4);
+	memcpy(&pos, fp_skk_data + keyword_index_top + index*4, 4);
 
 	// キーワードの取得
 	const unsigned char* current_ptr = fp_skk_data + pos + keyword_data_top;
@@ -87,47 +565,67 @@ uint8_t SKK::get_keyword(const char* keyword, uint32_t index) {
 //   異常終了:0
 //
 uint8_t SKK::get_keywordData(const char* data , uint32_t index) {
-	uint32_t pos, pos_next; // キーワード格納位置
+	uint32_t pos; // キーワード格納位置
 	uint32_t size;
-	int rc;
-	// uint8_t c; // Not used
-	if (index >= size_keyword)
+	if (!entry_range(index, &pos, &size))
 		return 0;
-	
-	// Read from embedded_skk_dict array
-	memcpy(&pos, fp_skk_data + SSK_BIN_HEAD_SIZE + index*4, 4);
-	if (index != size_keyword-1) {
-		memcpy(&pos_next, fp_skk_data + SSK_BIN_HEAD_SIZE + (index+1)*4, 4);
-		size = pos_next - pos;
-	} else {
-		size = 30; // 最終データの場合、仮サイズを指定 (This might need adjustment based on actual last entry size)
-	}
 
 	memcpy((void *)data, fp_skk_data + pos + keyword_data_top, size);
 	if (size > 0)
 		((char *)data)[size] = '\0'; // Ensure null termination
-	if (size > max_data_len) {
-		max_data_len = size;
-		max_data_len_index = index;
-	}
 	return 1;
 }
 
 // 論理リスト内２分検索
 int32_t SKK::binfind(const char* key, uint32_t n) {
+	return binfind(key, strlen(key), n);
+}
+
+// 指定キーワードインデックスのキーワードとの比較(内部処理用)
+//  辞書データをコピーせずに直接 strcmp() と同じ順序で比較する
+//  引数
+//   key:     検索キー
+//   key_len: 検索キーのバイト数
+//   index:   インデックステーブル参照位置
+//  戻り値
+//   <0:key が小さい 0:等しい >0:key が大きい
+//
+int SKK::cmp_keyword(const char* key, uint16_t key_len, uint32_t index) {
+	uint32_t pos; // キーワード格納位置
+	memcpy(&pos, fp_skk_data + keyword_index_top + index*4, 4);
+	const unsigned char* d = fp_skk_data + pos + keyword_data_top;
+
+	for (uint16_t i = 0; ; i++) {
+		int kc = (i < key_len) ? (unsigned char)key[i] : 0;
+		int dc = (d[i] == ',') ? 0 : d[i];
+		if (kc != dc)
+			return kc - dc;
+		if (kc == 0)
+			return 0;
+	}
+}
+
+// 論理リスト内２分検索(長さ指定版)
+int32_t SKK::binfind(const char* key, uint16_t key_len, uint32_t n) {
 	int32_t t_p = 0;                   // 検索範囲上限
 	int32_t e_p = n-1;                 // 検索範囲下限
 	uint8_t flg_stop = 0;
 	int32_t pos;
-	char d[32] = "";
 	int rc;
 
+	if (n == 0 || !may_contain(key, key_len))
+		return -1;
+	if (sample_count && n == size_keyword) {
+		// 標本インデックスで検索範囲を絞る
+		sample_range(key, key_len, &t_p, &e_p);
+		if (e_p < t_p)
+			return -1;
+	}
+
 	for(;;) {
 		pos = t_p + ((e_p - t_p+1)>>1);
-		if (!get_keyword(d, pos)) {
-			return -1;
-		}
-		rc = strcmp(key, d);
+		rc = cmp_keyword(key, key_len, pos);
+		probe_count++;
 		if (rc == 0) {        // 等しい
 			flg_stop = 1;  
 			break;
@@ -146,53 +644,50 @@ int32_t SKK::binfind(const char* key, uint32_t n) {
 	return pos;
 }
 
-// 英字小文字変換(内部処理用)
-void SKK::word2lower(char* token) {
-	uint16_t len = strlen(token);
-	for (uint16_t i=0; i < len; i++) {
-		if (isupper(token[i])) {
-			token[i] = tolower(token[i]);
-		}
-	}
-}
-
-// 送り指示ありローマ字をキーワードと送りに分ける(内部処理用)
-//  例:OkuRu → 'oku', 'ru'
-//   引数 
-//    keyword(out) : キーワード部の格納領域
-//    okuri(out)   : 送り部の格納領域
-//    token(in)    : ローマ字文字列
+// 入力トークンの解析(内部処理用)
+//  入力を1回走査して小文字化と送りの分離を行い、キーワード部と送り部をそれぞれかなに変換する。
+//  先頭が大文字で2文字目以降にも大文字がある場合、その位置から後ろが送り
+//  (例: OkuRu → キーワード oku、送りの子音 r、検索キー「おくr」、送り「る」)。
+//  かな変換は送りの境界を越えて先読みしないよう、キーワード部と送り部で分けて行う。
+//  かなは辞書と同じ Shift-JIS で出力する(変換表引きのみで、UTF-8 を経由しない)。
+//   引数
+//    t(out)    : 解析結果
+//    token     : ローマ字文字列
+//    token_len : token のバイト数
 //   戻り値
-//    なし
-void SKK::splitOkuri(char* keyword, char* okuri, char* token) {
-	((char*)keyword)[0] = '\0';
-	((char*)okuri)[0] = '\0';
+//    1:解析できた 0:トークンが長すぎる
+//
+uint8_t SKK::analyze_token(SKKToken* t, const char* token, uint16_t token_len) {
+	uint16_t split = token_len;   // 送り開始位置(送りなしの場合は token_len)
+	uint8_t okuri_mode;
 
-	// 0文字の場合は、0文字を返す
-	if (strlen(token) == 0) 
-		return;
-	
-	// 送りモードの場合、送り文字を調べる
-	if (isupper(token[0])) {
-		for(uint16_t i=1; i< strlen(token); i++) {            
-			if (isupper(token[i])) {
-				strcpy((char*)okuri, &token[i]);
-				strncpy((char*)keyword, token, i);
-				((char*)keyword)[i] = '\0';
-				break;
-			}
-		}
-		// 送り文字がない場合、送りモードでないとする
-		if (strlen(keyword) == 0) {
-			strcpy((char*)keyword, token);
-			((char*)okuri)[0] = '\0';
+	if (token_len >= SKK_TOKEN_MAX)
+		return 0;
+	okuri_mode = token_len > 0 && isupper((unsigned char)token[0]);
+	for (uint16_t i = 0; i < token_len; i++) {
+		char c = token[i];
+		if (isupper((unsigned char)c)) {
+			if (okuri_mode && i > 0 && split == token_len)
+				split = i;
+			c = tolower((unsigned char)c);
 		}
+		t->lower[i] = c;
+	}
+	t->lower[token_len] = '\0';
+	t->keyword_len = split;
+
+	JString::roma_to_sjis(t->key, t->lower, split, &t->key_len);
+	if (split < token_len) {
+		t->okuri_char = t->lower[split];
+		t->key[t->key_len++] = t->okuri_char;
+		t->key[t->key_len] = '\0';
+		JString::roma_to_sjis(t->okuri, &t->lower[split], token_len - split, &t->okuri_len);
 	} else {
-		strcpy((char*)keyword, token);
+		t->okuri_char = '\0';
+		t->okuri[0] = '\0';
+		t->okuri_len = 0;
 	}
-	word2lower(keyword);
-	word2lower(okuri);
-	return;
+	return 1;
 }
 
 // 日本語辞書変換(送り対応)
@@ -201,60 +696,31 @@ void SKK::splitOkuri(char* keyword, char* okuri, char* token) {
 //    out_okuri
 //    in_token
 //  戻り値
-//    0:候補なし 1:候補あり(送りあり) 2:候補あり(送りなし) 3:候補あり(英単語)
+//    0:候補なし 1:候補あり(送りあり) 2:候補あり(送りなし)
 //
 uint8_t SKK::get_kouho_list(char* kouho_list, char* out_okuri, char* in_token) {
-	char keyword[32];
-	char okuri[32];
-	char key[64];
-	uint16_t key_len;
+	return get_kouho_list(kouho_list, out_okuri, in_token, strlen(in_token));
+}
+
+// 日本語辞書変換(送り対応)(長さ指定版)
+//  引数
+//    out_kouho
+//    out_okuri
+//    in_token
+//    token_len: in_token のバイト数
+//  戻り値
+//    0:候補なし 1:候補あり(送りあり) 2:候補あり(送りなし)
+//
+uint8_t SKK::get_kouho_list(char* kouho_list, char* out_okuri, const char* in_token, uint16_t token_len) {
 	int32_t pos;
 	uint8_t rc;
 
-	// 送り処理
-	splitOkuri(keyword, okuri, in_token);
-	if (strlen(okuri)) {
-		// 送りがある場合
-		
-		// key にキーワードをセット
-		JString::roma_to_kana(key, keyword);
-		key_len = strlen(key);
-		key[key_len] = okuri[0];
-		key[key_len+1] = '\0';
-		
-		// 候補の位置を検索
-		pos = binfind(key, size_keyword); 
-		if (pos > 0) {
-			// 該当データあり
-			rc = get_keywordData(kouho_list, pos);     // 候補データの取得
-			JString::roma_to_kana(out_okuri, okuri);   // 送りローマ字を「ひらがな」に変換
-			return 1;
-		} else {
-			((char*)kouho_list)[0] = '\0';
-			((char*)out_okuri)[0] = '\0';
-			return 0;
-		}
-	} else {
-        // 送りなし
-		JString::roma_to_kana(key, keyword);
-		pos = binfind(key, size_keyword);
-		if (pos > 0) {
-			rc = get_keywordData(kouho_list, pos);
-			((char*)out_okuri)[0] = '\0';
-			return 2;
-		} else {
-			// 候補がない場合、英単語として検索を試みる
-			pos = binfind(in_token, size_keyword);
-			if (pos > 0) {
-				rc = get_keywordData(kouho_list, pos);
-				((char*)out_okuri)[0] = '\0';
-				return 3;         
-			}
-			((char*)kouho_list)[0] = '\0';
-			((char*)out_okuri)[0] = '\0';
-			return 0;
-		}
-	}
+	rc = lookup(&pos, out_okuri, in_token, token_len);
+	if (rc)
+		get_keywordData(kouho_list, pos);      // 候補データの取得
+	else
+		((char*)kouho_list)[0] = '\0';
+	return rc;
 }
 
 // 入力文字で辞書検索(該当候補のindexを返す)
@@ -263,58 +729,555 @@ uint8_t SKK::get_kouho_list(char* kouho_list, char* out_okuri, char* in_token) {
 //    out_okuri:       送り
 //    in_token:        検索トークン
 //  戻り値
-//    0:候補なし 1:候補あり(送りあり) 2:候補あり(送りなし) 3:候補あり(英単語)
+//    0:候補なし 1:候補あり(送りあり) 2:候補あり(送りなし)
 //
 uint8_t SKK::get_kouho_list_index(uint32_t* out_kouho_index, char* out_okuri, char* in_token) {
-	char keyword[32];
-	char okuri[32];
-	char key[64];
-	uint16_t key_len;
+	return get_kouho_list_index(out_kouho_index, out_okuri, in_token, strlen(in_token));
+}
+
+// 入力文字で辞書検索(該当候補のindexを返す)(長さ指定版)
+//  引数
+//    out_kouho_index: 候補リストの格納位置インデックス
+//    out_okuri:       送り
+//    in_token:        検索トークン
+//    token_len:       in_token のバイト数
+//  戻り値
+//    0:候補なし 1:候補あり(送りあり) 2:候補あり(送りなし)
+//
+uint8_t SKK::get_kouho_list_index(uint32_t* out_kouho_index, char* out_okuri, const char* in_token, uint16_t token_len) {
 	int32_t pos;
 	uint8_t rc;
 
-	// 送り処理
-	splitOkuri(keyword, okuri, in_token);
-	if (strlen(okuri)) {
-		// 送りがある場合
-		
-		// key にキーワードをセット
-		JString::roma_to_kana(key, keyword);
-		key_len = strlen(key);
-		key[key_len] = okuri[0];
-		key[key_len+1] = '\0';
-		
-		// 候補の位置を検索
-		pos = binfind(key, size_keyword); 
-		if (pos > 0) {
-			// 該当データあり
-			*(uint32_t*)out_kouho_index = pos;
-			JString::roma_to_kana(out_okuri, okuri);    // 送りローマ字を「ひらがな」に変換
-			return 1;
-		} else {
-			((char*)out_okuri)[0] = '\0';
-			return 0;
-		}
+	rc = lookup(&pos, out_okuri, in_token, token_len);
+	if (rc)
+		*(uint32_t*)out_kouho_index = pos;
+	return rc;
+}
+
+// 入力トークンの辞書検索(キャッシュ付)(内部処理用)
+//  入力トークンを解析した検索キー(binfind() に渡すかな＋送りの子音)毎に辞書インデックスを
+//  SKK_CACHE_SIZE 件までキャッシュし、最も長く参照されていないものから置き換える。
+//  大文字・小文字や送りのかなが違うだけの入力も同じ項目にヒットする。送りは毎回解析結果から返す。
+//  引数
+//    pos(out):       辞書インデックス(該当なしは-1)
+//    out_okuri(out): 送り(ひらがな)
+//    token:          検索トークン
+//    token_len:      token のバイト数
+//  戻り値
+//    0:候補なし 1:候補あり(送りあり) 2:候補あり(送りなし)
+//
+uint8_t SKK::lookup(int32_t* pos, char* out_okuri, const char* token, uint16_t token_len) {
+	SKKToken t;
+	uint8_t i, victim = 0;
+	uint32_t probes;
+
+	*pos = -1;
+	((char*)out_okuri)[0] = '\0';
+	if (!analyze_token(&t, token, token_len))
+		return 0;
+
+	if (!cache_enabled || t.key_len >= SKK_CACHE_KEY_SIZE) {
+		*pos = resolve(&t);
 	} else {
-        // 送りなし
-		JString::roma_to_kana(key, keyword);
-		pos = binfind(key, size_keyword);
-		if (pos > 0) {
-			*(uint32_t*)out_kouho_index = pos;
-			((char*)out_okuri)[0] = '\0';
-			return 2;
+		for (i = 0; i < SKK_CACHE_SIZE; i++) {
+			SKKCacheEntry* e = &cache[i];
+			if (e->stamp && e->key_len == t.key_len && memcmp(e->key, t.key, t.key_len) == 0)
+				break;
+			if (e->stamp < cache[victim].stamp)
+				victim = i;
+		}
+		if (i < SKK_CACHE_SIZE) {
+			// ヒット
+			SKKCacheEntry* e = &cache[i];
+			e->stamp = ++cache_clock;
+			cache_stats.hits++;
+			cache_stats.saved_probes += e->probes;
+			*pos = e->index;
 		} else {
-			// 候補がない場合、英単語として検索を試みる
-			pos = binfind(in_token, size_keyword);
-			if (pos > 0) {
-				*(uint32_t*)out_kouho_index = pos;
-				((char*)out_okuri)[0] = '\0';
-				return 3;         
+			// ミス: 検索して最も古いものと置き換える
+			SKKCacheEntry* e = &cache[victim];
+			cache_stats.misses++;
+			probes = probe_count;
+			*pos = resolve(&t);
+			probes = probe_count - probes;
+			cache_stats.probes += probes;
+			memcpy(e->key, t.key, t.key_len);
+			e->key_len = t.key_len;
+			e->index = *pos;
+			e->probes = probes;
+			e->stamp = ++cache_clock;
+		}
+	}
+
+	if (*pos < 0)
+		return 0;
+	if (t.okuri_char) {
+		// 送りがある場合: キーワードのかな＋送りの子音で見つかった
+		memcpy(out_okuri, t.okuri, t.okuri_len + 1);
+		return 1;
+	}
+	return 2;
+}
+
+// 検索キーの辞書検索(内部処理用)
+//  送りがあればキーワードのかな＋送りの子音、なければかなだけで検索する
+//  (英字のままの検索は略語の索引で行う: get_abbrev_index())。
+//  引数
+//    t: analyze_token() の解析結果
+//  戻り値
+//    辞書インデックス(該当なしは-1)
+//
+int32_t SKK::resolve(const SKKToken* t) {
+	return binfind(t->key, t->key_len, size_keyword);
+}
+
+// 略語(英字)の辞書検索
+//  入力をかなに変換せず、そのまま英字の見出し語(SKK の abbrev 変換)として検索する。
+//  英字の見出し語はバイト列順でインデックスの先頭 abbrev_count 件に並ぶので、その範囲だけを
+//  2分検索する(かなの検索とは範囲が重ならない)。検索結果キャッシュは使わない。
+//  引数
+//    out_kouho_index: 候補リストの格納位置インデックス
+//    in_token:        検索トークン(英字)
+//    token_len:       in_token のバイト数
+//  戻り値
+//    0:候補なし 3:候補あり(略語)
+//
+uint8_t SKK::get_abbrev_index(uint32_t* out_kouho_index, const char* in_token, uint16_t token_len) {
+	int32_t pos;
+
+	if (token_len == 0 || (unsigned char)in_token[0] >= 0x80)
+		return 0;
+	pos = binfind(in_token, token_len, abbrev_count);
+	if (pos < 0)
+		return 0;
+	*out_kouho_index = pos;
+	return 3;
+}
+
+// キーの辞書インデックスの取得
+//  引数
+//   key:     検索キー(辞書と同じ文字コード)
+//   key_len: 検索キーのバイト数
+//  戻り値
+//   辞書インデックス(該当なしは-1)
+//
+int32_t SKK::find_index(const char* key, uint16_t key_len) {
+	return binfind(key, key_len, size_keyword);
+}
+
+// 続く文字の集計(predict_next() の内部処理用)
+//  d は前置キーの直後。2バイト文字でなければ数えない
+//
+static void tally_next(uint16_t* code, uint16_t* count, uint16_t* kinds, const unsigned char* d, uint32_t avail) {
+	if (avail < 2 || d[0] < 0x81 || d[0] == ',')
+		return;
+	uint16_t c = (uint16_t)((d[0] << 8) | d[1]);
+	for (uint16_t i = 0; i < *kinds; i++) {
+		if (code[i] == c) {
+			count[i]++;
+			return;
+		}
+	}
+	if (*kinds < SKK_PREDICT_SCAN) {
+		code[*kinds] = c;
+		count[(*kinds)++] = 1;
+	}
+}
+
+// 前置キーに続く文字の予測
+//  前置キーで始まる読みの次の2バイト文字を、登録数の多い順に返す。
+//  前置キーが標本の先頭8バイトに収まり、標本が SKK_PREDICT_MIN_SAMPLES 個以上あれば
+//  標本インデックスだけで数える(標本1個が標本間隔分の登録語を表す)。それ以外は
+//  前置キーの位置から最大 SKK_PREDICT_SCAN 件の登録語を数える。
+//  引数
+//   out_chars:  続く文字(SJIS、上位バイトが第1バイト)の格納先
+//   max_chars:  out_chars の要素数
+//   prefix:     前置キー(辞書と同じ符号化)
+//   prefix_len: prefix のバイト数
+//  戻り値
+//   格納した文字数
+//
+uint16_t SKK::predict_next(uint16_t* out_chars, uint16_t max_chars, const char* prefix, uint16_t prefix_len) {
+	uint16_t code[SKK_PREDICT_SCAN];
+	uint16_t count[SKK_PREDICT_SCAN];
+	uint16_t kinds = 0;
+	uint16_t n = 0;
+
+	if (size_keyword == 0 || max_chars == 0)
+		return 0;
+
+	if (sample_count && prefix_len + 2 <= 8) {
+		uint64_t k = key_prefix((const unsigned char*)prefix, prefix_len);
+		uint64_t mask = prefix_len ? ~(uint64_t)0 << (64 - prefix_len * 8) : 0;
+		uint32_t lo = 0, hi = sample_count, mid;
+		while (lo < hi) {
+			mid = (lo + hi) >> 1;
+			if (sample_key[mid] < k)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		for (uint32_t i = lo; i < sample_count && (sample_key[i] & mask) == k; i++) {
+			unsigned char d[2] = {
+				(unsigned char)(sample_key[i] >> (56 - prefix_len * 8)),
+				(unsigned char)(sample_key[i] >> (48 - prefix_len * 8)),
+			};
+			tally_next(code, count, &kinds, d, 2);
+			n++;
+		}
+	}
+	if (n < SKK_PREDICT_MIN_SAMPLES) {
+		// 前置キー以上となる最初の登録語から数える
+		int32_t lo = 0, hi = size_keyword, mid;
+		kinds = 0;
+		while (lo < hi) {
+			mid = (lo + hi) >> 1;
+			if (cmp_keyword(prefix, prefix_len, mid) > 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		for (uint32_t i = lo; i < size_keyword && i < (uint32_t)lo + SKK_PREDICT_SCAN; i++) {
+			uint32_t pos, size;
+			entry_range(i, &pos, &size);
+			const unsigned char* d = fp_skk_data + keyword_data_top + pos;
+			if (size <= prefix_len || memcmp(d, prefix, prefix_len) != 0)
+				break;
+			if (d[prefix_len] == ',')
+				continue;                   // 前置キー自身
+			tally_next(code, count, &kinds, d + prefix_len, size - prefix_len);
+		}
+	}
+
+	// 多い順に選ぶ(同数は辞書順)
+	for (n = 0; n < max_chars; n++) {
+		int16_t best = -1;
+		for (uint16_t i = 0; i < kinds; i++) {
+			if (count[i] && (best < 0 || count[i] > count[best]))
+				best = i;
+		}
+		if (best < 0)
+			break;
+		out_chars[n] = code[best];
+		count[best] = 0;
+	}
+	return n;
+}
+
+// 指定位置のキーワードの先頭(内部処理用)
+//  キーワードは ',' または '\0' で終わる
+//
+const unsigned char* SKK::key_at(uint32_t index) {
+	uint32_t pos;
+	memcpy(&pos, fp_skk_data + keyword_index_top + index*4, 4);
+	return fp_skk_data + keyword_data_top + pos;
+}
+
+// かなの綴り(内部処理用)
+//  読み込み時に作った表を引く
+//  引数
+//   kana:     かな(Shift-JIS)
+//   kana_len: kana のバイト数(2: 1文字、4: 小書きのかなと合わせた2文字)
+//   out:      綴りの格納先(SKK_FUZZY_SPELLINGS 個)
+//  戻り値
+//   綴りの数
+//
+uint8_t SKK::spellings(const unsigned char* kana, uint8_t kana_len, const char** out) {
+	uint16_t code = kana[0] << 8 | kana[1];
+	if (code < SKK_FUZZY_KANA_FIRST || code > SKK_FUZZY_KANA_LAST)
+		return 0;
+	if (kana_len == 2) {
+		memcpy(out, fuzzy_spell[code - SKK_FUZZY_KANA_FIRST], sizeof(fuzzy_spell[0]));
+		return fuzzy_nspell[code - SKK_FUZZY_KANA_FIRST];
+	}
+	uint8_t row = fuzzy_combines[code - SKK_FUZZY_KANA_FIRST];
+	int8_t s = kana_len == 4 ? small_kana_index(kana[2] << 8 | kana[3]) : -1;
+	if (row == 0 || s < 0)
+		return 0;
+	uint8_t n = fuzzy_pair_count[row - 1][s];
+	memcpy(out, &fuzzy_pair_spell[fuzzy_pair_first[row - 1][s]], n * sizeof(out[0]));
+	return n;
+}
+
+// 綴りを1つ進める(内部処理用)
+//  綴りの1文字毎に編集距離表の行を求める(値は上限+1で頭打ち)。
+//  引数
+//   w:       作業領域(w->row[depth] までが求めてある)
+//   depth:   進める前の綴りの文字数
+//   spell:   綴り
+//   doubled: 促音の後(子音を重ねる)
+//  戻り値
+//   進めた後の綴りの文字数(0xff: 行の最小値が上限を超えたので打ち切り)
+//
+uint8_t SKK::fuzzy_push(SKKFuzzyWalk* w, uint8_t depth, const char* spell, uint8_t doubled) {
+	uint8_t cap = w->max_dist + 1;
+	char s[8];
+	uint8_t len = 0;
+
+	if (doubled && !is_vowel(spell[0]) && spell[0] != 'n')
+		s[len++] = spell[0];
+	while (*spell != '\0' && len < sizeof(s))
+		s[len++] = *spell++;
+	for (uint8_t j = 0; j < len; j++, depth++) {
+		if (depth >= SKK_FUZZY_DEPTH)
+			return 0xff;
+		const uint8_t* prev = w->row[depth];
+		uint8_t* row = w->row[depth + 1];
+		char c = s[j];
+		uint8_t lo;
+
+		w->path[depth] = c;
+		row[0] = lo = depth + 1 < cap ? depth + 1 : cap;
+		// 対角線から max_dist より離れた列は常に上限を超える(作業領域の初期値のまま)
+		uint16_t first = depth + 1 > w->max_dist ? depth + 1 - w->max_dist : 1;
+		uint16_t last = depth + 1 + w->max_dist < w->in_len ? depth + 1 + w->max_dist : w->in_len;
+		for (uint16_t i = first; i <= last; i++) {
+			uint8_t d = prev[i - 1] + (w->in[i - 1] != c);             // 置換(一致)
+			if (prev[i] + 1 < d)
+				d = prev[i] + 1;                                       // 入力にない文字
+			if (row[i - 1] + 1 < d)
+				d = row[i - 1] + 1;                                    // 入力の余分な文字
+			if (depth >= 1 && i >= 2 && w->in[i - 1] == w->path[depth - 1] && w->in[i - 2] == c &&
+			    w->row[depth - 1][i - 2] + 1 < d)
+				d = w->row[depth - 1][i - 2] + 1;                      // 隣接文字の入れ替え
+			row[i] = d < cap ? d : cap;
+			if (row[i] < lo)
+				lo = row[i];
+		}
+		if (lo >= cap)
+			return 0xff;
+	}
+	return depth;
+}
+
+// 近似検索の節(内部処理用)
+//  インデックスの [lo, hi) は先頭 prefix_len バイトが同じキー。その先の1文字毎に子の節に分けて辿る。
+//  引数
+//   depth:        この節までの綴りの文字数
+//   base:         この節の最後のかなを綴る前の文字数(拗音は前のかなと合わせて綴り直す)
+//   last:         この節の最後のかな(0: なし、または拗音として綴り済み)
+//   last_spell:   last の綴り
+//   last_doubled: last は促音の後
+//   mode:         節の種類(SKK_FUZZY_*)
+//
+void SKK::fuzzy_visit(SKKFuzzyWalk* w, int32_t lo, int32_t hi, uint16_t prefix_len, uint8_t depth,
+                      uint8_t base, uint16_t last, const char* last_spell, uint8_t last_doubled, uint8_t mode) {
+	uint8_t sokuon = mode == SKK_FUZZY_SOKUON;
+	int32_t i = lo;
+
+	if (lo >= hi)
+		return;
+	w->nodes++;
+	const unsigned char* k = key_at(lo);
+	if (k[prefix_len] == ',' || k[prefix_len] == '\0') {
+		// この節で終わるキー(整列順で先頭にある)
+		uint8_t d = w->row[depth][w->in_len];
+		if (mode == SKK_FUZZY_NORMAL && d <= w->max_dist) {
+			uint16_t j;
+			for (j = 0; j < w->count && w->out_index[j] != lo; j++)
+				;
+			if (j < w->count) {
+				if (d < w->out_dist[j])
+					w->out_dist[j] = d;        // 別の綴りの方が近い
+			} else if (w->count < w->max_out) {
+				w->out_index[w->count] = lo;
+				w->out_dist[w->count++] = d;
+			} else if (d < w->out_dist[w->count - 1]) {
+				j = w->count - 1;
+				w->out_index[j] = lo;
+				w->out_dist[j] = d;
+			} else {
+				j = w->count;
+			}
+			// 編集距離・インデックスの順に保つ
+			while (j > 0 && j < w->count &&
+			       (w->out_dist[j] < w->out_dist[j - 1] ||
+			        (w->out_dist[j] == w->out_dist[j - 1] && w->out_index[j] < w->out_index[j - 1]))) {
+				int32_t ti = w->out_index[j]; w->out_index[j] = w->out_index[j - 1]; w->out_index[j - 1] = ti;
+				uint8_t td = w->out_dist[j]; w->out_dist[j] = w->out_dist[j - 1]; w->out_dist[j - 1] = td;
+				j--;
+			}
+		}
+		i++;
+	}
+
+	while (i < hi) {
+		k = key_at(i);
+		unsigned char c0 = k[prefix_len];
+		uint8_t clen = is_sjis_lead(c0) ? 2 : 1;
+
+		// 同じ文字が続く範囲の終わり(深い節の範囲は短いので、近くから倍々に広げて絞り込む)
+		int32_t a = i + 1, b = hi, step = 1;
+		while (a < b) {
+			int32_t probe = a + step - 1;
+			if (probe >= b)
+				break;
+			const unsigned char* m = key_at(probe);
+			if (m[prefix_len] != c0 || (clen == 2 && m[prefix_len + 1] != k[prefix_len + 1])) {
+				b = probe;
+				break;
 			}
-			((char*)out_okuri)[0] = '\0';
+			a = probe + 1;
+			step *= 2;
+		}
+		while (a < b) {
+			int32_t mid = a + (b - a) / 2;
+			const unsigned char* m = key_at(mid);
+			if (m[prefix_len] == c0 && (clen == 1 || m[prefix_len + 1] == k[prefix_len + 1]))
+				a = mid + 1;
+			else
+				b = mid;
+		}
+		if (clen == 2) {
+			uint16_t code = c0 << 8 | k[prefix_len + 1];
+			const char* sp[SKK_FUZZY_SPELLINGS];
+			uint8_t nsp = 0, unit = 0;
+			if (last != 0 && small_kana_index(code) >= 0) {
+				unsigned char pair[4] = { (unsigned char)(last >> 8), (unsigned char)last, c0, k[prefix_len + 1] };
+				nsp = spellings(pair, 4, sp);
+				unit = nsp > 0;
+			}
+			if (!unit && mode != SKK_FUZZY_UNITS_ONLY)
+				nsp = spellings(k + prefix_len, 2, sp);
+			uint8_t from = unit ? base : depth;
+			uint8_t doubled = unit ? last_doubled : sokuon;
+			uint8_t pruned = 0;
+			for (uint8_t s = 0; s < nsp; s++) {
+				uint8_t d = fuzzy_push(w, from, sp[s], doubled);
+				if (d != 0xff)
+					fuzzy_visit(w, i, a, prefix_len + 2, d, from, unit ? 0 : code, sp[s], doubled, SKK_FUZZY_NORMAL);
+				else
+					pruned++;
+			}
+			if (!unit && nsp > 0 && pruned == nsp && fuzzy_combines[code - SKK_FUZZY_KANA_FIRST]) {
+				// "chi" では遠くても "cho" なら近いことがある
+				fuzzy_visit(w, i, a, prefix_len + 2, depth, from, code, sp[0], doubled, SKK_FUZZY_UNITS_ONLY);
+			}
+			if (unit && mode != SKK_FUZZY_UNITS_ONLY)
+				fuzzy_push(w, base, last_spell, last_doubled);   // 前のかなの行に戻す
+			if (code == 0x82c1 && mode == SKK_FUZZY_NORMAL)
+				fuzzy_visit(w, i, a, prefix_len + 2, depth, depth, 0, NULL, 0, SKK_FUZZY_SOKUON);  // っ: 次の子音を重ねる
+		}
+		i = a;
+	}
+}
+
+// ローマ字の近似検索
+//  入力したローマ字と、綴りの編集距離が max_dist 以下の見出し語(送りなし)を探す。
+//  辞書の大きさではなく辿った節の数に比例した時間で終わる。
+//  引数
+//   token:     入力トークン(小文字のローマ字。送りのあるトークンは扱わない)
+//   token_len: token のバイト数
+//   max_dist:  編集距離の上限(1～SKK_FUZZY_MAX_DIST)
+//   out_index: 見つけた見出し語のインデックス(編集距離の小さい順)
+//   out_dist:  見出し語の編集距離
+//   max_out:   out_index・out_dist の要素数
+//   nodes:     辿った節の数の格納先(NULL可)
+//  戻り値
+//   見つけた見出し語の数
+//
+uint16_t SKK::find_fuzzy(const char* token, uint16_t token_len, uint8_t max_dist, int32_t* out_index,
+                         uint8_t* out_dist, uint16_t max_out, uint32_t* nodes) {
+	SKKFuzzyWalk w;
+
+	if (nodes)
+		*nodes = 0;
+	if (abbrev_count >= size_keyword || token_len == 0 || token_len >= SKK_TOKEN_MAX || max_out == 0 ||
+	    max_dist == 0 || max_dist > SKK_FUZZY_MAX_DIST)
+		return 0;
+	for (uint16_t i = 0; i < token_len; i++) {
+		if (!islower((unsigned char)token[i]) && token[i] != '-')
 			return 0;
+	}
+	w.in = token;
+	w.in_len = token_len;
+	w.max_dist = max_dist;
+	memset(w.row, max_dist + 1, sizeof(w.row));
+	for (uint16_t i = 0; i <= token_len; i++)
+		w.row[0][i] = i <= max_dist ? i : max_dist + 1;
+	w.out_index = out_index;
+	w.out_dist = out_dist;
+	w.max_out = max_out;
+	w.count = 0;
+	w.nodes = 0;
+	fuzzy_visit(&w, abbrev_count, size_keyword, 0, 0, 0, 0, NULL, 0, SKK_FUZZY_NORMAL);
+	if (nodes)
+		*nodes = w.nodes;
+	return w.count;
+}
+
+// 候補リストに同じ候補があるか
+//  list の先頭 list_len バイト(「読み,候補1,...」)を探す
+static uint8_t list_has(const char* list, uint16_t list_len, const char* cand, uint16_t cand_len) {
+	const char* p = (const char*)memchr(list, ',', list_len);
+	const char* end = list + list_len;
+	while (p != NULL && p < end) {
+		const char* q = p + 1;
+		const char* e = q;
+		while (e < end && *e != ',')
+			e++;
+		if (e - q == cand_len && memcmp(q, cand, cand_len) == 0)
+			return 1;
+		p = e;
+	}
+	return 0;
+}
+
+// 近似検索した読みの候補リストの取得
+//  最も近い読み(同じ編集距離の読みは SKK_FUZZY_READINGS 件まで)の候補を1つの候補リストにまとめる。
+//  2つ目以降の読みの候補は、先の読みの候補と重なるものを除いて後ろに続ける。
+//  引数
+//   kouho_list: 候補リストの格納先(get_top_kouho() と同じ)
+//   list_size:  kouho_list のバイト数(終端含む)
+//   key_index:  最も近い読みのインデックス番号の格納先(先頭の候補はこの読みのもの)
+//   token・token_len・max_dist: find_fuzzy() と同じ
+//   k:          取得する候補数の上限
+//  戻り値
+//   まとめた読みの数(0:近い読みなし)
+//
+uint16_t SKK::get_fuzzy_kouho(char* kouho_list, uint16_t list_size, uint32_t* key_index,
+                              const char* token, uint16_t token_len, uint8_t max_dist, uint16_t k) {
+	int32_t index[SKK_FUZZY_READINGS];
+	uint8_t dist[SKK_FUZZY_READINGS];
+	uint16_t n, readings, cands, len;
+
+	if (list_size == 0)
+		return 0;
+	kouho_list[0] = '\0';
+	n = find_fuzzy(token, token_len, max_dist, index, dist, SKK_FUZZY_READINGS);
+	if (n == 0)
+		return 0;
+	cands = get_top_kouho(kouho_list, list_size, index[0], k);
+	*key_index = index[0];
+	len = strlen(kouho_list);
+	readings = 1;
+	for (uint16_t i = 1; i < n && dist[i] == dist[0] && cands < k && len + 1 < list_size; i++) {
+		char* tail = kouho_list + len;
+		uint16_t m = get_top_kouho(tail, list_size - len, index[i], k - cands);
+		char* p = strchr(tail, ',');
+		if (m == 0 || p == NULL) {
+			*tail = '\0';
+			continue;
+		}
+		// 読みを外し、先の読みと重なる候補を除く
+		memmove(tail, p, strlen(p) + 1);
+		p = tail;
+		while (*p == ',') {
+			char* e = p + 1;
+			while (*e != '\0' && *e != ',')
+				e++;
+			if (list_has(kouho_list, len, p + 1, e - (p + 1))) {
+				memmove(p, e, strlen(e) + 1);
+				m--;
+			} else {
+				p = e;
+			}
 		}
+		len = strlen(kouho_list);
+		cands += m;
+		readings++;
 	}
+	return readings;
 }
 
 //
@@ -325,10 +1288,21 @@ uint8_t SKK::get_kouho_list_index(uint32_t* out_kouho_index, char* out_okuri, ch
 //   データ数
 //
 uint16_t SKK::count_kouho_list(const char* kouho_list) {
-	char *ptr = (char*)kouho_list;
+	return count_kouho_list(kouho_list, strlen(kouho_list));
+}
+
+//
+// 候補リストの候補数のカウント(長さ指定版)
+//  引数
+//   kouho_list: カンマ区切りの候補リスト文字列
+//   list_len:   kouho_list のバイト数
+//  戻り値
+//   データ数
+//
+uint16_t SKK::count_kouho_list(const char* kouho_list, uint16_t list_len) {
 	uint16_t cnt=0;
-	for(cnt=0; *ptr!='\0'; ptr++) {
-		if (*ptr == ',') cnt++;
+	for (uint16_t i = 0; i < list_len && kouho_list[i] != '\0'; i++) {
+		if (kouho_list[i] == ',') cnt++;
 	}
 	return cnt;
 }
@@ -337,34 +1311,21 @@ uint16_t SKK::count_kouho_list(const char* kouho_list) {
 
 uint16_t  SKK::count_kouho_list_by_index(uint32_t key_index) {
 	uint16_t cnt=0;
-	uint32_t pos, pos_next; // キーワード格納位置
+	uint32_t pos; // キーワード格納位置
 	uint32_t size;
-	// int rc; // Not used
-	// char c; // Not used
-	
-	if (key_index >= size_keyword)
-		return 0;
 	
 	// インデックスの格納の位置の取得	
-	memcpy(&pos, fp_skk_data + SSK_BIN_HEAD_SIZE + key_index*4, 4);
-	if (key_index != size_keyword-1) {
-		memcpy(&pos_next, fp_skk_data + SSK_BIN_HEAD_SIZE + (key_index+1)*4, 4);
-		size = pos_next - pos;
-	} else {
-		size = 30; // 最終データの場合、仮サイズを指定
-	}
+	if (!entry_range(key_index, &pos, &size))
+		return 0;
 
 	const unsigned char* current_ptr = fp_skk_data + pos + keyword_data_top;
 
-	// ','の個数を数える
-    for (uint16_t i = 0; i<size; i++) {
+	// ','の個数を数える(キーワードの後ろの','から候補ごとに1個)
+    for (uint32_t i = 0; i<size && *current_ptr != '\0'; i++) {
 		if (*current_ptr == ',')
 			cnt++;
 		current_ptr++;
 	}
-	if (cnt>1)
-		// 先頭のキーの分を引く
-		cnt--;
 	return cnt;
 }
 
@@ -378,43 +1339,44 @@ uint16_t  SKK::count_kouho_list_by_index(uint32_t key_index) {
 //   0:データなし 1:データあり    
 //
 uint8_t SKK::get_kouho(const char* kouho, const char* kouho_list, uint16_t list_index) {
-	char *src = (char*)kouho_list;
-	uint16_t top = 0;
-	uint16_t pos;
-	uint16_t n = 0;
+	return get_kouho(kouho, kouho_list, strlen(kouho_list), list_index);
+}
 
-	uint16_t cnt = count_kouho_list(kouho_list);   // データ件数の取得
-	if (cnt == 0) {
-		// 候補がない場合
-		((char *)kouho)[0] = '\0';
-		return 0;
-	}
+//
+// 候補データからデータの取得(長さ指定版)
+//  候補リストを先頭から1回だけ走査する
+//  引数
+//   kouho:       候補(単語)の格納先(out)
+//   kouho_list:  候補リスト(in)
+//   list_len:    候補リストのバイト数(in)
+//   list_index:  候補データ内データ位置(in)
+//  戻り値
+//   0:データなし 1:データあり    
+//
+uint8_t SKK::get_kouho(const char* kouho, const char* kouho_list, uint16_t list_len, uint16_t list_index) {
+	uint16_t i = 0;
+	uint16_t n = 0;
+	char* dst = (char*)kouho;
 
-	// 指定位置の候補データの取得
-	while(true) {
-		if (*src == ',') {
-			if (n == list_index) {
-				src++;
-				break;
-			}
-			n++;
-		} else if(*src == 0) {
+	// 指定位置の候補データの先頭(list_index+1 個目の ',' の次)を探す
+	for (;;) {
+		if (i >= list_len || kouho_list[i] == '\0') {
 			// 候補がない場合
-			((char *)kouho)[0] = '\0';
+			*dst = '\0';
 			return 0;
 		}
-		src++;
+		if (kouho_list[i++] == ',') {
+			if (n == list_index)
+				break;
+			n++;
+		}
 	}
 
 	// データと取り出し
-	char* dst = (char*)kouho;
-	while(true) {
-		*dst++ = *src++;
-		if (*src == ',' || *src == '\0') {
-			*dst = '\0';
-			break;
-		}
+	while (i < list_len && kouho_list[i] != ',' && kouho_list[i] != '\0') {
+		*dst++ = kouho_list[i++];
 	}
+	*dst = '\0';
 	return 1;
 }
 
@@ -426,25 +1388,17 @@ uint8_t SKK::get_kouho(const char* kouho, const char* kouho_list, uint16_t list_
 //  戻り値
 //   0:データなし 1:データあり
 //
-uint8_t SKK::get_kouho_by_index(const char* kouho, uint16_t list_index, uint16_t key_index) {
+uint8_t SKK::get_kouho_by_index(const char* kouho, uint16_t list_index, uint32_t key_index) {
 	uint16_t cnt=0;
-	uint32_t pos, pos_next; // キーワード格納位置
+	uint32_t pos; // キーワード格納位置
 	uint32_t size;
-	// int rc; // Not used
-	// char c; // Not used
 	uint8_t flg_found = 0;
 	char* ptr_kouho = (char*)kouho;
 
-	if (key_index >= size_keyword)
-		return 0;
-	
 	// インデックスの格納の位置の取得	
-	memcpy(&pos, fp_skk_data + SSK_BIN_HEAD_SIZE + key_index*4, 4);
-	if (list_index != size_keyword-1) {
-		memcpy(&pos_next, fp_skk_data + SSK_BIN_HEAD_SIZE + (key_index+1)*4, 4);
-		size = pos_next - pos;
-	} else {
-		size = 30; // 最終データの場合、仮サイズを指定
+	if (!entry_range(key_index, &pos, &size)) {
+		*ptr_kouho = '\0';
+		return 0;
 	}
 
 	const unsigned char* current_ptr = fp_skk_data + pos + keyword_data_top;
@@ -470,6 +1424,116 @@ uint8_t SKK::get_kouho_by_index(const char* kouho, uint16_t list_index, uint16_t
 	return flg_found;
 }
 
+// 候補リストの先頭 k 件の取得
+//  候補スコア部のある辞書では候補は頻度の高い順に並んでいるので、上位 k 件になる。
+//  k 件目の候補(または list_size に収まる最後の候補)の後ろは読まない。
+//  引数
+//   kouho_list: 候補リストの格納先(get_kouho_list() と同じ「読み,候補1,...」の形式)
+//   list_size:  kouho_list のバイト数(終端含む)
+//   key_index:  キーワードのインデックス番号
+//   k:          取得する候補数の上限
+//  戻り値
+//   格納した候補数
+//
+uint16_t SKK::get_top_kouho(char* kouho_list, uint16_t list_size, uint32_t key_index, uint16_t k) {
+	uint32_t pos, size;
+	uint16_t n = 0;
+	uint16_t len = 0;          // 格納済みのバイト数(最後に収まった候補の終わり)
+	uint16_t i;
+
+	if (list_size == 0)
+		return 0;
+	kouho_list[0] = '\0';
+	if (!entry_range(key_index, &pos, &size))
+		return 0;
+	const unsigned char* d = fp_skk_data + keyword_data_top + pos;
+
+	// 読み
+	for (i = 0; i < size && d[i] != ',' && d[i] != '\0'; i++)
+		;
+	if (i >= list_size)
+		return 0;
+	memcpy(kouho_list, d, i);
+	len = i;
+
+	// 候補(',' から次の ',' まで)を丸ごと収まる分だけ
+	while (n < k && len < size && d[len] == ',') {
+		uint32_t end = len + 1;
+		while (end < size && d[end] != ',' && d[end] != '\0')
+			end++;
+		if (end >= list_size)
+			break;
+		memcpy(kouho_list + len, d + len, end - len);
+		len = end;
+		n++;
+	}
+	kouho_list[len] = '\0';
+	return n;
+}
+
+// 候補の頻度スコアの取得
+//  引数
+//   key_index:  キーワードのインデックス番号
+//   list_index: 候補リスト内の位置
+//  戻り値
+//   頻度スコア(0:頻度なし、または候補スコア部がない)
+//
+uint8_t SKK::get_kouho_score(uint32_t key_index, uint16_t list_index) {
+	uint32_t pos, i;
+
+	if (score_base == NULL || key_index >= size_keyword || list_index >= score_count[key_index])
+		return 0;
+	memcpy(&pos, score_base + key_index / SKK_SCORE_BLOCK * 4, 4);
+	for (i = key_index - key_index % SKK_SCORE_BLOCK; i < key_index; i++)
+		pos += score_count[i];
+	pos += list_index;
+	return pos < score_size ? score_data[pos] : 0;
+}
+
+// 候補の注釈の取得
+//  候補IDで注釈部を二分検索する。辞書イメージを読むだけなので、検索中の作業者とも並行して呼べる。
+//  引数
+//   annot:      注釈の格納先(終端付き。annot_size に収まらない分は切り捨てる)
+//   annot_size: annot のバイト数(終端含む)
+//   key_index:  キーワードのインデックス番号
+//   list_index: 候補リスト内の位置
+//  戻り値
+//   格納した注釈のバイト数(0:注釈なし)
+//
+uint16_t SKK::get_annotation(char* annot, uint16_t annot_size, uint32_t key_index, uint16_t list_index) {
+	uint32_t id = key_index << 8 | list_index;
+	uint32_t lo = 0, hi, mid, x, start, end;
+
+	if (annot_size == 0)
+		return 0;
+	annot[0] = '\0';
+	if (annot_ids == NULL || list_index >= SKK_ANNOT_MAX_INDEX || key_index >= size_keyword)
+		return 0;
+	hi = annot_count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		memcpy(&x, annot_ids + mid * 4, 4);
+		if (x < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo >= annot_count)
+		return 0;
+	memcpy(&x, annot_ids + lo * 4, 4);
+	if (x != id)
+		return 0;
+	memcpy(&start, annot_offsets + lo * 4, 4);
+	memcpy(&end, annot_offsets + lo * 4 + 4, 4);
+	if (end < start)
+		return 0;
+	if (end - start >= annot_size)
+		end = start + annot_size - 1;
+	memcpy(annot, annot_text + start, end - start);
+	annot[end - start] = '\0';
+	return end - start;
+}
+
 //
 // ひらがな=>片仮名変換
 // 引数
@@ -479,28 +1543,20 @@ uint8_t SKK::get_kouho_by_index(const char* kouho, uint16_t list_index, uint16_t
 //  カタカナに変換した文字数
 //
 uint16_t SKK::kana_to_katakana(const char* dst, const char* src) {
-	uint16_t len=JString::len(src); // utf-8文字数の取得
-	uint32_t code;                  // utf32コード
-	char utf8char[5];               // utf-8 1文字分の一時バッファ
-	uint16_t src_nbytes;            // src utf-8 1文字分のバイト数
-	uint16_t dst_nbytes;            // dst utf-8 1文字分のバイト数
-	char* src_ptr = (char*)src;     // 変換元文字列参照位置
-	char* dst_ptr = (char*)dst;     // 変換先文字列格納位置
-	uint16_t rc = 0;
-
-	for (uint16_t i = 0; i < len; i++) {
-		src_nbytes = JString::get(utf8char, src_ptr);      // 1文字取り出し
-		src_ptr += src_nbytes;
-		code = JString::utf8to32(utf8char);                // utf-8からutf32に変換
-		if (code >= 0x3041 && code <= 0x3093) {
-				code = code + 96;                              // カタカナコードに変換
-				rc++;
-		}
-		// utf32からutf8に変換
-		dst_nbytes = JString::utf32to8(dst_ptr, code);
-		dst_ptr += dst_nbytes;
-	}
-	return rc;
+	return kana_to_katakana(dst, src, strlen(src));
+}
+
+//
+// ひらがな=>片仮名変換(長さ指定版)
+// 引数
+//  dst:     変換したカタカナ格納先
+//  src:     変換対象文字列格納先
+//  src_len: src のバイト数
+// 戻り値
+//  カタカナに変換した文字数
+//
+uint16_t SKK::kana_to_katakana(const char* dst, const char* src, uint16_t src_len) {
+	return JString::hira_to_kata((char*)dst, src, src_len);
 }
 
 // ローマ字ひらがな変換
@@ -514,28 +1570,18 @@ uint16_t SKK::roma_to_kana(char* dst, char* src) {
 	return JString::roma_to_kana(dst, src);
 }
 
+// ローマ字ひらがな変換(長さ指定版)
+uint16_t SKK::roma_to_kana(char* dst, const char* src, uint16_t src_len) {
+	return JString::roma_to_kana(dst, src, src_len);
+}
+
 // 半角⇒全角変換
 void SKK::han_to_zen(const char* dst, const char* src) {
-	uint16_t len=JString::len(src); // utf-8文字数の取得
-	uint32_t code;                  // utf32コード
-	char utf8char[5];               // utf-8 1文字分の一時バッファ
-	uint16_t src_nbytes;            // src utf-8 1文字分のバイト数
-	uint16_t dst_nbytes;            // dst utf-8 1文字分のバイト数
-	char* src_ptr = (char*)src;     // 変換元文字列参照位置
-	char* dst_ptr = (char*)dst;     // 変換先文字列格納位置
-
-	for (uint16_t i = 0; i < len; i++) {
-		src_nbytes = JString::get(utf8char, src_ptr);      // 1文字取り出し
-		src_ptr += src_nbytes;
-		code = JString::utf8to32(utf8char);                // utf-8からutf32に変換
-		if (code >= 0x21 && code <= 0x7e) {
-				code = code + 65248;                           // カタカナコードに変換
-		} else if (code == 0x20) {
-			code = 0x3000;
-		}
-		// utf32からutf8に変換
-		dst_nbytes = JString::utf32to8(dst_ptr, code);
-		dst_ptr += dst_nbytes;
-	}
+	han_to_zen(dst, src, strlen(src));
+}
+
+// 半角⇒全角変換(長さ指定版)
+void SKK::han_to_zen(const char* dst, const char* src, uint16_t src_len) {
+	JString::ascii_to_zen((char*)dst, src, src_len);
 }
 
@@ -7,31 +7,219 @@
 #include <string.h>
 #include <stdint.h>
 #include <ctype.h>
+#ifdef ARM9
 #include <fat.h> // For NDS file I/O
+#endif
 
 #define SSK_BINDIC_FILE 	  "ssk_dic_m.bin"
 #define SSK_BIN_HEAD_SIZE 	12
 
+// 拡張ヘッダー
+//  基本ヘッダー(12バイト)の後ろに格納し、ヘッダーのバイト数を SKK_HEAD_LENGTH に記録する。
+//  SKK_HEAD_LENGTH のない旧形式(16～28バイト)は、ヘッダーの直後から各部を置くので、キーワード
+//  インデックスとそれまでに読んだ各部の位置のうち最も前のものをヘッダーの終わりとみなす。
+//  ヘッダーの外の項目は 0 とみなす。
+#define SKK_HEAD_COMPARATOR 	12      // キーの整列順序 (SKK_CMP_*)
+#define SKK_HEAD_BLOOM      	16      // Bloomフィルタ部の位置(0:なし)
+#define SKK_HEAD_SCORE      	20      // 候補スコア部の位置(0:なし)
+#define SKK_HEAD_ANNOT      	24      // 注釈部の位置(0:なし)
+#define SKK_HEAD_LENGTH     	28      // ヘッダーのバイト数
+#define SKK_HEAD_SIZE       	32      // skk_dict_compiler が出力するヘッダーサイズ
+#define SKK_SECTIONS        	3       // ヘッダーとキーワードインデックスの間に置く部の数(Bloom・スコア・注釈)
+
+// キーの整列順序
+#define SKK_CMP_UNKNOWN     	0       // 記録なし(旧形式)
+#define SKK_CMP_BYTES       	1       // 符号なしバイト列順(strcmp() と同じ。binfind() の比較順序)
+
+// Bloomフィルタ
+//  キーの種類毎に1つ持ち、辞書にないキーの検索をインデックスを参照せずに打ち切る。
+//  Bloomフィルタ部の形式(各 uint32_t LE):
+//   種類数, 以降種類毎に [ビット数(32の倍数), ハッシュ数, ビット列(ビット数/8 バイト)]
+#define SKK_BLOOM_KANA      	0       // かな読み(0x80以上のバイトを含むキー)
+#define SKK_BLOOM_ASCII     	1       // 英字略語(ASCIIのみのキー)
+#define SKK_BLOOM_CLASSES   	2       // キーの種類数
+#define SKK_BLOOM_MIN_BITS  	32      // 最小ビット数
+#define SKK_BLOOM_MAX_BITS  	(1u << 27)  // 最大ビット数(16Mバイト)
+#define SKK_BLOOM_MAX_HASH  	16      // 最大ハッシュ数
+
+// 候補スコア部
+//  頻度表を与えて作った辞書では、各項目の候補を頻度の高い順に格納し、候補毎に1バイトの
+//  頻度スコア(0:頻度なし、1～255:出現回数の対数。大きいほど多い)を持つ。
+//  候補スコア部の形式:
+//   登録単語数(uint32_t LE),
+//   ブロック毎のスコア開始位置(uint32_t LE × ceil(登録単語数 / SKK_SCORE_BLOCK)),
+//   項目毎のスコア数(uint8_t × 登録単語数。候補数、255を超える場合は255),
+//   スコア(uint8_t × スコア数の合計)
+//  項目のスコアの位置は、ブロックの開始位置にブロック内でその項目より前の項目のスコア数を足して求める。
+#define SKK_SCORE_BLOCK     	16      // スコア開始位置を持つ間隔(項目数)
+
+// 注釈部
+//  候補の注釈(";注釈")は候補リストから外して注釈部に格納し、候補が選ばれたときだけ読む。
+//  注釈部の形式:
+//   注釈数(uint32_t LE),
+//   候補ID(uint32_t LE × 注釈数。昇順。キーワードのインデックス番号 << 8 | 候補リスト内の位置),
+//   注釈の開始位置(uint32_t LE × (注釈数 + 1)。注釈文字列の先頭から。最後は終わりの位置),
+//   注釈文字列(終端なし)
+//  候補リスト内の位置が SKK_ANNOT_MAX_INDEX 以上の候補の注釈は格納しない。
+#define SKK_ANNOT_MAX_INDEX 	256
+
+// 標本インデックス(binfind() の上位段)
+//  SKK_SAMPLE_STRIDE 件毎のキーの先頭8バイトを RAM 上に持ち、ARM9 のデータキャッシュ(4Kバイト)に
+//  収まるよう件数が SKK_SAMPLE_MAX を超える辞書では間隔を2倍ずつ広げる。
+#define SKK_SAMPLE_STRIDE   	64      // 標本の最小間隔
+#define SKK_SAMPLE_MAX      	512     // 標本の最大数(8バイト×512 = 4Kバイト)
+
+// 続く文字の予測(predict_next())
+#define SKK_PREDICT_SCAN    	64      // 標本が足りない場合に数える登録語の最大数
+#define SKK_PREDICT_MIN_SAMPLES	2       // 標本だけで数えるのに必要な標本数
+
+// 検索結果キャッシュ
+#define SKK_CACHE_SIZE      	16      // キャッシュ件数
+#define SKK_CACHE_TOKEN_SIZE	32      // 非同期検索(SKKAsync)できる入力トークンの最大バイト数(終端含む)
+#define SKK_CACHE_KEY_SIZE  	48      // キャッシュできる検索キーの最大バイト数(終端含む)
+
+// 入力トークンの解析結果(analyze_token())
+#define SKK_TOKEN_MAX       	32      // 入力トークンの最大バイト数(終端含む)
+
+typedef struct {
+  char     lower[SKK_TOKEN_MAX];          // 小文字化した入力トークン
+  uint16_t keyword_len;                   // キーワード部(lower の先頭)のバイト数
+  char     okuri_char;                    // 送りの子音(送りなしは'\0')
+  char     key[SKK_TOKEN_MAX*3+2];        // 検索キー(キーワードのかな＋送りの子音、Shift-JIS)
+  uint16_t key_len;
+  char     okuri[SKK_TOKEN_MAX*3+1];      // 送りのかな(Shift-JIS)
+  uint16_t okuri_len;
+} SKKToken;
+
+// 近似検索(find_fuzzy())
+//  入力したローマ字と、見出し語(かな)のローマ字綴りとの編集距離(置換・挿入・削除・隣接文字の入れ替え)
+//  が上限以内の見出し語を探す。整列済みインデックスを先頭の文字が同じ範囲毎に分けてトライとして辿り、
+//  綴り1文字毎に編集距離表の1行を求め、行の最小値が上限を超えた枝は打ち切る。
+#define SKK_FUZZY_MAX_DIST  	2       // 編集距離の上限の最大値
+#define SKK_FUZZY_DEPTH     	(SKK_TOKEN_MAX + SKK_FUZZY_MAX_DIST + 4)  // 綴りの最大文字数
+#define SKK_FUZZY_SPELLINGS 	4       // かな1文字(拗音は2文字)の綴りの最大数
+#define SKK_FUZZY_KANA_FIRST	0x829f  // 綴りの表を持つかな(ぁ～ん)
+#define SKK_FUZZY_KANA_LAST 	0x82f1
+#define SKK_FUZZY_COMBINING 	24      // 小書きのかなと合わせて綴るかなの最大数
+#define SKK_FUZZY_SMALL     	9       // 前のかなと合わせて綴る小書きのかな(ぁぃぅぇぉゃゅょゎ)の数
+#define SKK_FUZZY_PAIR_SPELLINGS	160 // 2文字のかなの綴りの最大数
+#define SKK_FUZZY_READINGS  	4       // get_fuzzy_kouho() がまとめる見出し語の最大数
+#define SKK_FUZZY_NORMAL    	0       // 節の種類: 通常
+#define SKK_FUZZY_SOKUON    	1       // 節の種類: 綴りを保留した促音(次のかなの子音を重ねる)
+#define SKK_FUZZY_UNITS_ONLY	2       // 節の種類: 最後のかなの綴りでは打ち切りだが、拗音としてなら続く
+
+// 近似検索の作業領域
+typedef struct {
+  const char* in;                         // 入力したローマ字(小文字)
+  uint16_t in_len;
+  uint8_t  max_dist;
+  uint8_t  row[SKK_FUZZY_DEPTH + 1][SKK_TOKEN_MAX];  // 綴りの先頭 d 文字と入力の先頭 i 文字の編集距離
+  char     path[SKK_FUZZY_DEPTH];         // 辿っている見出し語の綴り
+  int32_t* out_index;                     // 見つけた見出し語(編集距離・インデックスの順)
+  uint8_t* out_dist;
+  uint16_t max_out;
+  uint16_t count;
+  uint32_t nodes;                         // 辿った節の数
+} SKKFuzzyWalk;
+
+// 検索結果キャッシュの1件
+typedef struct {
+  char     key[SKK_CACHE_KEY_SIZE];       // 検索キー(SKKToken::key)
+  int32_t  index;                         // 辞書インデックス(該当なしは-1)
+  uint32_t probes;                        // 検索に要したキーワード比較回数
+  uint32_t stamp;                         // 最終参照時刻(LRU用、0は空き)
+  uint8_t  key_len;                       // 検索キーのバイト数
+} SKKCacheEntry;
+
+// 検索結果キャッシュの統計情報
+typedef struct {
+  uint32_t hits;                          // ヒット数
+  uint32_t misses;                        // ミス数
+  uint32_t probes;                        // 実際に行ったキーワード比較回数
+  uint32_t saved_probes;                  // ヒットにより省略したキーワード比較回数
+  uint16_t hit_ratio;                     // ヒット率(千分率)
+  uint32_t filtered;                      // Bloomフィルタで省略した検索数
+} SKKCacheStats;
+
 class SKK {
  private:
   const unsigned char*  fp_skk_data;                       // 辞書データポインタ
   uint32_t size_keyword;              // 辞書登録単語数
+  uint32_t abbrev_count;              // 略語(英字で始まる見出し語)の数。バイト列順でインデックスの先頭に並ぶ
   uint32_t keyword_index_top;         // キーワードインデックス先頭位置
   uint32_t keyword_data_top;          // キーワードデータ先頭位置
-  uint32_t max_data_len = 0;          // キーワードデータ最大バイト数
-  uint32_t max_data_len_index = 0;    // 最大キーワードデータのインデックス
+  uint32_t size_image;                // 辞書イメージのバイト数
+  uint32_t key_comparator;            // キーの整列順序 (SKK_CMP_*)
+  uint32_t header_size;               // ヘッダーのバイト数
+  uint32_t section_top[SKK_SECTIONS]; // 読み込んだ部の位置
+  uint32_t section_end[SKK_SECTIONS]; // 読み込んだ部の終わり
+  uint8_t  section_count;             // 読み込んだ部の数
+  SKKCacheEntry cache[SKK_CACHE_SIZE] = {};  // 検索結果キャッシュ
+  uint32_t cache_clock = 0;           // キャッシュ参照時刻
+  uint8_t  cache_enabled = 1;         // キャッシュ使用の有無
+  SKKCacheStats cache_stats = {};     // キャッシュ統計情報
+  uint32_t probe_count = 0;           // binfind() のキーワード比較回数
+  uint64_t sample_key[SKK_SAMPLE_MAX]; // 標本キーの先頭8バイト(ビッグエンディアン、不足分は0)
+  uint32_t sample_count = 0;          // 標本数(0:標本インデックスなし)
+  uint32_t sample_shift = 0;          // 標本間隔のlog2
+  uint8_t  sample_enabled = 1;        // 標本インデックス使用の有無
+  const unsigned char* bloom_bits[SKK_BLOOM_CLASSES] = {};  // Bloomフィルタのビット列(NULL:フィルタなし)
+  uint32_t bloom_nbits[SKK_BLOOM_CLASSES];             // Bloomフィルタのビット数
+  uint8_t  bloom_nhash[SKK_BLOOM_CLASSES];             // Bloomフィルタのハッシュ数
+  const unsigned char* score_base = NULL;              // ブロック毎のスコア開始位置(NULL:スコアなし)
+  const unsigned char* score_count;                    // 項目毎のスコア数
+  const unsigned char* score_data;                     // スコア
+  uint32_t score_size;                                 // スコアのバイト数
+  const unsigned char* annot_ids = NULL;               // 注釈の候補ID(NULL:注釈なし)
+  const unsigned char* annot_offsets;                  // 注釈の開始位置
+  const unsigned char* annot_text;                     // 注釈文字列
+  uint32_t annot_count;                                // 注釈数
+  const char* fuzzy_spell[SKK_FUZZY_KANA_LAST - SKK_FUZZY_KANA_FIRST + 1][SKK_FUZZY_SPELLINGS]; // かな毎の綴り
+  uint8_t  fuzzy_nspell[SKK_FUZZY_KANA_LAST - SKK_FUZZY_KANA_FIRST + 1];                       // かな毎の綴りの数
+  uint8_t  fuzzy_combines[SKK_FUZZY_KANA_LAST - SKK_FUZZY_KANA_FIRST + 1];                     // 2文字の綴りの表の行+1(0:合わせない)
+  uint8_t  fuzzy_pair_first[SKK_FUZZY_COMBINING][SKK_FUZZY_SMALL];   // 2文字のかなの綴りの位置
+  uint8_t  fuzzy_pair_count[SKK_FUZZY_COMBINING][SKK_FUZZY_SMALL];   // 2文字のかなの綴りの数
+  const char* fuzzy_pair_spell[SKK_FUZZY_PAIR_SPELLINGS];          // 2文字のかなの綴り
 
  public:
-  uint32_t  begin(const char* param_path);   // SKK辞書利用開始
+  uint32_t  begin(const char* param_path, bool verify_order = false);    // SKK辞書利用開始
+  uint32_t  begin(const unsigned char* image, uint32_t image_size,
+                  bool verify_order = false);                             // メモリ上の辞書イメージで利用開始
+  uint8_t   check_order();                                                 // 辞書のキーが整列済みかの検査
   uint8_t   end();                                                         // SKK辞書利用終了
+  void      clear_cache();                                                 // 検索結果キャッシュの消去(辞書変更時)
+  void      enable_cache(uint8_t enable);                                  // 検索結果キャッシュの使用/不使用
+  void      get_cache_stats(SKKCacheStats* stats);                         // 検索結果キャッシュの統計情報の取得
+  void      enable_sample_index(uint8_t enable);                           // 標本インデックスの使用/不使用
+  uint32_t  get_probe_count();                                             // binfind() のキーワード比較回数の累計
 
  private:   
   uint32_t  load_skk_header();                                             // SKK辞書ヘッダー情報の取得(内部処理用)
+  uint32_t  read_header(uint32_t offset);                                  // 拡張ヘッダー項目の取得(内部処理用)
+  uint32_t  find_header_size();                                            // ヘッダーのバイト数の取得(内部処理用)
+  uint8_t   claim_section(uint32_t top, uint32_t end);                     // 部の範囲の検査と登録(内部処理用)
+  void      load_bloom();                                                  // Bloomフィルタ部の読み込み(内部処理用)
+  void      load_scores();                                                 // 候補スコア部の読み込み(内部処理用)
+  void      load_annotations();                                            // 注釈部の読み込み(内部処理用)
+  void      build_sample_index();                                          // 標本インデックスの作成(内部処理用)
+  void      sample_range(const char* key, uint16_t key_len,
+                         int32_t* first, int32_t* last);                   // 標本インデックスによる検索範囲の絞り込み(内部処理用)
+  uint8_t   may_contain(const char* key, uint16_t key_len);                // Bloomフィルタによる存在判定(内部処理用)
+  uint8_t   entry_range(uint32_t index, uint32_t* pos, uint32_t* size);    // 指定位置のキーワードデータの位置とサイズ(内部処理用)
   uint8_t   get_keyword(const char* keyword, uint32_t index);              // 指定位置のキーワードの取得(内部処理用)
   uint8_t   get_keywordData(const char* data , uint32_t index);            // 指定位置のキーワード+候補リストの取得(内部処理用)
   int32_t   binfind(const char* key, uint32_t n);                          // SKK辞書検索((内部処理用)
-  void      word2lower(char* token);                                       // 英字小文字変換((内部処理用)
-  void      splitOkuri(char* keyword, char* okuri, char* token);           // 入力をキーワードと送りに分離(内部処理用)
+  int32_t   binfind(const char* key, uint16_t key_len, uint32_t n);        // SKK辞書検索(長さ指定版)(内部処理用)
+  int       cmp_keyword(const char* key, uint16_t key_len, uint32_t index); // 指定位置のキーワードとの比較(内部処理用)
+  uint8_t   lookup(int32_t* pos, char* out_okuri, const char* token, uint16_t token_len);   // 入力トークンの辞書検索(キャッシュ付)(内部処理用)
+  int32_t   resolve(const SKKToken* t);                                      // 検索キーの辞書検索(内部処理用)
+  uint8_t   analyze_token(SKKToken* t, const char* token, uint16_t token_len); // 入力トークンの解析(内部処理用)
+  const unsigned char* key_at(uint32_t index);                             // 指定位置のキーワードの先頭(内部処理用)
+  uint8_t   spellings(const unsigned char* kana, uint8_t kana_len, const char** out); // かなの綴り(内部処理用)
+  uint8_t   fuzzy_push(SKKFuzzyWalk* w, uint8_t depth, const char* spell, uint8_t doubled); // 綴りを1つ進める(内部処理用)
+  void      fuzzy_visit(SKKFuzzyWalk* w, int32_t lo, int32_t hi, uint16_t prefix_len, uint8_t depth,
+                        uint8_t base, uint16_t last, const char* last_spell, uint8_t last_doubled,
+                        uint8_t mode);                                     // 近似検索の節(内部処理用)
 
  public:
   uint8_t   get_kouho_list(char* kouho_list, char* out_okuri, char* in_token);               // 入力文字で辞書検索
@@ -39,10 +227,40 @@ class SKK {
   uint16_t  count_kouho_list(const char* kouho_list);                                        // 候補リスト内の単語数のカウント
   uint16_t  count_kouho_list_by_index(uint32_t key_index);                                   // 直接辞書ファイルから候補リスト内の単語数のカウント
   uint8_t   get_kouho(const char* kouho, const char* kouho_list, uint16_t list_index);       // 候補リスト内の指定位置の単語の取得
-  uint8_t   get_kouho_by_index(const char* kouho, uint16_t list_ndex, uint16_t key_index);   // 直接辞書ファイルから候補リスト内の指定位置の単語の取得
+  uint8_t   get_kouho_by_index(const char* kouho, uint16_t list_ndex, uint32_t key_index);   // 直接辞書ファイルから候補リスト内の指定位置の単語の取得
+  uint16_t  get_top_kouho(char* kouho_list, uint16_t list_size, uint32_t key_index,
+                          uint16_t k);                                               // 候補リストの先頭 k 件の取得
+  uint8_t   get_kouho_score(uint32_t key_index, uint16_t list_index);                // 候補の頻度スコアの取得
+  uint8_t   has_scores() { return score_base != NULL; }                              // 候補が頻度順に並んでいるか
+  uint16_t  get_annotation(char* annot, uint16_t annot_size, uint32_t key_index,
+                           uint16_t list_index);                                     // 候補の注釈の取得
+  uint8_t   has_annotations() { return annot_ids != NULL; }                          // 注釈部があるか
+  int32_t   find_index(const char* key, uint16_t key_len);                                   // キーの辞書インデックスの取得
+  uint8_t   get_abbrev_index(uint32_t* out_kouho_index, const char* in_token, uint16_t token_len); // 略語(英字)の辞書検索
+  uint32_t  get_abbrev_count() { return abbrev_count; }                                     // 略語の見出し語数
+  uint16_t  find_fuzzy(const char* token, uint16_t token_len, uint8_t max_dist, int32_t* out_index,
+                       uint8_t* out_dist, uint16_t max_out, uint32_t* nodes = NULL);          // ローマ字の近似検索
+  uint16_t  get_fuzzy_kouho(char* kouho_list, uint16_t list_size, uint32_t* key_index,
+                            const char* token, uint16_t token_len, uint8_t max_dist,
+                            uint16_t k);                                             // 近似検索した読みの候補リストの取得
+  uint16_t  predict_next(uint16_t* out_chars, uint16_t max_chars,
+                         const char* prefix, uint16_t prefix_len);                           // 前置キーに続く文字の予測
   uint16_t  kana_to_katakana(const char* dst, const char* src);                              // かな⇒カタカナ変換
   void      han_to_zen(const char* dst, const char* src);                                    // 半角⇒全角変換
   uint16_t  roma_to_kana(char* dst, char* src);                                              // ローマ字かな変換
+
+  static uint32_t key_hash(const char* key, uint16_t key_len);                     // Bloomフィルタ用キーのハッシュ値
+  static uint8_t  key_class(const char* key, uint16_t key_len);                    // Bloomフィルタ用キーの種類(SKK_BLOOM_*)
+  static uint32_t bloom_step(uint32_t hash);                                       // Bloomフィルタ用2つ目のハッシュ値
+
+  // 長さ指定版(入力は'\0'終端を必要としない)
+  uint8_t   get_kouho_list(char* kouho_list, char* out_okuri, const char* in_token, uint16_t token_len);
+  uint8_t   get_kouho_list_index(uint32_t* kouho_list_index, char* out_okuri, const char* token, uint16_t token_len);
+  uint16_t  count_kouho_list(const char* kouho_list, uint16_t list_len);
+  uint8_t   get_kouho(const char* kouho, const char* kouho_list, uint16_t list_len, uint16_t list_index);
+  uint16_t  kana_to_katakana(const char* dst, const char* src, uint16_t src_len);
+  void      han_to_zen(const char* dst, const char* src, uint16_t src_len);
+  uint16_t  roma_to_kana(char* dst, const char* src, uint16_t src_len);
 };
 
 #endif
\ No newline at end of file
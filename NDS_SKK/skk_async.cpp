@@ -0,0 +1,381 @@
+//
+// SKK非同期辞書検索  skk_async.cpp
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "skk_async.h"
+
+// 利用開始
+//  引数 skk: 検索に使う辞書(begin() 済みであること)
+//  戻り値 1:成功 0:失敗(作業スレッドを起動できない)
+//
+uint8_t SKKAsync::begin(SKK* param_skk) {
+	skk = param_skk;
+	memset(slots, 0, sizeof(slots));
+	memset(&stats, 0, sizeof(stats));
+#ifdef SKK_ASYNC_THREADS
+	if (running)
+		return 1;
+	pthread_mutex_init(&lock, NULL);
+	pthread_cond_init(&wake, NULL);
+	pthread_cond_init(&done, NULL);
+	stopping = 0;
+	if (pthread_create(&worker, NULL, worker_main, this) != 0)
+		return 0;
+	running = 1;
+#endif
+	return 1;
+}
+
+// 利用終了
+void SKKAsync::end() {
+	cancel_all();
+#ifdef SKK_ASYNC_THREADS
+	if (!running)
+		return;
+	enter();
+	stopping = 1;
+	pthread_cond_signal(&wake);
+	leave();
+	pthread_join(worker, NULL);
+	pthread_cond_destroy(&done);
+	pthread_cond_destroy(&wake);
+	pthread_mutex_destroy(&lock);
+	running = 0;
+#endif
+}
+
+void SKKAsync::enter() {
+#ifdef SKK_ASYNC_THREADS
+	pthread_mutex_lock(&lock);
+#endif
+}
+
+void SKKAsync::leave() {
+#ifdef SKK_ASYNC_THREADS
+	pthread_mutex_unlock(&lock);
+#endif
+}
+
+SKKAsync::Slot* SKKAsync::find(uint32_t ticket) {
+	for (uint8_t i = 0; i < SKK_ASYNC_SLOTS; i++) {
+		if (slots[i].state != SLOT_FREE && slots[i].result.ticket == ticket)
+			return &slots[i];
+	}
+	return NULL;
+}
+
+// 要求順に処理するため、チケットの最も古い未処理要求を返す(先読みは通常の要求の後)
+SKKAsync::Slot* SKKAsync::oldest_pending() {
+	Slot* oldest = NULL;
+	for (uint8_t i = 0; i < SKK_ASYNC_SLOTS; i++) {
+		Slot* s = &slots[i];
+		if (s->state != SLOT_PENDING)
+			continue;
+		if (oldest == NULL || s->prefetch < oldest->prefetch ||
+		    (s->prefetch == oldest->prefetch && (int32_t)(s->result.ticket - oldest->result.ticket) < 0))
+			oldest = s;
+	}
+	return oldest;
+}
+
+// 検索の実行(スレッド版では排他の外で呼ぶ。SLOT_RUNNING の要求は作業者だけが触る)
+//  候補リストは先頭(頻度順の辞書では上位)から SKK_ASYNC_LIST_SIZE に収まる分だけ取り出す
+//  候補がなく近似検索する要求は、最も近い読みの候補を rc = 4 で返す
+void SKKAsync::run(Slot* s) {
+	if (s->abbrev) {
+		s->result.okuri[0] = '\0';
+		s->result.rc = skk->get_abbrev_index(&s->result.index, s->token, s->token_len);
+	} else
+		s->result.rc = skk->get_kouho_list_index(&s->result.index, s->result.okuri, s->token, s->token_len);
+	if (s->result.rc)
+		skk->get_top_kouho(s->result.kouho_list, SKK_ASYNC_LIST_SIZE, s->result.index, SKK_ASYNC_CAND_MAX);
+	else if (s->fuzzy > 0 && skk->get_fuzzy_kouho(s->result.kouho_list, SKK_ASYNC_LIST_SIZE, &s->result.index,
+	                                              s->token, s->token_len, s->fuzzy, SKK_ASYNC_CAND_MAX) > 0) {
+		s->result.rc = 4;
+		s->result.okuri[0] = '\0';
+	} else
+		s->result.kouho_list[0] = '\0';
+}
+
+// 検索を終えた要求を回収待ちにする(先読み・取り消し済みは解放)(排他中に呼ぶ)
+void SKKAsync::finish(Slot* s) {
+	stats.completed++;
+	s->state = (s->cancel || s->prefetch) ? SLOT_FREE : SLOT_DONE;
+	s->cancel = 0;
+}
+
+// 完了した要求の結果を回収して解放し、コールバックを呼ぶ(排他中に呼び、排他を解いて戻る)
+void SKKAsync::complete(Slot* s, SKKLookupResult* out) {
+	SKKLookupResult result;
+	SKKLookupCallback callback = s->callback;
+	void* user = s->user;
+
+	memcpy(&result, &s->result, sizeof(result));
+	s->state = SLOT_FREE;
+	leave();
+	if (out != NULL)
+		memcpy(out, &result, sizeof(result));
+	if (callback != NULL)
+		callback(&result, user);
+}
+
+// 検索要求
+//  引数 token:     検索トークン(get_kouho_list() と同じ)
+//       token_len: token のバイト数(SKK_CACHE_TOKEN_SIZE 未満)
+//       callback:  完了時に dispatch() から呼ぶ関数(NULL: poll() / wait() で回収する)
+//       fuzzy:     候補がなければ近似検索する編集距離(SKK::get_fuzzy_kouho()、結果の rc は 4。0: しない)
+//  戻り値 チケット(0: 空きがない、またはトークンが長すぎる)
+//
+uint32_t SKKAsync::submit(const char* token, uint16_t token_len, SKKLookupCallback callback, void* user,
+                          uint8_t fuzzy) {
+	return enqueue(token, token_len, callback, user, 0, fuzzy, 0);
+}
+
+// 略語の検索要求
+//  入力をかなに変換せず、英字の見出し語として検索する(SKK::get_abbrev_index()、結果の rc は 3)。
+//  引数・戻り値は submit() と同じ
+//
+uint32_t SKKAsync::submit_abbrev(const char* token, uint16_t token_len, SKKLookupCallback callback, void* user) {
+	return enqueue(token, token_len, callback, user, 0, 0, 1);
+}
+
+// 先読み要求
+//  検索結果は SKK の検索結果キャッシュに残り、同じトークンの次の検索がヒットする。
+//  通常の要求がある間は実行せず、空きが SKK_ASYNC_RESERVED 以下なら受け付けない。
+//  戻り値 チケット(取り消し用。0: 空きがない、またはトークンが長すぎる)
+//
+uint32_t SKKAsync::prefetch(const char* token, uint16_t token_len) {
+	return enqueue(token, token_len, NULL, NULL, 1, 0, 0);
+}
+
+uint32_t SKKAsync::enqueue(const char* token, uint16_t token_len, SKKLookupCallback callback,
+                           void* user, uint8_t prefetch, uint8_t fuzzy, uint8_t abbrev) {
+	Slot* s = NULL;
+	Slot* victim = NULL;
+	uint32_t ticket;
+
+	uint8_t nfree = 0;
+	enter();
+	for (uint8_t i = 0; i < SKK_ASYNC_SLOTS && token_len < SKK_CACHE_TOKEN_SIZE; i++) {
+		if (slots[i].state == SLOT_FREE) {
+			if (s == NULL)
+				s = &slots[i];
+			nfree++;
+		} else if (!prefetch && s == NULL && slots[i].state == SLOT_PENDING && slots[i].prefetch) {
+			victim = &slots[i];
+		}
+	}
+	if (s == NULL && victim != NULL) {
+		// 通常の要求は未実行の先読みを追い出して受け付ける
+		s = victim;
+		stats.cancelled++;
+	}
+	if (prefetch && nfree <= SKK_ASYNC_RESERVED)
+		s = NULL;                               // 通常の要求のための空きを残す
+	if (s == NULL) {
+		stats.rejected++;
+		leave();
+		return 0;
+	}
+	ticket = next_ticket++;
+	if (next_ticket == 0)
+		next_ticket = 1;
+	memcpy(s->token, token, token_len);
+	s->token[token_len] = '\0';
+	s->token_len = token_len;
+	s->callback = callback;
+	s->user = user;
+	s->cancel = 0;
+	s->prefetch = prefetch;
+	s->fuzzy = fuzzy;
+	s->abbrev = abbrev;
+	s->result.ticket = ticket;
+	s->result.rc = 0;
+	s->result.kouho_list[0] = '\0';
+	s->result.okuri[0] = '\0';
+	s->state = SLOT_PENDING;
+	stats.submitted++;
+	if (prefetch)
+		stats.prefetched++;
+#ifdef SKK_ASYNC_THREADS
+	pthread_cond_signal(&wake);
+#endif
+	leave();
+	return ticket;
+}
+
+// 要求の取り消し(検索中の要求は検索後に破棄する)
+void SKKAsync::cancel(uint32_t ticket) {
+	enter();
+	Slot* s = find(ticket);
+	if (s != NULL && !s->cancel) {
+		if (s->state == SLOT_RUNNING)
+			s->cancel = 1;
+		else
+			s->state = SLOT_FREE;
+		stats.cancelled++;
+	}
+	leave();
+}
+
+void SKKAsync::cancel_all() {
+	enter();
+	for (uint8_t i = 0; i < SKK_ASYNC_SLOTS; i++) {
+		Slot* s = &slots[i];
+		if (s->state == SLOT_FREE || s->cancel)
+			continue;
+		if (s->state == SLOT_RUNNING)
+			s->cancel = 1;
+		else
+			s->state = SLOT_FREE;
+		stats.cancelled++;
+	}
+	leave();
+}
+
+// 完了していれば結果を回収する
+//  戻り値 1:完了(out に結果を格納) 0:未完了または該当要求なし
+//
+uint8_t SKKAsync::poll(uint32_t ticket, SKKLookupResult* out) {
+	enter();
+	Slot* s = find(ticket);
+	if (s == NULL || s->state != SLOT_DONE) {
+		leave();
+		return 0;
+	}
+	complete(s, out);
+	return 1;
+}
+
+// 完了まで待って結果を回収する(スレッドなしの場合はその場で検索する)
+//  戻り値 1:完了(out に結果を格納) 0:該当要求なし
+//
+uint8_t SKKAsync::wait(uint32_t ticket, SKKLookupResult* out) {
+	enter();
+	Slot* s = find(ticket);
+	if (s == NULL || s->cancel || s->prefetch) {
+		leave();
+		return 0;
+	}
+#ifdef SKK_ASYNC_THREADS
+	while (s->state != SLOT_DONE) {
+		pthread_cond_wait(&done, &lock);
+		if (s->state == SLOT_FREE || s->result.ticket != ticket) {
+			leave();
+			return 0;
+		}
+	}
+#else
+	if (s->state == SLOT_PENDING) {
+		run(s);
+		finish(s);
+	}
+#endif
+	complete(s, out);
+	return 1;
+}
+
+// 未処理要求を古い順に実行する(実機のフレームの空き時間用)
+//  戻り値 実行した要求数(スレッド版は常に0)
+//
+uint32_t SKKAsync::pump(uint32_t max_requests) {
+	uint32_t n = 0;
+#ifndef SKK_ASYNC_THREADS
+	Slot* s;
+	while (n < max_requests && (s = oldest_pending()) != NULL) {
+		s->state = SLOT_RUNNING;
+		run(s);
+		finish(s);
+		n++;
+	}
+#endif
+	return n;
+}
+
+// 完了したコールバック付き要求のコールバックを呼ぶ
+//  戻り値 呼んだ数
+//
+uint32_t SKKAsync::dispatch() {
+	uint32_t n = 0;
+	for (;;) {
+		Slot* s = NULL;
+		enter();
+		for (uint8_t i = 0; i < SKK_ASYNC_SLOTS; i++) {
+			if (slots[i].state == SLOT_DONE && slots[i].callback != NULL) {
+				s = &slots[i];
+				break;
+			}
+		}
+		if (s == NULL) {
+			leave();
+			return n;
+		}
+		complete(s, NULL);
+		n++;
+	}
+}
+
+uint8_t SKKAsync::busy() {
+	uint8_t rc = 0;
+	enter();
+	for (uint8_t i = 0; i < SKK_ASYNC_SLOTS; i++) {
+		if (slots[i].state == SLOT_PENDING || slots[i].state == SLOT_RUNNING)
+			rc = 1;
+	}
+	leave();
+	return rc;
+}
+
+void SKKAsync::flush() {
+#ifdef SKK_ASYNC_THREADS
+	enter();
+	for (;;) {
+		uint8_t active = 0;
+		for (uint8_t i = 0; i < SKK_ASYNC_SLOTS; i++) {
+			if (slots[i].state == SLOT_PENDING || slots[i].state == SLOT_RUNNING)
+				active = 1;
+		}
+		if (!active)
+			break;
+		pthread_cond_wait(&done, &lock);
+	}
+	leave();
+#else
+	while (pump(SKK_ASYNC_SLOTS) > 0)
+		;
+#endif
+}
+
+void SKKAsync::get_stats(SKKAsyncStats* out) {
+	enter();
+	memcpy(out, &stats, sizeof(*out));
+	leave();
+}
+
+#ifdef SKK_ASYNC_THREADS
+// 作業スレッド: 未処理要求を古い順に検索する
+void* SKKAsync::worker_main(void* arg) {
+	SKKAsync* self = (SKKAsync*)arg;
+
+	self->enter();
+	while (!self->stopping) {
+		Slot* s = self->oldest_pending();
+		if (s == NULL) {
+			pthread_cond_wait(&self->wake, &self->lock);
+			continue;
+		}
+		s->state = SLOT_RUNNING;
+		self->leave();
+		self->run(s);
+		self->enter();
+		self->finish(s);
+		pthread_cond_broadcast(&self->done);
+	}
+	self->leave();
+	return NULL;
+}
+#endif
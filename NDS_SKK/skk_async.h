@@ -0,0 +1,110 @@
+//
+// SKK非同期辞書検索 ヘッダーファイル skk_async.h
+//  SKK::get_kouho_list()(略語は get_abbrev_index())を作業者で実行し、結果をコールバックまたはポーリングで受け取る。
+//  作業者は Linux 等ではスレッド、実機(ARM9)では pump() を呼んだフレームの空き時間。
+//  非同期検索を使う間、辞書を検索するのは作業者だけにすること
+//  (get_kouho() / count_kouho_list() のように辞書を参照しない関数と、状態を変更しない
+//   predict_next() は呼んでよい)。
+//  先読み(prefetch())は通常の要求の後に実行し、結果は SKK の検索結果キャッシュに残すだけで回収しない。
+//
+#ifndef __SKK_ASYNC_H__
+#define __SKK_ASYNC_H__
+#include <stdint.h>
+
+#include "skk.h"
+
+#if !defined(ARM9) && !defined(SKK_ASYNC_NO_THREADS)
+#define SKK_ASYNC_THREADS                     // 作業スレッドで検索する
+#include <pthread.h>
+#endif
+
+#define SKK_ASYNC_SLOTS     	8       // 同時に扱える要求数(未処理+未回収の結果)
+#define SKK_ASYNC_RESERVED  	2       // 先読みで使わずに残す空き数
+#define SKK_ASYNC_LIST_SIZE 	256     // 候補リストの最大バイト数(終端含む)
+#define SKK_ASYNC_CAND_MAX  	128     // 候補リストの最大候補数
+#define SKK_ASYNC_OKURI_SIZE	32      // 送りの最大バイト数(終端含む)
+
+// 検索結果
+typedef struct {
+  uint32_t ticket;                            // submit() の戻り値
+  uint8_t  rc;                                // get_kouho_list() の戻り値(3:略語の候補 4:近似検索した読みの候補)
+  uint32_t index;                             // 候補リストのキーワードのインデックス番号(rc > 0 のとき)
+  char     kouho_list[SKK_ASYNC_LIST_SIZE];   // 候補リスト
+  char     okuri[SKK_ASYNC_OKURI_SIZE];       // 送り
+} SKKLookupResult;
+
+// 完了コールバック(dispatch() / wait() を呼んだスレッドで呼ばれる)
+typedef void (*SKKLookupCallback)(const SKKLookupResult* result, void* user);
+
+// 統計情報
+typedef struct {
+  uint32_t submitted;                         // 受け付けた要求数
+  uint32_t completed;                         // 検索を終えた要求数
+  uint32_t cancelled;                         // 取り消した要求数(検索前・検索中・回収前)
+  uint32_t rejected;                          // 空きがなく受け付けなかった要求数
+  uint32_t prefetched;                        // 受け付けた先読み要求数(submitted に含む)
+} SKKAsyncStats;
+
+class SKKAsync {
+ private:
+  enum { SLOT_FREE, SLOT_PENDING, SLOT_RUNNING, SLOT_DONE };
+
+  typedef struct {
+    uint8_t  state;                           // SLOT_*
+    uint8_t  cancel;                          // 検索中に取り消された
+    uint8_t  prefetch;                        // 先読み(結果は回収しない)
+    uint8_t  fuzzy;                           // 候補がなければ近似検索する編集距離(0:しない)
+    uint8_t  abbrev;                          // 略語(英字)の検索
+    char     token[SKK_CACHE_TOKEN_SIZE];     // 入力トークン
+    uint16_t token_len;
+    SKKLookupCallback callback;
+    void*    user;
+    SKKLookupResult result;
+  } Slot;
+
+  SKK*     skk = NULL;
+  Slot     slots[SKK_ASYNC_SLOTS] = {};
+  uint32_t next_ticket = 1;
+  SKKAsyncStats stats = {};
+#ifdef SKK_ASYNC_THREADS
+  pthread_t       worker;
+  pthread_mutex_t lock;
+  pthread_cond_t  wake;                       // 要求の追加・終了の通知(作業スレッド向け)
+  pthread_cond_t  done;                       // 検索完了の通知(wait() 向け)
+  uint8_t         running = 0;
+  uint8_t         stopping = 0;
+  static void*    worker_main(void* arg);
+#endif
+
+  void      enter();                                                    // 排他開始(内部処理用)
+  void      leave();                                                    // 排他終了(内部処理用)
+  Slot*     find(uint32_t ticket);                                      // 要求の検索(内部処理用)
+  Slot*     oldest_pending();                                           // 最も古い未処理要求(内部処理用)
+  void      run(Slot* s);                                               // 要求の検索実行(内部処理用)
+  void      complete(Slot* s, SKKLookupResult* out);                    // 結果の回収とコールバック(内部処理用)
+  void      finish(Slot* s);                                            // 検索後の状態遷移(内部処理用)
+  uint32_t  enqueue(const char* token, uint16_t token_len, SKKLookupCallback callback,
+                    void* user, uint8_t prefetch, uint8_t fuzzy,
+                    uint8_t abbrev);                                    // 要求の登録(内部処理用)
+
+ public:
+  uint8_t   begin(SKK* skk);                                            // 利用開始(スレッド版は作業スレッドを起動)
+  void      end();                                                      // 利用終了(未処理の要求は取り消す)
+  uint32_t  submit(const char* token, uint16_t token_len,
+                   SKKLookupCallback callback = NULL, void* user = NULL,
+                   uint8_t fuzzy = 0);                                  // 検索要求(戻り値: チケット、0:受付不可)
+  uint32_t  submit_abbrev(const char* token, uint16_t token_len,
+                          SKKLookupCallback callback = NULL, void* user = NULL); // 略語の検索要求(戻り値: チケット、0:受付不可)
+  uint32_t  prefetch(const char* token, uint16_t token_len);            // 先読み要求(戻り値: チケット、0:受付不可)
+  void      cancel(uint32_t ticket);                                    // 要求の取り消し
+  void      cancel_all();                                               // 全要求の取り消し
+  uint8_t   poll(uint32_t ticket, SKKLookupResult* out);                // 完了していれば結果を回収(1:完了)
+  uint8_t   wait(uint32_t ticket, SKKLookupResult* out);                // 完了まで待って結果を回収(0:該当要求なし)
+  uint32_t  pump(uint32_t max_requests);                                // 未処理要求の実行(スレッド版は何もしない)
+  uint32_t  dispatch();                                                 // 完了した要求のコールバック呼び出し
+  uint8_t   busy();                                                     // 未処理または検索中の要求の有無
+  void      flush();                                                    // 未処理の要求(先読みを含む)を全て実行し終えるまで待つ
+  void      get_stats(SKKAsyncStats* out);                              // 統計情報の取得
+};
+
+#endif
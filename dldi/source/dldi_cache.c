@@ -0,0 +1,227 @@
+/*
+	dldi_cache.c
+	Sector cache with sequential read-ahead for the DLDI interface (see dldi_cache.h)
+*/
+#include "dldi_cache.h"
+
+#define NO_SECTOR 0xFFFFFFFF
+#define WORDS_PER_SECTOR (DLDI_CACHE_SECTOR_SIZE / 4)
+
+static uint32_t s_data[DLDI_CACHE_SECTORS][WORDS_PER_SECTOR];
+static uint32_t s_sector[DLDI_CACHE_SECTORS];  // Sector held by each buffer (NO_SECTOR: free)
+static uint32_t s_used[DLDI_CACHE_SECTORS];    // Request count at the last use (0: free)
+static uint8_t  s_ahead[DLDI_CACHE_SECTORS];   // Read ahead and not requested yet
+static uint32_t s_clock;                       // Request count
+static uint32_t s_nextSector;                  // Sector after the last read request
+static uint32_t s_readAhead;
+static DldiSectorFn s_cardRead;
+static DldiSectorFn s_cardWrite;
+static DldiCacheStats s_stats;
+
+static bool isAligned(const void* p) {
+	return ((uintptr_t)p & 3) == 0;
+}
+
+static void copySector(void* dst, const void* src) {
+	int i;
+	if (isAligned(dst) && isAligned(src)) {
+		uint32_t* d = (uint32_t*)dst;
+		const uint32_t* s = (const uint32_t*)src;
+		for (i = 0; i < WORDS_PER_SECTOR; i++)
+			d[i] = s[i];
+	} else {
+		uint8_t* d = (uint8_t*)dst;
+		const uint8_t* s = (const uint8_t*)src;
+		for (i = 0; i < DLDI_CACHE_SECTOR_SIZE; i++)
+			d[i] = s[i];
+	}
+}
+
+static void freeSlot(int slot) {
+	s_sector[slot] = NO_SECTOR;
+	s_used[slot] = 0;
+	s_ahead[slot] = 0;
+}
+
+static int findSlot(uint32_t sector) {
+	int i;
+	for (i = 0; i < DLDI_CACHE_SECTORS; i++) {
+		if (s_sector[i] == sector)
+			return i;
+	}
+	return -1;
+}
+
+// Forget the cached copies of sectors [sector, sector + numSectors)
+static void dropRange(uint32_t sector, uint32_t numSectors) {
+	int i;
+	for (i = 0; i < DLDI_CACHE_SECTORS; i++) {
+		if (s_sector[i] != NO_SECTOR && s_sector[i] - sector < numSectors)
+			freeSlot(i);
+	}
+}
+
+// First of the count adjacent buffers whose most recent use is the oldest; they are freed
+static int takeRun(uint32_t count) {
+	int best = 0;
+	uint32_t bestUsed = 0xFFFFFFFF;
+	int i, j;
+	for (i = 0; i + (int)count <= DLDI_CACHE_SECTORS; i++) {
+		uint32_t newest = 0;
+		for (j = 0; j < (int)count; j++) {
+			if (s_used[i + j] > newest)
+				newest = s_used[i + j];
+		}
+		if (newest < bestUsed) {
+			best = i;
+			bestUsed = newest;
+		}
+	}
+	for (j = 0; j < (int)count; j++)
+		freeSlot(best + j);
+	return best;
+}
+
+void dldiCache_init(DldiSectorFn cardRead, DldiSectorFn cardWrite) {
+	s_cardRead = cardRead;
+	s_cardWrite = cardWrite;
+	dldiCache_setReadAhead(DLDI_CACHE_READAHEAD);
+	dldiCache_invalidate();
+	{
+		uint32_t* p = (uint32_t*)&s_stats;   // No memset without the C library
+		uint32_t i;
+		for (i = 0; i < sizeof(s_stats) / 4; i++)
+			p[i] = 0;
+	}
+}
+
+void dldiCache_setReadAhead(uint32_t sectors) {
+	s_readAhead = sectors < DLDI_CACHE_MAX_RUN ? sectors : DLDI_CACHE_MAX_RUN - 1;
+}
+
+void dldiCache_invalidate(void) {
+	int i;
+	for (i = 0; i < DLDI_CACHE_SECTORS; i++)
+		freeSlot(i);
+	s_clock = 0;
+	s_nextSector = NO_SECTOR;
+}
+
+bool dldiCache_read(uint32_t sector, uint32_t numSectors, void* buffer) {
+	uint8_t* out = (uint8_t*)buffer;
+	bool sequential = sector == s_nextSector;
+
+	s_stats.reads++;
+	s_stats.sectorsRequested += numSectors;
+	s_nextSector = sector + numSectors;
+	s_clock++;
+	if (numSectors >= DLDI_CACHE_BYPASS && isAligned(out)) {
+		// Writes go through, so the card has the same data as the cache
+		s_stats.cardReads++;
+		s_stats.cardSectorsRead += numSectors;
+		return s_cardRead(sector, numSectors, out);
+	}
+
+	while (numSectors > 0) {
+		int slot = findSlot(sector);
+		if (slot >= 0) {
+			copySector(out, s_data[slot]);
+			s_used[slot] = s_clock;
+			s_stats.hits++;
+			if (s_ahead[slot]) {
+				s_ahead[slot] = 0;
+				s_stats.readAheadUsed++;
+			}
+			sector++;
+			out += DLDI_CACHE_SECTOR_SIZE;
+			numSectors--;
+			continue;
+		}
+
+		// Fetch the missing sectors up to the next cached one in one transfer, and when the
+		// request ends with them and continues the previous one, the sectors after it
+		uint32_t run = 1, ahead = 0, i;
+		while (run < numSectors && run < DLDI_CACHE_MAX_RUN && findSlot(sector + run) < 0)
+			run++;
+		if (sequential && run == numSectors) {
+			while (ahead < s_readAhead && run + ahead < DLDI_CACHE_MAX_RUN &&
+			       findSlot(sector + run + ahead) < 0)
+				ahead++;
+		}
+		slot = takeRun(run + ahead);
+		s_stats.cardReads++;
+		if (!s_cardRead(sector, run + ahead, s_data[slot])) {
+			if (ahead == 0)
+				return false;
+			ahead = 0;          // May have run past the end of the card
+			s_stats.cardReads++;
+			if (!s_cardRead(sector, run, s_data[slot]))
+				return false;
+		}
+		s_stats.cardSectorsRead += run + ahead;
+		s_stats.readAhead += ahead;
+		for (i = 0; i < run + ahead; i++) {
+			s_sector[slot + i] = sector + i;
+			s_used[slot + i] = s_clock;
+			s_ahead[slot + i] = i >= run;
+		}
+		for (i = 0; i < run; i++)
+			copySector(out + i * DLDI_CACHE_SECTOR_SIZE, s_data[slot + i]);
+		sector += run;
+		out += run * DLDI_CACHE_SECTOR_SIZE;
+		numSectors -= run;
+	}
+	return true;
+}
+
+bool dldiCache_write(uint32_t sector, uint32_t numSectors, const void* buffer) {
+	const uint8_t* in = (const uint8_t*)buffer;
+	int i;
+
+	s_clock++;
+	if (isAligned(in)) {
+		s_stats.cardWrites++;
+		s_stats.cardSectorsWritten += numSectors;
+		if (!s_cardWrite(sector, numSectors, (void*)in)) {
+			dropRange(sector, numSectors);   // The card may hold either version
+			return false;
+		}
+		for (i = 0; i < DLDI_CACHE_SECTORS; i++) {
+			uint32_t k = s_sector[i] - sector;
+			if (s_sector[i] != NO_SECTOR && k < numSectors)
+				copySector(s_data[i], in + k * DLDI_CACHE_SECTOR_SIZE);
+		}
+		return true;
+	}
+
+	// Unaligned: copy into adjacent buffers, which then hold the written sectors
+	while (numSectors > 0) {
+		uint32_t run = numSectors < DLDI_CACHE_MAX_RUN ? numSectors : DLDI_CACHE_MAX_RUN;
+		uint32_t k;
+		int slot;
+		dropRange(sector, run);
+		slot = takeRun(run);
+		for (k = 0; k < run; k++)
+			copySector(s_data[slot + k], in + k * DLDI_CACHE_SECTOR_SIZE);
+		s_stats.cardWrites++;
+		s_stats.cardSectorsWritten += run;
+		if (!s_cardWrite(sector, run, s_data[slot]))
+			return false;       // The buffers were freed by takeRun()
+		for (k = 0; k < run; k++) {
+			s_sector[slot + k] = sector + k;
+			s_used[slot + k] = s_clock;
+		}
+		sector += run;
+		in += run * DLDI_CACHE_SECTOR_SIZE;
+		numSectors -= run;
+	}
+	return true;
+}
+
+void dldiCache_getStats(DldiCacheStats* stats) {
+	uint32_t* d = (uint32_t*)stats;
+	const uint32_t* s = (const uint32_t*)&s_stats;
+	uint32_t i;
+	for (i = 0; i < sizeof(s_stats) / 4; i++)
+		d[i] = s[i];
+}
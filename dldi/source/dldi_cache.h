@@ -0,0 +1,60 @@
+/*
+	dldi_cache.h
+	Sector cache with sequential read-ahead between the DLDI interface
+	(iointerface.c) and the card access functions.
+
+ - A fixed set of DLDI_CACHE_SECTORS sector buffers, replaced least recently used first.
+ - A read miss is fetched together with the following missing sectors of the request in one
+   multi-sector transfer. When the miss continues the previous read, up to the read-ahead
+   count of sectors past the request are fetched in the same transfer.
+ - A transfer goes straight into a run of adjacent buffers, so no staging copy is needed.
+ - Requests of DLDI_CACHE_BYPASS sectors or more into word-aligned buffers bypass the cache.
+ - Writes go through to the card at once (the driver is not told before power off), and
+   update the cached copies. Unaligned writes are copied into buffers first.
+ - Caller buffers may be unaligned; the card functions always get word-aligned buffers.
+
+ Needs no C library, so that the driver can be linked with -nostdlib.
+*/
+#ifndef DLDI_CACHE_H
+#define DLDI_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DLDI_CACHE_SECTOR_SIZE 512
+#define DLDI_CACHE_SECTORS     16   // 8 KB: the whole driver must fit DLDI_SIZE_16KB
+#define DLDI_CACHE_READAHEAD   7    // Sectors read ahead of a sequential read (default)
+#define DLDI_CACHE_MAX_RUN     8    // Most sectors in one transfer through the cache
+#define DLDI_CACHE_BYPASS      DLDI_CACHE_SECTORS  // Direct transfers from this many sectors
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Card access: transfers whole sectors to or from a word-aligned buffer
+typedef bool (*DldiSectorFn)(uint32_t sector, uint32_t numSectors, void* buffer);
+
+typedef struct {
+	uint32_t reads;             // readSectors() calls
+	uint32_t sectorsRequested;  // Sectors asked for by readSectors()
+	uint32_t hits;              // Requested sectors found in the cache
+	uint32_t cardReads;         // Read transfers to the card
+	uint32_t cardSectorsRead;
+	uint32_t readAhead;         // Sectors read ahead of a request
+	uint32_t readAheadUsed;     // Read-ahead sectors later requested
+	uint32_t cardWrites;        // Write transfers to the card
+	uint32_t cardSectorsWritten;
+} DldiCacheStats;
+
+void dldiCache_init(DldiSectorFn cardRead, DldiSectorFn cardWrite);
+void dldiCache_setReadAhead(uint32_t sectors);  // 0 disables read-ahead (at most DLDI_CACHE_MAX_RUN - 1)
+void dldiCache_invalidate(void);                // Forget all cached sectors (card reset or change)
+bool dldiCache_read(uint32_t sector, uint32_t numSectors, void* buffer);
+bool dldiCache_write(uint32_t sector, uint32_t numSectors, const void* buffer);
+void dldiCache_getStats(DldiCacheStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DLDI_CACHE_H
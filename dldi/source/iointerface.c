@@ -2,6 +2,9 @@
 	iointerface.c template
 	
  Copyright (c) 2006 Michael "Chishm" Chisholm
+
+ Derivative work by the NDS_SKK authors: the DLDI functions go through a sector cache
+ (dldi_cache.c); the card access itself is in the card* functions below.
 	
  Redistribution and use in source and binary forms, with or without modification,
  are permitted provided that the following conditions are met:
@@ -36,18 +39,42 @@
  #include "gba_types.h"
 #endif
 
-#define BYTES_PER_READ 512
+#include "dldi_cache.h"
+
+#define BYTES_PER_READ DLDI_CACHE_SECTOR_SIZE
 
 #ifndef NULL
  #define NULL 0
 #endif
 
+/*-----------------------------------------------------------------
+cardReadSectors
+Read "numSectors" BYTES_PER_READ-byte sized sectors from the card into
+"buffer", starting at "sector". Called by the cache with a word aligned
+buffer and numSectors up to DLDI_CACHE_MAX_RUN (or a bypassed request).
+return true if it was successful, false if it failed for any reason
+-----------------------------------------------------------------*/
+static bool cardReadSectors (u32 sector, u32 numSectors, void* buffer) {
+	return false;
+}
+
+/*-----------------------------------------------------------------
+cardWriteSectors
+Write "numSectors" BYTES_PER_READ-byte sized sectors from the word
+aligned "buffer" to the card, starting at "sector".
+return true if it was successful, false if it failed for any reason
+-----------------------------------------------------------------*/
+static bool cardWriteSectors (u32 sector, u32 numSectors, void* buffer) {
+	return false;
+}
+
 /*-----------------------------------------------------------------
 startUp
 Initialize the interface, geting it into an idle, ready state
 returns true if successful, otherwise returns false
 -----------------------------------------------------------------*/
 bool startup(void) {
+	dldiCache_init(cardReadSectors, cardWriteSectors);
 	return false;
 }
 
@@ -67,19 +94,21 @@ Reset the card, clearing any status errors
 return true if the card is idle and ready
 -----------------------------------------------------------------*/
 bool clearStatus (void) {
+	dldiCache_invalidate();   // The card may have been changed
 	return false;
 }
 
-
 /*-----------------------------------------------------------------
 readSectors
 Read "numSectors" 512-byte sized sectors from the card into "buffer", 
 starting at "sector". 
 The buffer may be unaligned, and the driver must deal with this correctly.
+Sectors come from the cache when present; misses are read with the
+following sectors of a sequential read in one transfer.
 return true if it was successful, false if it failed for any reason
 -----------------------------------------------------------------*/
 bool readSectors (u32 sector, u32 numSectors, void* buffer) {
-	return false;
+	return dldiCache_read(sector, numSectors, buffer);
 }
 
 
@@ -89,10 +118,11 @@ writeSectors
 Write "numSectors" 512-byte sized sectors from "buffer" to the card, 
 starting at "sector".
 The buffer may be unaligned, and the driver must deal with this correctly.
+Writes go through to the card and update the cached copies.
 return true if it was successful, false if it failed for any reason
 -----------------------------------------------------------------*/
 bool writeSectors (u32 sector, u32 numSectors, void* buffer) {
-	return false;
+	return dldiCache_write(sector, numSectors, buffer);
 }
 
 /*-----------------------------------------------------------------
@@ -103,5 +133,6 @@ it is merely for disabling the card.
 return true if the card is no longer active
 -----------------------------------------------------------------*/
 bool shutdown(void) {
+	dldiCache_invalidate();
 	return false;
 }
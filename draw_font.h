@@ -1,9 +1,20 @@
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-int drawFont(int x, int y, u16* buffer, u16 code, u16 color);
-
-#ifdef __cplusplus
-}
-#endif
+#include <nds/ndstypes.h>
+
+#ifndef SCREEN_WIDTH
+#define SCREEN_WIDTH 256
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int drawFont(int x, int y, u16* buffer, u16 code, u16 color);
+
+// drawFont() の戻り値(文字幅)を描画せずに求める
+static inline int fontWidth(u16 code) {
+	return code < 0x100 ? 8 : 11;
+}
+
+#ifdef __cplusplus
+}
+#endif
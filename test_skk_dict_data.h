@@ -1,14 +1,21 @@
-// Generated from test_skk_dict.txt by skk_dict_converter.py
-// Total entries: 5
-// Data size: 112 bytes
+// Generated from test_skk_dict.txt by skk_dict_compiler
+// Total entries: 6
+// Data size: 209 bytes
 
 const unsigned char embedded_skk_dict[] = {
-    0x05,0x00,0x00,0x00,0x0c,0x00,0x00,0x00,0x20,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-    0x16,0x00,0x00,0x00,0x22,0x00,0x00,0x00,0x38,0x00,0x00,0x00,0x42,0x00,0x00,0x00,
+    0x06,0x00,0x00,0x00,0x58,0x00,0x00,0x00,0x70,0x00,0x00,0x00,0x01,0x00,0x00,0x00,
+    0x20,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x40,0x00,0x00,0x00,0x20,0x00,0x00,0x00,
+    0x02,0x00,0x00,0x00,0x40,0x00,0x00,0x00,0x07,0x00,0x00,0x00,0x27,0x85,0x0d,0x4f,
+    0xc1,0x55,0xa0,0x2f,0x20,0x00,0x00,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+    0x01,0x00,0x00,0x00,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x05,0x00,0x00,0x00,
+    0x6b,0x61,0x6e,0x6a,0x69,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x16,0x00,0x00,0x00,
+    0x27,0x00,0x00,0x00,0x33,0x00,0x00,0x00,0x49,0x00,0x00,0x00,0x53,0x00,0x00,0x00,
     0x82,0xa0,0x82,0xe8,0x82,0xaa,0x82,0xc6,0x82,0xa4,0x2c,0x82,0xa0,0x82,0xe8,0x82,
-    0xaa,0x82,0xc6,0x82,0xa4,0x00,0x82,0xab,0x82,0xe5,0x82,0xa4,0x2c,0x8d,0xa1,0x93,
-    0xfa,0x00,0x82,0xb1,0x82,0xf1,0x82,0xc9,0x82,0xbf,0x82,0xcd,0x2c,0x82,0xb1,0x82,
-    0xf1,0x82,0xc9,0x82,0xbf,0x82,0xcd,0x00,0x82,0xed,0x82,0xbd,0x82,0xb5,0x2c,0x8e,
-    0x84,0x00,0x83,0x65,0x83,0x58,0x83,0x67,0x2c,0x83,0x65,0x83,0x58,0x83,0x67,0x00,
+    0xaa,0x82,0xc6,0x82,0xa4,0x00,0x82,0xa9,0x82,0xf1,0x82,0xb6,0x2c,0x8a,0xbf,0x8e,
+    0x9a,0x2c,0x8a,0xb4,0x82,0xb6,0x00,0x82,0xab,0x82,0xe5,0x82,0xa4,0x2c,0x8d,0xa1,
+    0x93,0xfa,0x00,0x82,0xb1,0x82,0xf1,0x82,0xc9,0x82,0xbf,0x82,0xcd,0x2c,0x82,0xb1,
+    0x82,0xf1,0x82,0xc9,0x82,0xbf,0x82,0xcd,0x00,0x82,0xed,0x82,0xbd,0x82,0xb5,0x2c,
+    0x8e,0x84,0x00,0x83,0x65,0x83,0x58,0x83,0x67,0x2c,0x83,0x65,0x83,0x58,0x83,0x67,
+    0x00,
 
 };
@@ -0,0 +1,308 @@
+//
+// DLDI セクタキャッシュのベンチマーク (ホスト用)
+//  ファイル上のディスクイメージをカードの代わりにし(物理転送の回数とセクタ数を数える)、
+//  dldi/source/dldi_cache.c を通して次の読み込みを行う。
+//   - 辞書のページイン: ディスク上の辞書イメージを、RAM 上の標本インデックス(SKK と同じく
+//     最大512件)で絞った範囲だけ二分探索する。入力中と同じく読みの先頭から1文字ずつ
+//     伸ばしながら検索し、見つかった項目は候補リストまで読む。
+//   - 順次読み込み: 辞書イメージ全体を1セクタずつ読む(ファイルの読み込み)
+//  キャッシュなし・先読みなし・先読みありで物理転送の回数を比べる。読んだデータと検索結果は
+//  メモリ上の辞書イメージ(SKK::find_index())と照合し、最後に境界のずれたバッファの書き込みを
+//  読み戻して確かめる。
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "dict_builder.h"
+#include "skk.h"
+#include "dldi_cache.h"
+
+#define DICT_ENTRIES  100000
+#define DICT_SECTOR   2048      // 辞書イメージの先頭セクタ(FAT 等の後ろ)
+#define TYPED_WORDS   2000
+#define SECTOR        DLDI_CACHE_SECTOR_SIZE
+
+static double now_sec() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t g_seed = 2463534242u;
+static uint32_t rnd() {
+	g_seed ^= g_seed << 13;
+	g_seed ^= g_seed >> 17;
+	g_seed ^= g_seed << 5;
+	return g_seed;
+}
+
+static std::string random_yomi(int min_chars, int max_chars) {
+	std::string s;
+	int n = min_chars + rnd() % (max_chars - min_chars + 1);
+	for (int i = 0; i < n; i++) {
+		s += (char)0x82;
+		s += (char)(0x9f + rnd() % (0xf1 - 0x9f + 1));
+	}
+	return s;
+}
+
+// ファイル上のディスクイメージ(カード)
+static int      g_disk = -1;
+static uint32_t g_card_reads, g_card_sectors;
+
+static bool disk_read(uint32_t sector, uint32_t n, void* buffer) {
+	g_card_reads++;
+	g_card_sectors += n;
+	return pread(g_disk, buffer, n * SECTOR, (off_t)sector * SECTOR) == (ssize_t)(n * SECTOR);
+}
+
+static bool disk_write(uint32_t sector, uint32_t n, void* buffer) {
+	return pwrite(g_disk, buffer, n * SECTOR, (off_t)sector * SECTOR) == (ssize_t)(n * SECTOR);
+}
+
+// セクタの読み込み(キャッシュを通すかどうか)
+static bool g_use_cache;
+static bool read_sectors(uint32_t sector, uint32_t n, void* buffer) {
+	return g_use_cache ? dldiCache_read(sector, n, buffer) : disk_read(sector, n, buffer);
+}
+
+// 辞書イメージ内の位置からの読み込み(libfat と同じく1セクタずつ、境界のずれたバッファへ)
+static void read_bytes(uint32_t offset, uint32_t len, void* dst) {
+	static uint8_t buf[SECTOR + 1];
+	uint8_t* out = (uint8_t*)dst;
+	while (len > 0) {
+		uint32_t in_sector = offset % SECTOR;
+		uint32_t n = std::min(len, SECTOR - in_sector);
+		if (!read_sectors(DICT_SECTOR + offset / SECTOR, 1, buf + 1)) {
+			printf("read error at %u\n", offset);
+			exit(1);
+		}
+		memcpy(out, buf + 1 + in_sector, n);
+		out += n;
+		offset += n;
+		len -= n;
+	}
+}
+
+static uint32_t read_u32(uint32_t offset) {
+	uint32_t v;
+	read_bytes(offset, 4, &v);
+	return v;
+}
+
+// ディスク上の辞書: ヘッダーと標本インデックスは RAM、インデックスとデータはページイン
+struct DiskDict {
+	uint32_t entries, index_top, data_top, size;
+	uint32_t stride;
+	std::vector<std::string> samples;
+
+	void open(const std::vector<DictEntry>& sorted, uint32_t image_size) {
+		entries = read_u32(0);
+		index_top = read_u32(4);
+		data_top = read_u32(8);
+		size = image_size;
+		for (stride = SKK_SAMPLE_STRIDE; (entries + stride - 1) / stride > SKK_SAMPLE_MAX; stride *= 2)
+			;
+		for (uint32_t i = 0; i < entries; i += stride)
+			samples.push_back(sorted[i].key.substr(0, 8));
+	}
+
+	// i 番目の項目のキー(',' まで)
+	std::string key(uint32_t i) {
+		uint32_t pos = data_top + read_u32(index_top + i * 4);
+		std::string k;
+		char c[16];
+		for (;;) {
+			uint32_t n = std::min<uint32_t>(sizeof(c), size - pos);
+			read_bytes(pos, n, c);
+			char* comma = (char*)memchr(c, ',', n);
+			if (comma != NULL) {
+				k.append(c, comma - c);
+				return k;
+			}
+			k.append(c, n);
+			pos += n;
+		}
+	}
+
+	// 項目全体(候補リストまで)
+	std::string entry(uint32_t i) {
+		uint32_t pos = read_u32(index_top + i * 4);
+		uint32_t end = i + 1 < entries ? read_u32(index_top + (i + 1) * 4) : size - data_top;
+		std::string e(end - pos, '\0');
+		read_bytes(data_top + pos, end - pos, &e[0]);
+		return e;
+	}
+
+	int32_t find(const std::string& k) {
+		// 標本で範囲を絞る(先頭8バイトの比較なので同じ標本の前後も含める)
+		std::string head = k.substr(0, 8);
+		uint32_t s = std::upper_bound(samples.begin(), samples.end(), head) - samples.begin();
+		uint32_t lo = s >= 2 ? (s - 2) * stride : 0;
+		uint32_t hi = std::min(entries, (s + 1) * stride);
+		while (lo < hi) {
+			uint32_t mid = (lo + hi) / 2;
+			std::string m = key(mid);
+			if (m < k)
+				lo = mid + 1;
+			else if (k < m)
+				hi = mid;
+			else
+				return (int32_t)mid;
+		}
+		return -1;
+	}
+};
+
+static volatile uint32_t g_sink;
+
+// 入力中の検索: 読みの先頭から1文字ずつ伸ばして検索する
+static void run_lookups(DiskDict& dict, SKK& skk, const std::vector<std::string>& words) {
+	for (const std::string& w : words) {
+		for (size_t len = 2; len <= w.size(); len += 2) {
+			std::string k = w.substr(0, len);
+			int32_t found = dict.find(k);
+			if (found != skk.find_index(k.data(), k.size())) {
+				printf("lookup mismatch\n");
+				exit(1);
+			}
+			if (found >= 0)
+				g_sink += dict.entry(found).size();
+		}
+	}
+}
+
+static uint32_t run_scan(uint32_t sectors, const std::vector<unsigned char>& image) {
+	static uint8_t buf[SECTOR + 1];
+	uint32_t h = 0;
+	for (uint32_t s = 0; s < sectors; s++) {
+		if (!read_sectors(DICT_SECTOR + s, 1, buf + 1) ||
+		    memcmp(buf + 1, &image[s * SECTOR], std::min<size_t>(SECTOR, image.size() - s * SECTOR)) != 0) {
+			printf("scan mismatch at sector %u\n", s);
+			exit(1);
+		}
+		h = h * 31 + buf[1];
+	}
+	return h;
+}
+
+enum Mode { NO_CACHE, NO_READAHEAD, READAHEAD };
+static const char* const s_mode_names[] = { "no cache", "cache", "cache+readahead" };
+
+static void set_mode(Mode mode) {
+	g_use_cache = mode != NO_CACHE;
+	dldiCache_init(disk_read, disk_write);
+	dldiCache_setReadAhead(mode == READAHEAD ? DLDI_CACHE_READAHEAD : 0);
+	g_card_reads = g_card_sectors = 0;
+}
+
+static void report(const char* name, Mode mode, uint32_t sectors_asked, double sec) {
+	DldiCacheStats st;
+	dldiCache_getStats(&st);
+	printf("%-10s %-16s %9u %9u %9u %7.1f%% %9.1f\n", name, s_mode_names[mode], sectors_asked,
+	       g_card_reads, g_card_sectors,
+	       mode == NO_CACHE ? 0.0 : 100.0 * st.hits / std::max<uint32_t>(st.sectorsRequested, 1), sec * 1e3);
+}
+
+// 境界のずれたバッファと揃ったバッファの書き込みを読み戻して確かめる
+static bool check_writes() {
+	std::vector<uint8_t> data(40 * SECTOR + 3), back(40 * SECTOR + 1);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (uint8_t)rnd();
+	set_mode(READAHEAD);
+	if (!read_sectors(100, 20, &back[1]))                  // 一部をキャッシュに載せておく
+		return false;
+	if (!dldiCache_write(95, 13, &data[1]) ||              // 境界のずれたバッファ
+	    !dldiCache_write(110, 11, &data[0]))               // 揃ったバッファ(キャッシュ上の写しを更新)
+		return false;
+	std::vector<uint8_t> expect(26 * SECTOR);
+	memcpy(&expect[0], &data[1], 13 * SECTOR);               // セクタ 95～107
+	if (!disk_read(108, 2, &expect[13 * SECTOR]))            // セクタ 108,109 は元のまま
+		return false;
+	memcpy(&expect[15 * SECTOR], &data[0], 11 * SECTOR);     // セクタ 110～120
+	for (int pass = 0; pass < 2; pass++) {                   // キャッシュ経由とカードから直接
+		bool ok = pass == 0 ? dldiCache_read(95, 26, &back[1]) : disk_read(95, 26, &back[0]);
+		if (!ok || memcmp(&back[pass == 0 ? 1 : 0], &expect[0], 26 * SECTOR) != 0)
+			return false;
+	}
+	return true;
+}
+
+int main() {
+	std::vector<DictEntry> entries;
+	for (uint32_t i = 0; i < DICT_ENTRIES; i++) {
+		DictEntry e;
+		e.key = random_yomi(1, 6);
+		for (uint32_t c = 1 + rnd() % 4; c > 0; c--)
+			e.cands.push_back(random_yomi(1, 4));
+		entries.push_back(e);
+	}
+	dict_sort(entries);
+	std::vector<unsigned char> image = dict_build_image(entries);
+	SKK skk;
+	if (skk.begin(image.data(), image.size()) != entries.size()) {
+		printf("failed to load dictionary image\n");
+		return 1;
+	}
+
+	FILE* fp = tmpfile();
+	if (fp == NULL) {
+		perror("tmpfile");
+		return 1;
+	}
+	g_disk = fileno(fp);
+	uint32_t image_bytes = image.size();
+	uint32_t image_sectors = (image_bytes + SECTOR - 1) / SECTOR;
+	std::vector<unsigned char> padded(image);   // SKK は image を参照している
+	padded.resize(image_sectors * SECTOR);
+	if (!disk_write(DICT_SECTOR, image_sectors, padded.data())) {
+		perror("disk image");
+		return 1;
+	}
+
+	// 入力する語: 辞書の読みと未登録の読みを半分ずつ
+	std::vector<std::string> words;
+	for (uint32_t i = 0; i < TYPED_WORDS; i++)
+		words.push_back(i % 2 ? entries[rnd() % entries.size()].key : random_yomi(2, 6));
+
+	printf("dictionary: %zu entries, %u sectors; cache %u sectors, read-ahead %u\n", entries.size(),
+	       image_sectors, DLDI_CACHE_SECTORS, DLDI_CACHE_READAHEAD);
+	printf("%-10s %-16s %9s %9s %9s %8s %9s\n", "workload", "mode", "sectors", "transfers", "card sect",
+	       "hits", "ms");
+	for (int m = NO_CACHE; m <= READAHEAD; m++) {
+		set_mode((Mode)m);
+		DiskDict dict;
+		dict.open(entries, image_bytes);
+		double t0 = now_sec();
+		run_lookups(dict, skk, words);
+		DldiCacheStats st;
+		dldiCache_getStats(&st);
+		report("lookup", (Mode)m, m == NO_CACHE ? g_card_sectors : st.sectorsRequested, now_sec() - t0);
+	}
+	uint32_t scan_hash = 0;
+	for (int m = NO_CACHE; m <= READAHEAD; m++) {
+		set_mode((Mode)m);
+		double t0 = now_sec();
+		uint32_t h = run_scan(image_sectors, padded);
+		if (m != NO_CACHE && h != scan_hash) {
+			printf("scan mismatch\n");
+			return 1;
+		}
+		scan_hash = h;
+		report("scan", (Mode)m, image_sectors, now_sec() - t0);
+	}
+	if (!check_writes()) {
+		printf("write check failed\n");
+		return 1;
+	}
+	printf("writes:    unaligned / aligned writes read back correctly\n");
+	fclose(fp);
+	return 0;
+}
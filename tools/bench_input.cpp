@@ -0,0 +1,127 @@
+//
+// 入力キューベンチマーク (ホスト用)
+//  1万打鍵のローマ字入力を Linux 用のプラットフォーム(platform_linux.h)で ImeApp に与え、
+//  1フレーム1打鍵(従来方式)、1フレームでキューを満たす貼り付け、ImeApp::inject() による
+//  一括入力の処理時間と描画回数を比較する。最終状態のチェックサムは全方式で一致すること。
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <string>
+
+#include "ime_app.h"
+#include "platform_linux.h"
+#include "profiler.h"
+#include "skk.h"
+
+#define KEYSTROKES 10000
+
+static double now_sec() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 文字列を1フレームに per_frame 打鍵ずつ入力する
+class TextInput : public PlatformInput {
+ public:
+	TextInput(const std::string& text, uint32_t per_frame) : m_text(text), m_pos(0), m_per_frame(per_frame) {}
+	bool poll(ImeInput* in) {
+		if (m_pos >= m_text.size())
+			return false;
+		memset(in, 0, sizeof(*in));
+		in->key = (uint8_t)m_text[m_pos++];
+		return true;
+	}
+	bool fill(ImeInputQueue* queue) {
+		if (m_pos >= m_text.size())
+			return false;
+		for (uint32_t i = 0; i < m_per_frame && m_pos < m_text.size() && !queue->full(); i++)
+			queue->push_key((uint8_t)m_text[m_pos++]);
+		return true;
+	}
+ private:
+	std::string m_text;
+	size_t      m_pos;
+	uint32_t    m_per_frame;
+};
+
+struct Result {
+	double   sec;
+	uint32_t frames;
+	uint32_t renders;
+	uint32_t checksum;
+};
+
+static ImeApp s_app;   // 入力トレースの記録用バッファを含むので静的に置く
+
+// per_frame == 0: inject() で一括入力する
+static Result run(SKK& skk, const std::string& text, uint32_t per_frame) {
+	TextInput input(text, per_frame);
+	MemoryFramebuffer fb;
+	PosixClock clock;
+	FileStorage storage;
+	Platform platform = { &input, &fb, &clock, &storage };
+	Result r = {};
+
+	prof_init();
+	skk.clear_cache();
+	s_app.init(platform, &skk, NULL, false);
+	double t0 = now_sec();
+	if (per_frame == 0) {
+		s_app.inject(text.c_str());
+		r.frames = 1;
+	} else {
+		while (s_app.frame())
+			r.frames++;
+	}
+	r.sec = now_sec() - t0;
+	r.renders = fb.frames();
+	r.checksum = s_app.core().checksum();
+	return r;
+}
+
+int main() {
+	// 変換候補のある読みとない読み、送り仮名、訂正を混ぜた文
+	static const char* const phrases[] = {
+		"watashiha\n", "kanji \n", "nihongo\n", "kyouha ", "tenkiga\n", "yoi\n",
+		"kakikukeko\b\b\n", "sushi  \n", "NDS-SKK\n",
+	};
+	std::string text;
+	for (int i = 0; text.size() < KEYSTROKES; i++)
+		text += phrases[i % (sizeof(phrases) / sizeof(phrases[0]))];
+	text.resize(KEYSTROKES);
+
+	SKK skk;
+	if (skk.begin((const char*)NULL) == 0) {
+		printf("failed to load dictionary\n");
+		return 1;
+	}
+
+	struct { const char* name; uint32_t per_frame; } modes[] = {
+		{ "1 key / frame", 1 },
+		{ "paste (queue)", IME_QUEUE_SIZE },
+		{ "inject()",      0 },
+	};
+	printf("%u keystrokes\n", (unsigned)text.size());
+	printf("%-16s %8s %8s %10s %10s %9s\n", "mode", "frames", "renders", "ms", "keys/s", "checksum");
+	Result base = {};
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		Result r = run(skk, text, modes[m].per_frame);
+		printf("%-16s %8u %8u %10.2f %10.0f  %08x\n", modes[m].name, r.frames, r.renders,
+		       r.sec * 1e3, text.size() / r.sec, r.checksum);
+		if (m == 0) {
+			base = r;
+		} else if (r.checksum != base.checksum) {
+			printf("checksum mismatch\n");
+			return 1;
+		}
+	}
+	if (s_app.dropped_inputs() != 0) {
+		printf("dropped %u inputs\n", s_app.dropped_inputs());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,370 @@
+//
+// 文書のジャーナルのベンチマーク (ホスト用)
+//  メモリ上のファイルで FAT ファイルシステムの書き込みを模し(libfat と同じく、同期までに
+//  書いたデータセクタは1回ずつ、同期の度にディレクトリエントリを1セクタ、クラスタを割り当てる
+//  と FAT のセクタを2つのコピー分書くものとして数える)、確定1000回の間に書かれるセクタ数を
+//  ジャーナルなし(チャンクを直接書く)とジャーナルありで比べる。確定は主に文末への追加で、
+//  一部はカーソルを動かしての挿入と削除。確定の度に入力が途切れて自動保存が済むものとする。
+//  最後に、ジャーナルありの編集中の任意の書き込みで電源が切れた(書き込み中のものは途中の
+//  セクタまで書かれる)ことにして開き直し、最後に同期した確定文字列が戻ることを確かめる。
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ime_document.h"
+#include "ime_glyph.h"
+
+#define SECTOR           512
+#define CLUSTER_SECTORS  64       // 32 KB クラスタ(SDHC の FAT32 の既定値)
+#define FAT_ENTRIES      (SECTOR / 4)
+#define COMMITS          1000
+#define DOC_GLYPHS       4000     // 始めの文書の長さ
+#define CUT_RUNS         200
+
+static uint32_t g_seed = 2463534242u;
+static uint32_t rnd() {
+	g_seed ^= g_seed << 13;
+	g_seed ^= g_seed >> 17;
+	g_seed ^= g_seed << 5;
+	return g_seed;
+}
+
+class BenchClock : public PlatformClock {
+ public:
+	uint32_t now_us() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint32_t)(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+	}
+};
+
+// FAT の書き込みセクタ数を数えるメモリ上のファイル。ops_left 回目の書き込み操作で電源が切れる
+class FatModelStorage : public PlatformStorage {
+ public:
+	std::map<std::string, std::vector<uint8_t> > files;
+	uint64_t sector_writes = 0;
+	uint32_t write_calls = 0;
+	uint32_t ops = 0;             // 書き込み操作の数
+	int64_t  ops_left = -1;       // 負なら切れない
+	bool     dead = false;
+
+	bool write_file(const char* path, const void* data, uint32_t len) {
+		int32_t f = open_file(path);
+		bool ok = f >= 0 && truncate(f, 0) && write_at(f, 0, data, len);
+		return close_file(f) && ok;
+	}
+	int32_t read_file(const char* path, void* buf, uint32_t cap) {
+		std::map<std::string, std::vector<uint8_t> >::iterator it = files.find(path);
+		if (it == files.end())
+			return -1;
+		uint32_t n = std::min<uint32_t>(cap, it->second.size());
+		memcpy(buf, it->second.data(), n);
+		return n;
+	}
+	void log(const char* msg) { fprintf(stderr, "%s\n", msg); }
+	int32_t open_file(const char* path) {
+		if (dead)
+			return -1;
+		int32_t f = 0;
+		while (f < PLATFORM_MAX_FILES && m_handles[f].open)
+			f++;
+		if (f == PLATFORM_MAX_FILES)
+			return -1;
+		if (files.find(path) == files.end()) {
+			if (!op())
+				return -1;
+			files[path];
+			sector_writes++;      // ディレクトリエントリ
+		}
+		m_handles[f] = Handle();
+		m_handles[f].open = true;
+		m_handles[f].path = path;
+		return f;
+	}
+	int32_t read_at(int32_t file, uint32_t offset, void* buf, uint32_t len) {
+		std::vector<uint8_t>& d = files[m_handles[file].path];
+		if (offset >= d.size())
+			return 0;
+		uint32_t n = std::min<uint32_t>(len, d.size() - offset);
+		memcpy(buf, d.data() + offset, n);
+		return n;
+	}
+	bool write_at(int32_t file, uint32_t offset, const void* data, uint32_t len) {
+		if (dead || len == 0)
+			return !dead;
+		write_calls++;
+		ops++;
+		if (ops_left == 0) {      // 先頭から途中のセクタまで書いて切れる
+			uint32_t first = offset / SECTOR, last = (offset + len - 1) / SECTOR;
+			uint32_t k = rnd() % (last - first + 1);
+			uint32_t n = std::min(len, (first + k) * SECTOR - std::min(offset, (first + k) * SECTOR));
+			put(file, offset, data, n);
+			dead = true;
+			return false;
+		}
+		if (ops_left > 0)
+			ops_left--;
+		put(file, offset, data, len);
+		return true;
+	}
+	bool truncate(int32_t file, uint32_t len) {
+		if (!op())
+			return false;
+		Handle& h = m_handles[file];
+		std::vector<uint8_t>& d = files[h.path];
+		if (clusters(len) < clusters(d.size()))
+			m_fat_dirty.insert(m_next_cluster / FAT_ENTRIES);   // 解放したクラスタ
+		if (len != d.size())
+			h.modified = true;
+		d.resize(len);
+		return true;
+	}
+	bool sync(int32_t file) {
+		if (!op())
+			return false;
+		flush(m_handles[file]);
+		return true;
+	}
+	bool close_file(int32_t file) {
+		if (file < 0)
+			return false;
+		Handle& h = m_handles[file];
+		h.open = false;
+		if (dead)
+			return false;
+		flush(h);
+		return true;
+	}
+	bool rename_file(const char* from, const char* to) {
+		if (!op() || files.find(from) == files.end() || files.find(to) != files.end())
+			return false;
+		files[to].swap(files[from]);
+		files.erase(from);
+		sector_writes++;
+		return true;
+	}
+	bool remove_file(const char* path) {
+		if (!op() || files.find(path) == files.end())
+			return false;
+		if (!files[path].empty())
+			sector_writes += 2;   // FAT のクラスタの解放
+		files.erase(path);
+		sector_writes++;
+		return true;
+	}
+
+ private:
+	struct Handle {
+		bool open = false;
+		bool modified = false;
+		std::string path;
+		std::set<uint32_t> dirty;
+	};
+	Handle   m_handles[PLATFORM_MAX_FILES];
+	std::set<uint32_t> m_fat_dirty;
+	uint32_t m_next_cluster = 2;
+
+	static uint32_t clusters(uint32_t bytes) {
+		return (bytes + CLUSTER_SECTORS * SECTOR - 1) / (CLUSTER_SECTORS * SECTOR);
+	}
+	bool op() {
+		if (dead)
+			return false;
+		ops++;
+		if (ops_left == 0) {
+			dead = true;
+			return false;
+		}
+		if (ops_left > 0)
+			ops_left--;
+		return true;
+	}
+	void put(int32_t file, uint32_t offset, const void* data, uint32_t len) {
+		if (len == 0)
+			return;
+		Handle& h = m_handles[file];
+		std::vector<uint8_t>& d = files[h.path];
+		if (offset + len > d.size()) {
+			for (uint32_t c = clusters(d.size()); c < clusters(offset + len); c++)
+				m_fat_dirty.insert(m_next_cluster++ / FAT_ENTRIES);
+			d.resize(offset + len);
+		}
+		memcpy(d.data() + offset, data, len);
+		for (uint32_t s = offset / SECTOR; s <= (offset + len - 1) / SECTOR; s++)
+			h.dirty.insert(s);
+		h.modified = true;
+	}
+	// libfat の同期: 書いたデータセクタ、ディレクトリエントリ、FAT(2つのコピー)
+	void flush(Handle& h) {
+		sector_writes += h.dirty.size() + (h.modified ? 1 : 0) + 2 * m_fat_dirty.size();
+		h.dirty.clear();
+		h.modified = false;
+		m_fat_dirty.clear();
+	}
+};
+
+static std::vector<uint16_t> random_glyphs(uint32_t n) {
+	std::vector<uint16_t> g(n);
+	for (uint32_t i = 0; i < n; i++)
+		g[i] = rnd() % 40 == 0 ? '\n' : (uint16_t)(0x829F + rnd() % (0x82F1 - 0x829F + 1));
+	return g;
+}
+
+static std::vector<char> to_sjis(const std::vector<uint16_t>& g) {
+	std::vector<char> s(g.size() * 2 + 1);
+	s.resize(imeGlyph_toSjis(s.data(), s.size(), g.data(), g.size()));
+	return s;
+}
+
+static std::vector<uint16_t> contents(const ImeText& text) {
+	std::vector<uint16_t> g(text.length());
+	text.copy(0, text.length(), g.data());
+	return g;
+}
+
+// 確定1回: 文末への追加が主で、一部はカーソルを動かしての挿入と削除
+static void commit(ImeText& text) {
+	uint32_t r = rnd() % 10;
+	if (r == 0 && text.length() > 0)
+		text.set_cursor(rnd() % text.length());
+	else if (r == 1)
+		text.set_cursor(text.length());
+	if (r == 2) {
+		text.erase_before(1 + rnd() % 4);
+	} else {
+		std::vector<uint16_t> g = random_glyphs(2 + rnd() % 5);
+		text.insert(g.data(), g.size());
+	}
+}
+
+struct Session {
+	uint32_t  arena_mem[IME_ARENA_SIZE / 4];
+	ImeArena  arena;
+	ImeText   text;
+	ImeDocument doc;
+	BenchClock clock;
+
+	bool open(FatModelStorage* disk, bool journal) {
+		arena.init(arena_mem, sizeof(arena_mem));
+		text.init(&arena);
+		doc.init(disk, &clock);
+		return doc.open("doc.txt", &text, journal ? "doc.jnl" : NULL);
+	}
+	// 確定して自動保存を済ませる(失敗すれば false)
+	bool edit() {
+		ImeTextChange change;
+		commit(text);
+		if (text.take_change(&change))
+			doc.edited(change, text);
+		while (doc.needs_flush()) {
+			if (!doc.flush_step(text))
+				return false;
+		}
+		return true;
+	}
+};
+
+static bool matches(FatModelStorage& disk, const ImeText& text) {
+	std::vector<char> expected = to_sjis(contents(text));
+	const std::vector<uint8_t>& saved = disk.files["doc.txt"];
+	return saved.size() == expected.size() && memcmp(saved.data(), expected.data(), saved.size()) == 0;
+}
+
+static Session s_session;   // 大きいので静的に置く
+
+static bool measure(bool journal) {
+	FatModelStorage disk;
+	std::vector<char> initial = to_sjis(random_glyphs(DOC_GLYPHS));
+	disk.write_file("doc.txt", initial.data(), initial.size());
+
+	g_seed = 12345;
+	Session& s = s_session;
+	if (!s.open(&disk, journal) || s.doc.journaled() != journal) {
+		printf("open failed\n");
+		return false;
+	}
+	disk.sector_writes = 0;
+	disk.write_calls = 0;
+	for (int i = 0; i < COMMITS; i++) {
+		if (!s.edit()) {
+			printf("autosave failed\n");
+			return false;
+		}
+	}
+	uint64_t edits = disk.sector_writes;
+	uint32_t calls = disk.write_calls;
+	bool ok = s.doc.close(s.text) && matches(disk, s.text);
+	printf("%-10s %12llu %10.2f %12llu %8u %8u%s\n", journal ? "journal" : "direct", (unsigned long long)edits,
+	       (double)edits / COMMITS, (unsigned long long)disk.sector_writes, calls, s.doc.stats().saves,
+	       ok ? "" : "  (MISMATCH)");
+	return ok;
+}
+
+// 電源断: cut 回目の書き込み操作で切れたあと開き直し、最後に同期した内容か、書いていた確定の後の
+// 内容に戻ること
+static bool power_cut(int64_t cut, uint32_t* ops, uint32_t* replays) {
+	FatModelStorage disk;
+	std::vector<char> initial = to_sjis(random_glyphs(DOC_GLYPHS / 4));
+	disk.write_file("doc.txt", initial.data(), initial.size());
+
+	g_seed = 777;
+	Session& s = s_session;
+	std::vector<uint16_t> before, after;
+	if (!s.open(&disk, true))
+		return false;
+	after = contents(s.text);
+	disk.ops = 0;
+	disk.ops_left = cut;
+	for (int i = 0; i < COMMITS; i++) {
+		before = after;
+		bool ok = s.edit();
+		after = contents(s.text);
+		if (!ok)
+			break;
+	}
+	*ops = disk.ops;
+	if (!disk.dead)
+		return s.doc.close(s.text) && matches(disk, s.text);
+
+	disk.dead = false;           // 電源を入れ直す
+	disk.ops_left = -1;
+	if (!s.open(&disk, true))
+		return false;
+	std::vector<uint16_t> got = contents(s.text);
+	*replays += s.doc.journal_stats().replayed > 0;
+	s.doc.close(s.text);
+	return (got == before || got == after) && matches(disk, s.text);
+}
+
+int main() {
+	printf("%d commits on a %d-glyph document, autosaved after each; FAT model: %d-sector clusters\n",
+	       COMMITS, DOC_GLYPHS, CLUSTER_SECTORS);
+	printf("%-10s %12s %10s %12s %8s %8s\n", "mode", "sectors", "per commit", "with close", "writes",
+	       "saves");
+	if (!measure(false) || !measure(true))
+		return 1;
+
+	// 切らずに書き込み操作の数を数えてから、その中の任意の位置で切る
+	uint32_t total = 0, ops, replays = 0;
+	if (!power_cut(-1, &total, &replays)) {
+		printf("journal session failed\n");
+		return 1;
+	}
+	for (int run = 0; run < CUT_RUNS; run++) {
+		int64_t cut = (int64_t)run * total / CUT_RUNS + rnd() % (total / CUT_RUNS + 1);
+		if (!power_cut(cut, &ops, &replays)) {
+			printf("recovery failed (cut at operation %lld of %u)\n", (long long)cut, total);
+			return 1;
+		}
+	}
+	printf("recovery:  %d power cuts in %u write operations, all recovered (%u from the journal)\n",
+	       CUT_RUNS, total, replays);
+	return 0;
+}
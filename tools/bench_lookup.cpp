@@ -0,0 +1,402 @@
+//
+// 辞書検索ベンチマーク (ホスト用)
+//  合成した大規模辞書イメージに対して、同じ読みを繰り返し検索する入力に対する get_kouho_list() の
+//  検索結果キャッシュの効果(ヒット率・省略した比較回数・処理時間)と、
+//  辞書にないキーの検索に対する Bloomフィルタの効果(偽陽性率・処理時間)、
+//  標本インデックスの効果(1件あたりの辞書データ比較回数・処理時間)と、
+//  1文字の打ち間違いを含むローマ字の近似検索(SKK::find_fuzzy())の処理時間・辿った節の数も測る。
+//  入力トークンの解析は、以前の splitOkuri()・word2lower()・2回のかな変換と analyze_token() を
+//  キャッシュなしの検索全体で比べる。
+//
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "dict_builder.h"
+#include "skk.h"
+#include "JString.h"
+
+#define DICT_ENTRIES  100000
+#define MIN_SECONDS   0.3
+
+static double now_sec() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t g_seed = 2463534242u;
+static uint32_t rnd() {
+	g_seed ^= g_seed << 13;
+	g_seed ^= g_seed >> 17;
+	g_seed ^= g_seed << 5;
+	return g_seed;
+}
+
+// SJIS ひらがな(0x829F～0x82F1)のランダムな読み
+static std::string random_yomi(int min_chars, int max_chars) {
+	std::string s;
+	int n = min_chars + rnd() % (max_chars - min_chars + 1);
+	for (int i = 0; i < n; i++) {
+		s += (char)0x82;
+		s += (char)(0x9f + rnd() % (0xf1 - 0x9f + 1));
+	}
+	return s;
+}
+
+struct KeySet {
+	std::vector<std::string> keys;
+	std::vector<const char*> ptrs;
+	std::vector<uint16_t>    lens;
+
+	void finish() {
+		for (const std::string& k : keys) {
+			ptrs.push_back(k.data());
+			lens.push_back(k.size());
+		}
+	}
+};
+
+// 辞書の登録語と未登録語を混ぜたランダムなキー
+static KeySet random_keys(const std::vector<std::string>& yomi, uint32_t n, int miss_percent) {
+	KeySet ks;
+	for (uint32_t i = 0; i < n; i++) {
+		if ((int)(rnd() % 100) < miss_percent)
+			ks.keys.push_back(random_yomi(7, 8));           // 登録語より長いので必ず未登録
+		else
+			ks.keys.push_back(yomi[rnd() % yomi.size()]);
+	}
+	ks.finish();
+	return ks;
+}
+
+static volatile int32_t g_sink;
+
+// 入力中の検索: 少数の読みを繰り返し検索し、ときどき新しい読みが混ざる
+static void bench_cache(SKK& skk) {
+	static const char* const words[] = {
+		"kanji", "henkan", "nihongo", "Oku", "OkuR", "KaK", "watashi", "gakkou",
+		"kyou", "tenki", "SKK", "dictionary",
+	};
+	const uint32_t nwords = sizeof(words) / sizeof(words[0]);
+	std::vector<std::string> tokens;
+	for (uint32_t i = 0; i < 4096; i++) {
+		if (rnd() % 8 == 0) {
+			std::string t;
+			for (int j = 0, n = 3 + rnd() % 6; j < n; j++)
+				t += (char)('a' + rnd() % 26);
+			tokens.push_back(t);
+		} else {
+			tokens.push_back(words[rnd() % nwords]);
+		}
+	}
+
+	static char list[64 * 1024];
+	char okuri[128];
+	double t[2];
+	SKKCacheStats stats;
+	for (int enable = 0; enable < 2; enable++) {
+		skk.enable_cache(enable);
+		uint32_t iters = 0;
+		double t0 = now_sec();
+		do {
+			for (const std::string& tok : tokens)
+				g_sink = skk.get_kouho_list(list, okuri, tok.data(), tok.size());
+			iters++;
+		} while ((t[enable] = now_sec() - t0) < MIN_SECONDS);
+		t[enable] /= iters;
+		if (enable) {
+			skk.get_cache_stats(&stats);
+		}
+	}
+	printf("get_kouho_list cache: %zu tokens, hit ratio %.1f%%, probes %u, saved probes %u\n",
+	       tokens.size(), stats.hit_ratio / 10.0, stats.probes, stats.saved_probes);
+	printf("%-24s %6zu %10.1f %10.1f %7.2fx\n", "uncached / cached", tokens.size(),
+	       tokens.size() / t[0] / 1e6, tokens.size() / t[1] / 1e6, t[0] / t[1]);
+}
+
+// Bloomフィルタ: 大半が辞書にないキーの検索
+static void bench_bloom(const std::vector<DictEntry>& entries, const std::vector<std::string>& yomi) {
+	std::vector<unsigned char> plain = dict_build_image(entries);
+	std::vector<unsigned char> filtered = dict_build_image(entries, 0.01);
+	KeySet ks = random_keys(yomi, 4096, 90);
+	double t[2];
+	SKKCacheStats stats = {};
+
+	for (int f = 0; f < 2; f++) {
+		std::vector<unsigned char>& image = f ? filtered : plain;
+		SKK skk;
+		skk.begin(image.data(), image.size());
+		uint32_t iters = 0;
+		double t0 = now_sec();
+		do {
+			for (uint32_t i = 0; i < ks.keys.size(); i++)
+				g_sink = skk.find_index(ks.ptrs[i], ks.lens[i]);
+			iters++;
+		} while ((t[f] = now_sec() - t0) < MIN_SECONDS);
+		t[f] /= iters;
+
+		if (f) {
+			// 偽陽性率: 辞書にないキーのうちフィルタを通過した割合
+			uint32_t misses = 0;
+			SKKCacheStats before;
+			skk.get_cache_stats(&before);
+			for (uint32_t i = 0; i < 100000; i++) {
+				std::string k = random_yomi(7, 8);
+				misses += skk.find_index(k.data(), k.size()) < 0;
+			}
+			skk.get_cache_stats(&stats);
+			printf("bloom filter: %zu extra bytes, false positive rate %.2f%%\n",
+			       filtered.size() - plain.size(),
+			       100.0 * (misses - (stats.filtered - before.filtered)) / misses);
+		}
+	}
+	printf("%-24s %6zu %10.1f %10.1f %7.2fx\n", "90% miss: plain / bloom", ks.keys.size(),
+	       ks.keys.size() / t[0] / 1e6, ks.keys.size() / t[1] / 1e6, t[0] / t[1]);
+}
+
+// 標本インデックス: 1件ずつの検索の辞書データ比較回数と処理時間
+static void bench_sample(const std::vector<DictEntry>& entries, const std::vector<std::string>& yomi) {
+	std::vector<unsigned char> image = dict_build_image(entries);     // Bloomフィルタなし
+	SKK skk;
+	skk.begin(image.data(), image.size());
+
+	const int misses[] = { 0, 50 };
+	for (int miss : misses) {
+		KeySet ks = random_keys(yomi, 4096, miss);
+		uint32_t n = ks.keys.size();
+		double t[2], probes[2];
+		for (int enable = 0; enable < 2; enable++) {
+			skk.enable_sample_index(enable);
+			uint32_t p0 = skk.get_probe_count();
+			for (uint32_t i = 0; i < n; i++)
+				g_sink = skk.find_index(ks.ptrs[i], ks.lens[i]);
+			probes[enable] = (double)(skk.get_probe_count() - p0) / n;
+
+			uint32_t iters = 0;
+			double t0 = now_sec();
+			do {
+				for (uint32_t i = 0; i < n; i++)
+					g_sink = skk.find_index(ks.ptrs[i], ks.lens[i]);
+				iters++;
+			} while ((t[enable] = now_sec() - t0) < MIN_SECONDS);
+			t[enable] = t[enable] / iters / n * 1e9;
+		}
+		printf("sample index, %2d%% miss:  probes/lookup %5.1f -> %5.1f, ns/lookup %6.1f -> %6.1f (%.2fx)\n",
+		       miss, probes[0], probes[1], t[0], t[1], t[0] / t[1]);
+	}
+}
+
+// 読み(Shift-JIS ひらがな)のローマ字綴り(拗音はまとめ、促音は次の子音を重ねる)。綴れない読みは空
+static std::string spell_yomi(const std::string& yomi) {
+	std::string out;
+	bool sokuon = false;
+	for (size_t i = 0; i + 1 < yomi.size(); i += 2) {
+		const char* sp[SKK_FUZZY_SPELLINGS];
+		if (yomi.compare(i, 2, "\x82\xc1") == 0 && !sokuon && i + 3 < yomi.size()) {
+			sokuon = true;
+			continue;
+		}
+		uint8_t n = 0;
+		if (i + 3 < yomi.size())
+			n = JString::sjis_spellings(yomi.data() + i, 4, sp, SKK_FUZZY_SPELLINGS);
+		if (n > 0)
+			i += 2;
+		else
+			n = JString::sjis_spellings(yomi.data() + i, 2, sp, SKK_FUZZY_SPELLINGS);
+		if (n == 0)
+			return std::string();
+		std::string r = sp[0];
+		if (sokuon && strchr("aiueon", r[0]) == NULL)
+			out += r[0];
+		out += r;
+		sokuon = false;
+	}
+	return out;
+}
+
+// 以前の入力トークンの解析(送りの分割・小文字化・キーワードと送りのかな変換を別々に行う)
+static void legacy_word2lower(char* token) {
+	uint16_t len = strlen(token);
+	for (uint16_t i = 0; i < len; i++) {
+		if (isupper((unsigned char)token[i]))
+			token[i] = tolower((unsigned char)token[i]);
+	}
+}
+
+static void legacy_split_okuri(char* keyword, char* okuri, const char* token) {
+	keyword[0] = '\0';
+	okuri[0] = '\0';
+	if (strlen(token) == 0)
+		return;
+	if (isupper((unsigned char)token[0])) {
+		for (uint16_t i = 1; i < strlen(token); i++) {
+			if (isupper((unsigned char)token[i])) {
+				strcpy(okuri, &token[i]);
+				strncpy(keyword, token, i);
+				keyword[i] = '\0';
+				break;
+			}
+		}
+		if (strlen(keyword) == 0) {
+			strcpy(keyword, token);
+			okuri[0] = '\0';
+		}
+	} else {
+		strcpy(keyword, token);
+	}
+	legacy_word2lower(keyword);
+	legacy_word2lower(okuri);
+}
+
+static int32_t legacy_lookup(SKK& skk, char* out_okuri, const char* token) {
+	char keyword[SKK_TOKEN_MAX];
+	char okuri[SKK_TOKEN_MAX];
+	char key[SKK_TOKEN_MAX * 3 + 2];
+	uint16_t key_len;
+	int32_t pos;
+
+	legacy_split_okuri(keyword, okuri, token);
+	JString::roma_to_sjis(key, keyword, strlen(keyword), &key_len);
+	out_okuri[0] = '\0';
+	if (strlen(okuri)) {
+		key[key_len++] = okuri[0];
+		key[key_len] = '\0';
+		pos = skk.find_index(key, key_len);
+		if (pos >= 0)
+			JString::roma_to_sjis(out_okuri, okuri, strlen(okuri));
+		return pos;
+	}
+	return skk.find_index(key, key_len);
+}
+
+// 入力トークンの解析: 登録語の綴り(半分は送りあり)を、キャッシュなしで検索する
+static void bench_token(SKK& skk, const std::vector<std::string>& yomi) {
+	static const char* const okuri[] = { "Ru", "Ku", "Ta", "Shi", "Tte" };
+	std::vector<std::string> tokens;
+	std::vector<std::string> keys;
+	while (tokens.size() < 4096) {
+		const std::string& y = yomi[rnd() % yomi.size()];
+		std::string r = spell_yomi(y);
+		if (r.empty() || r.size() + 4 >= SKK_TOKEN_MAX)
+			continue;
+		std::string k = y;
+		if (rnd() % 2) {
+			const char* o = okuri[rnd() % 5];
+			r[0] = toupper((unsigned char)r[0]);
+			r += o;
+			k += (char)tolower((unsigned char)o[0]);
+		}
+		tokens.push_back(r);
+		keys.push_back(k);
+	}
+
+	// 0: 以前の解析 1: analyze_token() 2: 解析済みのキーの検索だけ
+	char okuri_buf[SKK_TOKEN_MAX * 3 + 1];
+	uint32_t index;
+	double t[3];
+	skk.enable_cache(0);
+	for (int mode = 0; mode < 3; mode++) {
+		uint32_t iters = 0;
+		double t0 = now_sec();
+		do {
+			for (size_t i = 0; i < tokens.size(); i++) {
+				if (mode == 0)
+					g_sink = legacy_lookup(skk, okuri_buf, tokens[i].c_str());
+				else if (mode == 1)
+					g_sink = skk.get_kouho_list_index(&index, okuri_buf, tokens[i].data(), tokens[i].size());
+				else
+					g_sink = skk.find_index(keys[i].data(), keys[i].size());
+			}
+			iters++;
+		} while ((t[mode] = now_sec() - t0) < MIN_SECONDS);
+		t[mode] = t[mode] / iters / tokens.size() * 1e9;
+	}
+	skk.enable_cache(1);
+	printf("token analysis: ns/lookup %6.1f -> %6.1f (%.2fx), of which analysis %6.1f -> %6.1f (%.2fx)\n",
+	       t[0], t[1], t[0] / t[1], t[0] - t[2], t[1] - t[2], (t[0] - t[2]) / (t[1] - t[2]));
+}
+
+// 1文字の置換・挿入・削除・入れ替え
+static std::string typo(std::string s) {
+	uint32_t pos = rnd() % s.size();
+	char c = 'a' + rnd() % 26;
+	switch (rnd() % 4) {
+	case 0: s[pos] = c; break;
+	case 1: s.insert(s.begin() + pos, c); break;
+	case 2: if (s.size() > 1) s.erase(pos, 1); break;
+	default: if (pos + 1 < s.size()) std::swap(s[pos], s[pos + 1]); break;
+	}
+	return s;
+}
+
+// 近似検索: 登録語の綴りに1文字の打ち間違いを入れた入力
+static void bench_fuzzy(SKK& skk, const std::vector<std::string>& yomi) {
+	std::vector<std::string> input;
+	std::vector<int32_t> expect;
+	while (input.size() < 1000) {
+		uint32_t i = rnd() % yomi.size();
+		std::string r = spell_yomi(yomi[i]);
+		if (r.size() < 4 || r.size() >= SKK_TOKEN_MAX - 1)
+			continue;
+		input.push_back(typo(r));
+		expect.push_back(i);
+	}
+
+	int32_t index[64];
+	uint8_t dist[64];
+	uint64_t nodes = 0, results = 0;
+	uint32_t found = 0, max_nodes = 0;
+	double worst = 0, t0 = now_sec();
+	for (size_t q = 0; q < input.size(); q++) {
+		uint32_t n;
+		double t1 = now_sec();
+		uint16_t count = skk.find_fuzzy(input[q].data(), input[q].size(), 1, index, dist, 64, &n);
+		worst = std::max(worst, now_sec() - t1);
+		nodes += n;
+		max_nodes = std::max(max_nodes, n);
+		results += count;
+		found += std::find(index, index + count, expect[q]) != index + count;
+	}
+	double t = now_sec() - t0;
+	printf("fuzzy lookup (distance 1): %zu typos, %.1f%% found, %.1f readings/query, "
+	       "nodes avg %.0f max %u, ms/query avg %.3f max %.3f\n",
+	       input.size(), 100.0 * found / input.size(), (double)results / input.size(),
+	       (double)nodes / input.size(), max_nodes, t / input.size() * 1e3, worst * 1e3);
+}
+
+int main() {
+	std::vector<DictEntry> entries;
+	for (uint32_t i = 0; i < DICT_ENTRIES; i++) {
+		DictEntry e;
+		e.key = random_yomi(1, 6);
+		e.cands.push_back(e.key);
+		entries.push_back(e);
+	}
+	dict_sort(entries);
+	std::vector<std::string> yomi;
+	for (const DictEntry& e : entries)
+		yomi.push_back(e.key);
+
+	std::vector<unsigned char> image = dict_build_image(entries);
+	SKK skk;
+	if (skk.begin(image.data(), image.size()) != yomi.size()) {
+		printf("failed to load dictionary image\n");
+		return 1;
+	}
+	printf("dictionary: %zu entries, %zu bytes\n", yomi.size(), image.size());
+	printf("%-24s %6s %10s %10s %8s\n", "keys", "N", "before M/s", "after M/s", "speedup");
+
+	bench_cache(skk);
+	bench_bloom(entries, yomi);
+	bench_sample(entries, yomi);
+	bench_token(skk, yomi);
+	bench_fuzzy(skk, yomi);
+	return 0;
+}
@@ -0,0 +1,196 @@
+//
+// UTF8一括変換ベンチマーク (ホスト用)
+//  JString の一括変換カーネルと、1文字毎に get()/utf8to32()/utf32to8() を
+//  経由する従来方式の処理速度(MB/s)を比較する。
+//  SKK::kana_to_katakana / SKK::han_to_zen は旧実装(従来方式)との比較も行う。
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "JString.h"
+#include "skk.h"
+
+#define CHUNK_BYTES   16000      // 従来方式の uint16_t 長に収まる入力サイズ
+#define MIN_SECONDS   0.2
+
+static double now_sec() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//
+// 従来方式(1文字ずつデコード→変換→エンコード)
+//
+static uint32_t legacy_shift(char* dst, const char* src, uint32_t lo, uint32_t hi, int32_t delta) {
+	uint16_t len = JString::len(src);
+	char utf8char[5];
+	char* src_ptr = (char*)src;
+	char* dst_ptr = dst;
+	uint32_t rc = 0;
+	for (uint16_t i = 0; i < len; i++) {
+		src_ptr += JString::get(utf8char, src_ptr);
+		uint32_t code = JString::utf8to32(utf8char);
+		if (code >= lo && code <= hi) {
+			code += delta;
+			rc++;
+		}
+		dst_ptr += JString::utf32to8(dst_ptr, code);
+	}
+	return rc;
+}
+
+static uint32_t legacy_hira_to_kata(char* dst, const char* src) { return legacy_shift(dst, src, 0x3041, 0x3093, 96); }
+static uint32_t legacy_kata_to_hira(char* dst, const char* src) { return legacy_shift(dst, src, 0x30a1, 0x30f3, -96); }
+
+static void legacy_han_to_zen(char* dst, const char* src) {
+	uint16_t len = JString::len(src);
+	char utf8char[5];
+	char* src_ptr = (char*)src;
+	char* dst_ptr = dst;
+	for (uint16_t i = 0; i < len; i++) {
+		src_ptr += JString::get(utf8char, src_ptr);
+		uint32_t code = JString::utf8to32(utf8char);
+		if (code >= 0x21 && code <= 0x7e)
+			code += 65248;
+		else if (code == 0x20)
+			code = 0x3000;
+		dst_ptr += JString::utf32to8(dst_ptr, code);
+	}
+}
+
+static void legacy_zen_to_han(char* dst, const char* src) {
+	uint16_t len = JString::len(src);
+	char utf8char[5];
+	char* src_ptr = (char*)src;
+	char* dst_ptr = dst;
+	for (uint16_t i = 0; i < len; i++) {
+		src_ptr += JString::get(utf8char, src_ptr);
+		uint32_t code = JString::utf8to32(utf8char);
+		if (code >= 0xff01 && code <= 0xff5e)
+			code -= 65248;
+		else if (code == 0x3000)
+			code = 0x20;
+		dst_ptr += JString::utf32to8(dst_ptr, code);
+	}
+}
+
+//
+// 入力データの生成
+//
+static void fill_corpus(char* buf, uint32_t size, const char* const* words, int nwords) {
+	uint32_t pos = 0;
+	unsigned seed = 12345;
+	for (;;) {
+		seed = seed * 1103515245 + 12345;
+		const char* w = words[(seed >> 16) % nwords];
+		uint32_t n = strlen(w);
+		if (pos + n >= size)
+			break;
+		memcpy(buf + pos, w, n);
+		pos += n;
+	}
+	buf[pos] = '\0';
+}
+
+static const char* const JA_WORDS[] = {
+	"きょうは", "いい", "てんき", "ですね", "。", "わたしは", "がっこうへ", "いきます", "、",
+	"カタカナ", "テスト", "漢字", "変換", "の", "ぶんしょう", "を", "かきました", "ABC", " ",
+};
+static const char* const ASCII_WORDS[] = {
+	"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog. ", "SKK ", "2025 ",
+};
+static const char* const ZEN_WORDS[] = {
+	"ＡＢＣ", "ｄｅｆ", "　", "１２３", "！？", "漢字", "かな", "ｘｙｚ",
+};
+
+typedef void (*bench_fn)(char* dst, const char* src, uint32_t len);
+
+static double run(bench_fn fn, char* dst, const char* src, uint32_t len) {
+	uint32_t iters = 0;
+	double t0 = now_sec(), t;
+	do {
+		for (int i = 0; i < 16; i++)
+			fn(dst, src, len);
+		iters += 16;
+		t = now_sec() - t0;
+	} while (t < MIN_SECONDS);
+	return (double)len * iters / t / 1e6;
+}
+
+static volatile int32_t g_sink;
+
+static void b_legacy_h2k(char* d, const char* s, uint32_t)   { g_sink = legacy_hira_to_kata(d, s); }
+static void b_bulk_h2k(char* d, const char* s, uint32_t n)   { g_sink = JString::hira_to_kata(d, s, n); }
+static void b_legacy_k2h(char* d, const char* s, uint32_t)   { g_sink = legacy_kata_to_hira(d, s); }
+static void b_bulk_k2h(char* d, const char* s, uint32_t n)   { g_sink = JString::kata_to_hira(d, s, n); }
+static void b_legacy_h2z(char* d, const char* s, uint32_t)   { legacy_han_to_zen(d, s); }
+static void b_bulk_h2z(char* d, const char* s, uint32_t n)   { g_sink = JString::ascii_to_zen(d, s, n); }
+static void b_legacy_z2h(char* d, const char* s, uint32_t)   { legacy_zen_to_han(d, s); }
+static void b_bulk_z2h(char* d, const char* s, uint32_t n)   { g_sink = JString::zen_to_ascii(d, s, n); }
+static void b_legacy_len(char*, const char* s, uint32_t)     { g_sink = JString::len(s); }
+static void b_bulk_len(char*, const char* s, uint32_t n)     { g_sink = JString::count_chars(s, n); }
+
+// SKK の公開API(一括変換カーネルの薄いラッパー)
+static SKK g_skk;
+static void b_skk_h2k(char* d, const char* s, uint32_t n)    { g_sink = g_skk.kana_to_katakana(d, s, n); }
+static void b_skk_h2z(char* d, const char* s, uint32_t n)    { g_skk.han_to_zen(d, s, n); }
+
+struct BenchCase {
+	const char* name;
+	const char* corpus;
+	bench_fn    legacy;
+	bench_fn    bulk;
+};
+
+int main() {
+	static char ja[CHUNK_BYTES + 1], ascii[CHUNK_BYTES + 1], zen[CHUNK_BYTES + 1];
+	static char kata[CHUNK_BYTES + 1];
+	static char out_a[CHUNK_BYTES * 3 + 1], out_b[CHUNK_BYTES * 3 + 1];
+
+	fill_corpus(ja, CHUNK_BYTES, JA_WORDS, sizeof(JA_WORDS) / sizeof(JA_WORDS[0]));
+	fill_corpus(ascii, CHUNK_BYTES, ASCII_WORDS, sizeof(ASCII_WORDS) / sizeof(ASCII_WORDS[0]));
+	fill_corpus(zen, CHUNK_BYTES, ZEN_WORDS, sizeof(ZEN_WORDS) / sizeof(ZEN_WORDS[0]));
+	legacy_hira_to_kata(kata, ja);
+
+	const BenchCase cases[] = {
+		{ "hira_to_kata (ja)",    ja,    b_legacy_h2k, b_bulk_h2k },
+		{ "kata_to_hira (ja)",    kata,  b_legacy_k2h, b_bulk_k2h },
+		{ "ascii_to_zen (ascii)", ascii, b_legacy_h2z, b_bulk_h2z },
+		{ "ascii_to_zen (ja)",    ja,    b_legacy_h2z, b_bulk_h2z },
+		{ "zen_to_ascii (zen)",   zen,   b_legacy_z2h, b_bulk_z2h },
+		{ "count_chars (ja)",     ja,    b_legacy_len, b_bulk_len },
+		{ "count_chars (ascii)",  ascii, b_legacy_len, b_bulk_len },
+		{ "SKK::kana_to_katakana", ja,   b_legacy_h2k, b_skk_h2k },
+		{ "SKK::han_to_zen",      ascii, b_legacy_h2z, b_skk_h2z },
+	};
+
+	int failed = 0;
+	printf("%-22s %12s %12s %8s\n", "kernel", "legacy MB/s", "bulk MB/s", "speedup");
+	for (const BenchCase& c : cases) {
+		uint32_t len = strlen(c.corpus);
+
+		// 結果の一致確認
+		memset(out_a, 0, sizeof(out_a));
+		memset(out_b, 0, sizeof(out_b));
+		c.legacy(out_a, c.corpus, len);
+		int32_t legacy_val = g_sink;
+		c.bulk(out_b, c.corpus, len);
+		int32_t bulk_val = g_sink;
+		bool same = (c.legacy == b_legacy_len) ? (legacy_val == bulk_val) : (strcmp(out_a, out_b) == 0);
+		if (!same) {
+			printf("%-22s MISMATCH\n", c.name);
+			failed = 1;
+			continue;
+		}
+
+		double legacy_mbs = run(c.legacy, out_a, c.corpus, len);
+		double bulk_mbs = run(c.bulk, out_b, c.corpus, len);
+		printf("%-22s %12.1f %12.1f %7.1fx\n", c.name, legacy_mbs, bulk_mbs, bulk_mbs / legacy_mbs);
+	}
+
+	return failed;
+}
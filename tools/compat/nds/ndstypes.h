@@ -0,0 +1,20 @@
+//
+// ホストビルド用の libnds 型定義 (nds/ndstypes.h の必要な部分のみ)
+//  draw_font.c とフォントデータを devkitARM なしでコンパイルするために使う。
+//
+#ifndef HOST_COMPAT_NDSTYPES_H
+#define HOST_COMPAT_NDSTYPES_H
+#include <stdint.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+
+typedef uint8_t  uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+
+#endif
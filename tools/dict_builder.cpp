@@ -0,0 +1,270 @@
+//
+// SKK辞書イメージ生成 (ホスト用)
+//
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "dict_builder.h"
+#include "skk.h"
+
+static void put_u32(unsigned char* p, uint32_t x) {
+	p[0] = x & 0xff;
+	p[1] = (x >> 8) & 0xff;
+	p[2] = (x >> 16) & 0xff;
+	p[3] = (x >> 24) & 0xff;
+}
+
+// 符号なしバイト列として比較し、前方一致なら短い方を先にする(strcmp() と同じ順序)
+static bool key_less(const std::string& a, const std::string& b) {
+	size_t n = std::min(a.size(), b.size());
+	int rc = memcmp(a.data(), b.data(), n);
+	return rc < 0 || (rc == 0 && a.size() < b.size());
+}
+
+void dict_sort(std::vector<DictEntry>& entries) {
+	std::stable_sort(entries.begin(), entries.end(), [](const DictEntry& a, const DictEntry& b) {
+		return key_less(a.key, b.key);
+	});
+
+	// 同じ読みの項目をまとめる(候補の重複は除く)
+	size_t out = 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (out > 0 && entries[out-1].key == entries[i].key) {
+			DictEntry& dst = entries[out-1];
+			for (const std::string& c : entries[i].cands) {
+				if (std::find(dst.cands.begin(), dst.cands.end(), c) == dst.cands.end())
+					dst.cands.push_back(c);
+			}
+			continue;
+		}
+		if (out != i)
+			entries[out] = std::move(entries[i]);
+		out++;
+	}
+	entries.resize(out);
+}
+
+// キーの種類毎のBloomフィルタ部を作る
+//  ビット数 m = -n ln(p) / (ln 2)^2 を32の倍数に切り上げ、ハッシュ数 k = (m/n) ln 2 とする
+static std::vector<unsigned char> build_bloom(const std::vector<DictEntry>& entries, double fp_rate) {
+	std::vector<unsigned char> section(4);
+	put_u32(&section[0], SKK_BLOOM_CLASSES);
+
+	for (uint32_t c = 0; c < SKK_BLOOM_CLASSES; c++) {
+		uint32_t n = 0;
+		for (const DictEntry& e : entries)
+			n += SKK::key_class(e.key.data(), e.key.size()) == c;
+
+		double bits = n * -log(fp_rate) / (M_LN2 * M_LN2);
+		uint32_t m = std::min((double)SKK_BLOOM_MAX_BITS, std::max((double)SKK_BLOOM_MIN_BITS, ceil(bits / 32) * 32));
+		uint32_t nhash = n ? (uint32_t)lround((double)m / n * M_LN2) : 1;
+		nhash = std::max(1u, std::min(nhash, (uint32_t)SKK_BLOOM_MAX_HASH));
+
+		size_t head = section.size();
+		section.resize(head + 8 + m / 8);
+		put_u32(&section[head], m);
+		put_u32(&section[head + 4], nhash);
+		unsigned char* bitmap = &section[head + 8];
+		for (const DictEntry& e : entries) {
+			if (SKK::key_class(e.key.data(), e.key.size()) != c)
+				continue;
+			// SKK::may_contain() と同じビット位置
+			uint32_t h1 = SKK::key_hash(e.key.data(), e.key.size());
+			uint32_t h2 = SKK::bloom_step(h1);
+			for (uint32_t i = 0; i < nhash; i++) {
+				uint32_t bit = ((uint64_t)(h1 + i * h2) * m) >> 32;
+				bitmap[bit >> 3] |= 1 << (bit & 7);
+			}
+		}
+	}
+	return section;
+}
+
+uint8_t dict_score(uint64_t count) {
+	if (count == 0)
+		return 0;
+	return (uint8_t)std::min(255.0, 1 + floor(8 * log2((double)count)));
+}
+
+uint32_t dict_rank(std::vector<DictEntry>& entries, const std::unordered_map<std::string, uint64_t>& freq) {
+	uint32_t matched = 0;
+	std::vector<size_t> order;
+	std::vector<std::string> cands;
+	for (DictEntry& e : entries) {
+		e.scores.resize(e.cands.size());
+		for (size_t i = 0; i < e.cands.size(); i++) {
+			const std::string& c = e.cands[i];
+			std::unordered_map<std::string, uint64_t>::const_iterator it = freq.find(c.substr(0, c.find(';')));
+			e.scores[i] = it == freq.end() ? 0 : dict_score(it->second);
+			matched += it != freq.end();
+		}
+		order.resize(e.cands.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&e](size_t a, size_t b) {
+			return e.scores[a] > e.scores[b];
+		});
+		cands.clear();
+		std::vector<uint8_t> scores;
+		for (size_t i : order) {
+			cands.push_back(std::move(e.cands[i]));
+			scores.push_back(e.scores[i]);
+		}
+		e.cands.swap(cands);
+		e.scores.swap(scores);
+	}
+	return matched;
+}
+
+// 候補スコア部を作る(skk.h 参照)。スコアのある項目がなければ空
+static std::vector<unsigned char> build_scores(const std::vector<DictEntry>& entries) {
+	std::vector<unsigned char> section;
+	bool any = false;
+	for (const DictEntry& e : entries)
+		any = any || !e.scores.empty();
+	if (!any)
+		return section;
+
+	uint32_t n = entries.size();
+	uint32_t nblocks = (n + SKK_SCORE_BLOCK - 1) / SKK_SCORE_BLOCK;
+	section.resize(4 + nblocks * 4 + n);
+	put_u32(&section[0], n);
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		const DictEntry& e = entries[i];
+		uint32_t count = std::min<size_t>(e.cands.size(), 255);
+		if (i % SKK_SCORE_BLOCK == 0)
+			put_u32(&section[4 + i / SKK_SCORE_BLOCK * 4], total);
+		section[4 + nblocks * 4 + i] = count;
+		for (uint32_t j = 0; j < count; j++)
+			section.push_back(j < e.scores.size() ? e.scores[j] : 0);
+		total += count;
+	}
+	return section;
+}
+
+uint32_t dict_strip_annotations(std::vector<DictEntry>& entries) {
+	uint32_t count = 0;
+	for (DictEntry& e : entries) {
+		std::vector<std::string> cands, annots;
+		std::vector<uint8_t> scores;
+		for (size_t i = 0; i < e.cands.size(); i++) {
+			size_t semi = e.cands[i].find(';');
+			std::string cand = e.cands[i].substr(0, semi);
+			std::string annot = semi == std::string::npos ? std::string() : e.cands[i].substr(semi + 1);
+			size_t j = std::find(cands.begin(), cands.end(), cand) - cands.begin();
+			if (j < cands.size()) {
+				if (annots[j].empty())
+					annots[j] = annot;
+				continue;
+			}
+			cands.push_back(cand);
+			annots.push_back(annot);
+			if (i < e.scores.size())
+				scores.push_back(e.scores[i]);
+		}
+		e.cands.swap(cands);
+		e.scores.swap(scores);
+		uint32_t found = 0;
+		for (size_t i = 0; i < annots.size() && i < SKK_ANNOT_MAX_INDEX; i++)
+			found += !annots[i].empty();
+		e.annots.clear();
+		if (found > 0)
+			e.annots.swap(annots);
+		count += found;
+	}
+	return count;
+}
+
+// 注釈部を作る(skk.h 参照)。注釈がなければ空
+static std::vector<unsigned char> build_annotations(const std::vector<DictEntry>& entries) {
+	std::vector<uint32_t> ids, offsets;
+	std::string text;
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		const DictEntry& e = entries[i];
+		for (uint32_t j = 0; j < e.annots.size() && j < SKK_ANNOT_MAX_INDEX; j++) {
+			if (e.annots[j].empty())
+				continue;
+			ids.push_back(i << 8 | j);
+			offsets.push_back(text.size());
+			text += e.annots[j];
+		}
+	}
+	std::vector<unsigned char> section;
+	if (ids.empty())
+		return section;
+	offsets.push_back(text.size());
+
+	uint32_t n = ids.size();
+	section.resize(4 + n * 4 + (n + 1) * 4 + text.size());
+	put_u32(&section[0], n);
+	for (uint32_t i = 0; i < n; i++)
+		put_u32(&section[4 + i * 4], ids[i]);
+	for (uint32_t i = 0; i <= n; i++)
+		put_u32(&section[4 + n * 4 + i * 4], offsets[i]);
+	memcpy(&section[4 + n * 4 + (n + 1) * 4], text.data(), text.size());
+	return section;
+}
+
+std::vector<unsigned char> dict_build_image(const std::vector<DictEntry>& entries, double bloom_fp_rate) {
+	uint32_t n = entries.size();
+	std::vector<unsigned char> bloom;
+	if (bloom_fp_rate > 0 && bloom_fp_rate < 1)
+		bloom = build_bloom(entries, bloom_fp_rate);
+	std::vector<unsigned char> scores = build_scores(entries);
+	std::vector<unsigned char> annots = build_annotations(entries);
+
+	// 各部を4バイト境界から順に置く
+	uint32_t top = SKK_HEAD_SIZE;
+	uint32_t bloom_top = bloom.empty() ? 0 : top;
+	top = (top + bloom.size() + 3) & ~3u;
+	uint32_t score_top = scores.empty() ? 0 : top;
+	top = (top + scores.size() + 3) & ~3u;
+	uint32_t annot_top = annots.empty() ? 0 : top;
+	uint32_t index_top = (top + annots.size() + 3) & ~3u;
+	uint32_t data_top = index_top + n * 4;
+
+	// 全体サイズを先に求めて1回で確保する
+	size_t data_size = 0;
+	for (const DictEntry& e : entries) {
+		data_size += e.key.size() + 1;
+		for (const std::string& c : e.cands)
+			data_size += c.size() + 1;
+	}
+	std::vector<unsigned char> image(data_top + data_size);
+
+	put_u32(&image[0], n);
+	put_u32(&image[4], index_top);
+	put_u32(&image[8], data_top);
+	put_u32(&image[SKK_HEAD_COMPARATOR], SKK_CMP_BYTES);
+	put_u32(&image[SKK_HEAD_BLOOM], bloom_top);
+	put_u32(&image[SKK_HEAD_SCORE], score_top);
+	put_u32(&image[SKK_HEAD_ANNOT], annot_top);
+	put_u32(&image[SKK_HEAD_LENGTH], SKK_HEAD_SIZE);
+	if (!bloom.empty())
+		memcpy(&image[bloom_top], bloom.data(), bloom.size());
+	if (!scores.empty())
+		memcpy(&image[score_top], scores.data(), scores.size());
+	if (!annots.empty())
+		memcpy(&image[annot_top], annots.data(), annots.size());
+
+	unsigned char* index = &image[index_top];
+	unsigned char* data = image.data() + data_top;
+	uint32_t pos = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		const DictEntry& e = entries[i];
+		put_u32(index + i * 4, pos);
+
+		// 書式: 読み,候補1,候補2,...\0
+		memcpy(data + pos, e.key.data(), e.key.size());
+		pos += e.key.size();
+		for (const std::string& c : e.cands) {
+			data[pos++] = ',';
+			memcpy(data + pos, c.data(), c.size());
+			pos += c.size();
+		}
+		data[pos++] = '\0';
+	}
+	return image;
+}
@@ -0,0 +1,46 @@
+//
+// SKK辞書イメージ生成 (ホスト用)
+//  skk_dict_compiler とベンチマークで共通に使う。
+//  イメージ形式は SKK::begin() が読み込む形式と同じ:
+//   ヘッダー(登録単語数, インデックス先頭位置, データ先頭位置, キーの整列順序, Bloomフィルタ位置, 候補スコア位置, 注釈位置: 各 uint32_t LE)
+//   Bloomフィルタ(キーの種類毎。skk.h 参照)
+//   候補スコア(dict_rank() で頻度順にした場合。skk.h 参照)
+//   注釈(dict_strip_annotations() で外した場合。skk.h 参照)
+//   インデックス(データ先頭からの位置: uint32_t LE × 登録単語数)
+//   データ("読み,候補1,候補2,...\0" × 登録単語数)
+//
+#ifndef __DICT_BUILDER_H__
+#define __DICT_BUILDER_H__
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+struct DictEntry {
+	std::string              key;      // 読み(辞書の文字コード)
+	std::vector<std::string> cands;    // 候補(辞書の文字コード)
+	std::vector<uint8_t>     scores;   // 候補毎の頻度スコア(dict_rank() が付ける。空: スコアなし)
+	std::vector<std::string> annots;   // 候補毎の注釈(dict_strip_annotations() が付ける。空: 注釈なし)
+};
+
+// 読みをバイト列順(SKK::binfind() の比較順序)に整列し、同じ読みの項目の候補を1項目にまとめる
+void dict_sort(std::vector<DictEntry>& entries);
+
+// 出現回数の頻度スコア(0:回数なし、1～255: 1 + 8 log2(回数))
+uint8_t dict_score(uint64_t count);
+
+// 候補に頻度表(候補 → 出現回数)のスコアを付け、各項目の候補をスコアの高い順に並べる
+//  同じスコアの候補は元の順序(辞書の順序)を保つ。';' 以降(注釈)は照合しない。
+//  戻り値: 頻度表にあった候補の数
+uint32_t dict_rank(std::vector<DictEntry>& entries, const std::unordered_map<std::string, uint64_t>& freq);
+
+// 候補の ';' 以降(注釈)を外して annots に移す
+//  注釈を外して同じになった候補は先の1つにまとめる(注釈は先にあるものを残す)。
+//  dict_sort()・dict_rank() の後に呼ぶ。戻り値: 注釈の数
+uint32_t dict_strip_annotations(std::vector<DictEntry>& entries);
+
+// 整列済みの項目から辞書イメージを作る
+//  bloom_fp_rate: Bloomフィルタの偽陽性率(0の場合はフィルタを出力しない)
+std::vector<unsigned char> dict_build_image(const std::vector<DictEntry>& entries, double bloom_fp_rate = 0);
+
+#endif
@@ -0,0 +1,8 @@
+//
+// 全角フォントデータの代替 (ホスト用)
+//  mplus_font_10x10.c がない場合に使う空のフォント。描画処理の時間は計れるが文字は表示されない。
+//
+#include <nds/ndstypes.h>
+#include "mplus_font_10x10.h"
+
+const u16 FONT_MPLUS_10x10[0xFFFF][11];
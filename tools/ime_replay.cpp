@@ -0,0 +1,364 @@
+//
+// IME入力トレースの再生 (ホスト用)
+//  実機で記録した入力トレース(ime_trace.h)を Linux 用のプラットフォーム(platform_linux.h)で
+//  ImeApp に1フレームずつ与え、フレーム毎の処理時間(描画を含む)と最終状態のチェックサムを出力する。
+//  チェックサムが変わらなければ同じ入力に対して同じ結果になっている。
+//
+//  使い方:
+//   ime_replay [-a] [-d dict.bin] [-r report.csv] [-n 回数] [-s doc.txt [-j doc.jnl]] trace.bin
+//    -a  辞書検索を非同期(作業スレッド)で行う。チェックサムは同期検索と一致すること
+//    -d  辞書イメージ(省略時は組み込みのテスト辞書)
+//    -r  フレーム毎の処理時間(マイクロ秒)をCSV形式で出力する
+//    -n  再生回数(処理時間は最も速い回を採る)
+//    -s  確定文字列を文書として自動保存し(毎回空の文書から始める)、書き込み量と書き出し時間を出力する
+//    -j  文書の編集をジャーナルに書き、文書はチェックポイントで書き出す(毎回空のジャーナルから始める)
+//   ime_replay -k キー列 [-i 間隔] -w trace.bin
+//    -k  キー列から入力トレースを作る(\n:Enter \b:BackSpace \s:SELECT \u:上 \d:下 \e:START)
+//    -i  キー入力の間のフレーム数(既定値 4)
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+#include "ime_app.h"
+#include "ime_glyph.h"
+#include "ime_trace.h"
+#include "platform_linux.h"
+#include "profiler.h"
+#include "skk.h"
+#include "skk_async.h"
+
+#define MAX_TRACE_SIZE (16 * 1024 * 1024)
+
+static double now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static bool read_file(const char* path, std::vector<uint8_t>& data) {
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL)
+		return false;
+	data.resize(MAX_TRACE_SIZE);
+	size_t n = fread(data.data(), 1, data.size(), fp);
+	data.resize(n);
+	fclose(fp);
+	return true;
+}
+
+static bool write_file(const char* path, const uint8_t* data, size_t len) {
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+		return false;
+	bool ok = fwrite(data, 1, len, fp) == len;
+	return (fclose(fp) == 0) && ok;
+}
+
+// キー列から入力トレースを作る
+static int synthesize(const char* keys, int interval, const char* out) {
+	std::vector<uint8_t> buf(strlen(keys) * 16 * (interval + 1) + 64);
+	ImeTraceWriter w;
+	ImeInput idle = {};
+	imeTrace_begin(&w, buf.data(), buf.size());
+	for (const char* p = keys; *p; p++) {
+		ImeInput in = {};
+		if (*p == '\\' && p[1]) {
+			switch (*++p) {
+				case 'n': in.key = '\n'; break;
+				case 'b': in.key = '\b'; break;
+				case 's': in.buttons = IME_BTN_SELECT; break;
+				case 'u': in.buttons = IME_BTN_UP; break;
+				case 'd': in.buttons = IME_BTN_DOWN; break;
+				case 'e': in.buttons = IME_BTN_START; break;
+				default:  in.key = *p; break;
+			}
+		} else {
+			in.key = *p;
+		}
+		imeTrace_record(&w, &in);
+		for (int i = 0; i < interval; i++)
+			imeTrace_record(&w, &idle);
+	}
+	uint32_t len = imeTrace_finish(&w);
+	if (len == 0 || !write_file(out, buf.data(), len)) {
+		perror(out);
+		return 1;
+	}
+	printf("%s: %u frames, %u bytes\n", out, w.frame, len);
+	return 0;
+}
+
+// 入力イベント数を数えるトレース入力
+class CountingInput : public TraceInput {
+ public:
+	uint32_t events = 0;
+	bool     ended = false;   // トレースを最後まで読んだ
+	bool poll(ImeInput* in) {
+		if (!TraceInput::poll(in)) {
+			ended = true;
+			return false;
+		}
+		if (in->key || in->buttons)
+			events++;
+		return true;
+	}
+};
+
+struct Replay {
+	std::vector<double>   frame_us;                       // フレーム毎の ImeApp::frame() の時間
+	std::vector<uint32_t> phase_us[PROF_PHASE_COUNT];     // フレーム毎の処理段階の時間
+	uint32_t events = 0;
+	uint32_t checksum = 0;                                // ImeCore の状態
+	uint32_t fb_checksum = 0;                             // 最後に描画した画面
+	ImePrefetchStats prefetch = {};                       // 先読みの統計(非同期検索時)
+	ImeDocStats doc = {};                                 // 自動保存の統計(-s)
+	ImeJournalStats journal = {};                         // ジャーナルの統計(-j)
+	uint64_t doc_bytes = 0;                               // 文書ファイルへの書き込み(FileStorage の計数)
+	uint32_t doc_syncs = 0;
+	bool     doc_ok = false;                              // 保存した文書が確定文字列と一致した
+	bool     stopped = false;                             // START で終了した
+};
+
+static ImeApp s_app;   // 入力トレースの記録用バッファを含むので静的に置く
+
+// 保存した文書が確定文字列を Shift_JIS にしたものと一致するか
+static bool check_document(const char* path, const ImeText& text) {
+	std::vector<uint16_t> glyphs(text.length());
+	std::vector<char> expected(text.length() * 2 + 1);
+	std::vector<uint8_t> saved;
+	text.copy(0, text.length(), glyphs.data());
+	int len = imeGlyph_toSjis(expected.data(), expected.size(), glyphs.data(), glyphs.size());
+	return read_file(path, saved) && saved.size() == (size_t)len &&
+	       memcmp(saved.data(), expected.data(), len) == 0;
+}
+
+static bool replay(SKK& skk, SKKAsync* async, const std::vector<uint8_t>& trace, const char* doc_path,
+                   const char* journal_path, Replay& r) {
+	CountingInput input;
+	MemoryFramebuffer fb;
+	PosixClock clock;
+	FileStorage storage;
+	Platform platform = { &input, &fb, &clock, &storage };
+
+	if (!input.open(trace.data(), trace.size()))
+		return false;
+	prof_init();
+	skk.clear_cache();
+	s_app.init(platform, &skk, async, false);
+	if (doc_path != NULL) {
+		remove(doc_path);
+		if (journal_path != NULL)
+			remove(journal_path);
+		if (!s_app.open_document(doc_path, journal_path)) {
+			perror(doc_path);
+			return false;
+		}
+	}
+	for (;;) {
+		double t0 = now_us();
+		bool cont = s_app.frame();
+		double t1 = now_us();
+		if (!cont) {
+			r.stopped = !input.ended;   // 入力の終わりでなければ START
+			break;
+		}
+		r.frame_us.push_back(t1 - t0);
+		for (int p = 0; p < PROF_PHASE_COUNT; p++) {
+			ProfStats st;
+			prof_get((ProfPhase)p, &st);
+			r.phase_us[p].push_back(st.last);
+		}
+	}
+	s_app.settle();   // 非同期検索の結果を待ってからチェックサムを取る
+	if (async != NULL)
+		async->flush();   // 先読みも終えてから次の回の検索結果キャッシュを消去する
+	r.events = input.events;
+	r.checksum = s_app.core().checksum();
+	r.fb_checksum = fb.checksum();
+	r.prefetch = s_app.core().prefetch_stats();
+	if (doc_path != NULL) {
+		bool saved = s_app.close_document();   // START で終了していれば保存済み
+		r.doc = s_app.document().stats();
+		r.journal = s_app.document().journal_stats();
+		r.doc_bytes = storage.bytes_written();
+		r.doc_syncs = storage.syncs();
+		r.doc_ok = saved && check_document(doc_path, s_app.core().text());
+	}
+	return true;
+}
+
+static double percentile(std::vector<double> v, double p) {
+	if (v.empty())
+		return 0;
+	std::sort(v.begin(), v.end());
+	return v[(size_t)((v.size() - 1) * p)];
+}
+
+static void usage() {
+	fprintf(stderr,
+	        "usage: ime_replay [-a] [-d dict.bin] [-r report.csv] [-n runs] [-s doc.txt [-j doc.jnl]] trace.bin\n"
+	        "       ime_replay -k keys [-i interval] -w trace.bin\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	const char* trace_path = NULL;
+	const char* dict_path = NULL;
+	const char* report_path = NULL;
+	const char* keys = NULL;
+	const char* out_path = NULL;
+	const char* doc_path = NULL;
+	const char* journal_path = NULL;
+	int runs = 1;
+	bool use_async = false;
+	int interval = 4;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-a") == 0) {
+			use_async = true;
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			dict_path = argv[++i];
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			report_path = argv[++i];
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			runs = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+			keys = argv[++i];
+		} else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+			interval = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			doc_path = argv[++i];
+		} else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			journal_path = argv[++i];
+		} else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+			out_path = argv[++i];
+		} else if (argv[i][0] == '-' || trace_path != NULL) {
+			usage();
+		} else {
+			trace_path = argv[i];
+		}
+	}
+	if (keys != NULL) {
+		if (out_path == NULL || interval < 0)
+			usage();
+		return synthesize(keys, interval, out_path);
+	}
+	if (trace_path == NULL || runs < 1)
+		usage();
+
+	std::vector<uint8_t> trace, dict;
+	if (!read_file(trace_path, trace)) {
+		perror(trace_path);
+		return 1;
+	}
+	SKK skk;
+	uint32_t entries;
+	if (dict_path != NULL) {
+		if (!read_file(dict_path, dict)) {
+			perror(dict_path);
+			return 1;
+		}
+		entries = skk.begin(dict.data(), dict.size());
+	} else {
+		entries = skk.begin((const char*)NULL);
+	}
+	if (entries == 0) {
+		fprintf(stderr, "failed to load dictionary\n");
+		return 1;
+	}
+	SKKAsync async;
+	if (use_async && !async.begin(&skk)) {
+		fprintf(stderr, "failed to start lookup thread\n");
+		return 1;
+	}
+
+	// 複数回再生し、合計時間が最も短い回を採る(チェックサムは全回一致すること)
+	Replay best;
+	double best_total = 0;
+	for (int n = 0; n < runs; n++) {
+		Replay r;
+		if (!replay(skk, use_async ? &async : NULL, trace, doc_path, journal_path, r)) {
+			fprintf(stderr, "%s: replay failed\n", trace_path);
+			return 1;
+		}
+		if (n > 0 && (r.checksum != best.checksum || r.fb_checksum != best.fb_checksum)) {
+			fprintf(stderr, "checksum differs between runs: %08x / %08x\n", best.checksum, r.checksum);
+			return 1;
+		}
+		double total = 0;
+		for (double t : r.frame_us)
+			total += t;
+		if (n == 0 || total < best_total) {
+			best = r;
+			best_total = total;
+		}
+	}
+
+	if (report_path != NULL) {
+		FILE* fp = fopen(report_path, "w");
+		if (fp == NULL) {
+			perror(report_path);
+			return 1;
+		}
+		fprintf(fp, "frame,total");
+		for (int p = 0; p < PROF_PHASE_COUNT; p++)
+			fprintf(fp, ",%s", prof_phase_name((ProfPhase)p));
+		fprintf(fp, "\n");
+		for (size_t f = 0; f < best.frame_us.size(); f++) {
+			fprintf(fp, "%zu,%.3f", f, best.frame_us[f]);
+			for (int p = 0; p < PROF_PHASE_COUNT; p++)
+				fprintf(fp, ",%u", best.phase_us[p][f]);
+			fprintf(fp, "\n");
+		}
+		fclose(fp);
+	}
+
+	printf("trace:     %s (%zu bytes, %u input events%s)\n", trace_path, trace.size(), best.events,
+	       best.stopped ? ", stopped by START" : "");
+	printf("frames:    %zu\n", best.frame_us.size());
+	printf("frame us:  total %.1f  avg %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+	       best_total, best.frame_us.empty() ? 0 : best_total / best.frame_us.size(),
+	       percentile(best.frame_us, 0.50), percentile(best.frame_us, 0.95),
+	       percentile(best.frame_us, 0.99), percentile(best.frame_us, 1.0));
+	for (int p = 0; p < PROF_PHASE_COUNT; p++) {
+		uint64_t sum = 0;
+		uint32_t max = 0;
+		for (uint32_t t : best.phase_us[p]) {
+			sum += t;
+			max = std::max(max, t);
+		}
+		printf("  %-7s total %8llu us  max %6u us\n", prof_phase_name((ProfPhase)p), (unsigned long long)sum, max);
+	}
+	printf("checksum:  %08x (screen %08x)\n", best.checksum, best.fb_checksum);
+	if (doc_path != NULL) {
+		// ジャーナルを全体の大きさで作る1回きりの書き込みは別に示す
+		printf("document:  %s, %u saves, %u chunks, %llu bytes written, %u syncs%s\n", doc_path,
+		       best.doc.saves, best.doc.writes, (unsigned long long)(best.doc_bytes - best.journal.preallocated),
+		       best.doc_syncs, best.doc_ok ? "" : " (MISMATCH)");
+		printf("autosave:  %u steps, step avg %.1f us  max %u us, edit to saved max %u us\n", best.doc.steps,
+		       best.doc.steps ? (double)best.doc.step_us_total / best.doc.steps : 0.0, best.doc.step_us_max,
+		       best.doc.lag_us_max);
+		if (journal_path != NULL) {
+			printf("journal:   %s, %u records, %u syncs, %u sectors written, %u checkpoints\n", journal_path,
+			       best.journal.records, best.journal.syncs, best.journal.sectors_written, best.journal.resets);
+			printf("prealloc:  %u bytes (journal file created at full size)\n", best.journal.preallocated);
+		}
+		if (!best.doc_ok)
+			return 1;
+	}
+	if (use_async) {
+		SKKAsyncStats st;
+		async.get_stats(&st);
+		printf("async:     %u submitted (%u prefetch), %u completed, %u cancelled, %u rejected\n",
+		       st.submitted, st.prefetched, st.completed, st.cancelled, st.rejected);
+		printf("prefetch:  %u issued, %u hits, %u misses, %u wasted\n", best.prefetch.issued,
+		       best.prefetch.hits, best.prefetch.misses, best.prefetch.wasted);
+		async.end();
+	}
+	return 0;
+}
@@ -0,0 +1,450 @@
+//
+// SKK辞書コンパイラ (ホスト用)
+//  SKK-JISYO 形式のテキスト辞書を SKK クラスが読み込むバイナリ辞書に変換する。
+//  入力はブロック単位で読み込み、各ブロックを複数スレッドで並列に解析する。
+//  生成したイメージは SKK クラスで読み戻して全項目を検証する。
+//
+//  使い方:
+//   skk_dict_compiler [-e utf-8|euc-jp] [-j スレッド数] [-p 偽陽性率] [-f freq.txt] [-o dict.bin] [-s dict.s] [-c dict.h] input.txt
+//    -p  Bloomフィルタの偽陽性率(既定値 0.01。0 の場合はフィルタを出力しない)
+//    -f  頻度表(1行に「単語 出現回数」、回数を省くと1回。同じ単語の行は合計する。文字コードは -e)。
+//        各項目の候補を出現回数の多い順に並べ、候補毎の頻度スコアを出力する
+//    -o  SKK辞書イメージ(.bin)を出力する
+//    -s  -o の .bin を .incbin で取り込むアセンブラソースを出力する
+//        (シンボル embedded_skk_dict / embedded_skk_dict_end。SKK_DICT_INCBIN と組み合わせて使う)
+//    -c  C言語の配列として出力する(小さなテスト辞書用)
+//  候補の注釈(";注釈")は候補リストから外して注釈部に出力する。
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <iconv.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <unordered_map>
+
+#include "dict_builder.h"
+#include "skk.h"
+
+#define READ_BLOCK_SIZE   (4 * 1024 * 1024)   // 1回に読み込むバイト数
+#define MAX_WARNINGS      10                  // 詳細を表示する警告の数
+#define DEFAULT_BLOOM_FP_RATE 0.01            // Bloomフィルタの偽陽性率の既定値
+
+//
+// 文字コード変換(iconv)
+//
+class Converter {
+ public:
+	Converter(const char* to, const char* from) {
+		cd = iconv_open(to, from);
+		identity = (strcasecmp(to, from) == 0);
+	}
+	~Converter() {
+		if (cd != (iconv_t)-1)
+			iconv_close(cd);
+	}
+	bool ok() const { return cd != (iconv_t)-1; }
+
+	// 変換できない文字を含む場合は false
+	bool convert(const char* src, size_t len, std::string& dst) {
+		if (identity) {
+			dst.assign(src, len);
+			return true;
+		}
+		dst.resize(len * 4 + 4);
+		char* in = (char*)src;
+		size_t in_left = len;
+		char* out = &dst[0];
+		size_t out_left = dst.size();
+		iconv(cd, NULL, NULL, NULL, NULL);
+		if (iconv(cd, &in, &in_left, &out, &out_left) == (size_t)-1)
+			return false;
+		dst.resize(dst.size() - out_left);
+		return true;
+	}
+
+ private:
+	iconv_t cd;
+	bool    identity;
+};
+
+struct ParseResult {
+	std::vector<DictEntry>   entries;
+	std::vector<std::string> warnings;
+	uint32_t                 lines = 0;
+	uint32_t                 skipped = 0;
+};
+
+static const char* g_input_encoding = "UTF-8";
+
+static void warn(ParseResult& r, const char* msg, const char* line, size_t len) {
+	r.skipped++;
+	if (r.warnings.size() < MAX_WARNINGS)
+		r.warnings.push_back(std::string(msg) + ": " + std::string(line, len));
+}
+
+//
+// 1スレッド分の解析
+//  書式: 読み /候補1/候補2/.../
+//  ';' または '#' で始まる行はコメント
+//
+static void parse_range(const char* text, size_t len, ParseResult* result) {
+	ParseResult& r = *result;
+	Converter to_sjis("SHIFT_JIS", g_input_encoding);
+	std::string tmp;
+
+	const char* p = text;
+	const char* end = text + len;
+	while (p < end) {
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		if (eol == NULL)
+			eol = end;
+		const char* line = p;
+		size_t line_len = eol - p;
+		p = eol + 1;
+		r.lines++;
+
+		while (line_len > 0 && (line[line_len-1] == '\r' || line[line_len-1] == ' ' || line[line_len-1] == '\t'))
+			line_len--;
+		while (line_len > 0 && (*line == ' ' || *line == '\t')) {
+			line++;
+			line_len--;
+		}
+		if (line_len == 0 || *line == ';' || *line == '#')
+			continue;
+
+		const char* sep = (const char*)memmem(line, line_len, " /", 2);
+		if (sep == NULL) {
+			warn(r, "malformed line", line, line_len);
+			continue;
+		}
+
+		DictEntry e;
+		size_t yomi_len = sep - line;
+		while (yomi_len > 0 && (line[yomi_len-1] == ' ' || line[yomi_len-1] == '\t'))
+			yomi_len--;
+		if (yomi_len == 0 || !to_sjis.convert(line, yomi_len, e.key)) {
+			warn(r, "unencodable reading", line, line_len);
+			continue;
+		}
+		if (e.key.find(',') != std::string::npos) {
+			warn(r, "reading contains ','", line, line_len);
+			continue;
+		}
+
+		// 候補の分割
+		const char* c = sep + 2;
+		const char* line_end = line + line_len;
+		while (c < line_end) {
+			const char* slash = (const char*)memchr(c, '/', line_end - c);
+			if (slash == NULL)
+				slash = line_end;
+			if (slash > c) {
+				if (memchr(c, ',', slash - c) != NULL) {
+					warn(r, "candidate contains ','", line, line_len);
+				} else if (!to_sjis.convert(c, slash - c, tmp)) {
+					warn(r, "unencodable candidate", line, line_len);
+				} else {
+					e.cands.push_back(tmp);
+				}
+			}
+			c = slash + 1;
+		}
+		if (e.cands.empty()) {
+			warn(r, "no candidates", line, line_len);
+			continue;
+		}
+		r.entries.push_back(std::move(e));
+	}
+}
+
+//
+// ブロックを行境界でスレッド数に分割して並列に解析する
+//
+static void parse_block(const char* text, size_t len, unsigned nthreads, std::vector<ParseResult>& results) {
+	std::vector<std::thread> threads;
+	size_t first = results.size();
+	results.resize(first + nthreads);
+
+	size_t start = 0;
+	for (unsigned t = 0; t < nthreads; t++) {
+		size_t stop = (t == nthreads - 1) ? len : len * (t + 1) / nthreads;
+		if (stop < start)
+			stop = start;
+		while (stop > 0 && stop < len && text[stop - 1] != '\n')
+			stop++;
+		threads.push_back(std::thread(parse_range, text + start, stop - start, &results[first + t]));
+		start = stop;
+	}
+	for (std::thread& th : threads)
+		th.join();
+}
+
+//
+// 生成したイメージを SKK クラスで読み戻して検証する
+//
+static uint32_t verify_image(const std::vector<unsigned char>& image, const std::vector<DictEntry>& entries) {
+	SKK skk;
+	char buf[1024];
+	uint32_t errors = 0;
+
+	// キーの整列順序も SKK クラス側の比較で検査する
+	if (skk.begin(image.data(), image.size(), true) != entries.size()) {
+		fprintf(stderr, "verify: wrong entry count or keys not in binfind() order\n");
+		return 1;
+	}
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		const DictEntry& e = entries[i];
+		int32_t pos = skk.find_index(e.key.data(), e.key.size());
+		bool ok = (pos == (int32_t)i) && skk.count_kouho_list_by_index(i) == e.cands.size();
+		for (uint16_t j = 0; ok && j < e.cands.size(); j++) {
+			if (j < e.scores.size() && j < 255)
+				ok = skk.get_kouho_score(i, j) == e.scores[j];
+			if (e.cands[j].size() >= sizeof(buf))
+				continue;
+			ok = ok && skk.get_kouho_by_index(buf, j, i) && e.cands[j] == buf;
+		}
+		for (uint16_t j = 0; ok && j < SKK_ANNOT_MAX_INDEX && j < e.cands.size(); j++) {
+			std::string annot = j < e.annots.size() ? e.annots[j] : std::string();
+			if (annot.size() >= sizeof(buf))
+				continue;
+			ok = skk.get_annotation(buf, sizeof(buf), i, j) == annot.size() && annot == buf;
+		}
+		if (!ok) {
+			if (errors < MAX_WARNINGS)
+				fprintf(stderr, "verify: entry %u not found at its position (binfind=%d)\n",
+				        i, pos);
+			errors++;
+		}
+	}
+	return errors;
+}
+
+//
+// 頻度表の読み込み
+//  書式: 単語 [出現回数]  (空白またはタブ区切り。';' または '#' で始まる行はコメント)
+//
+static bool load_frequencies(const char* path, std::unordered_map<std::string, uint64_t>& freq) {
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL)
+		return false;
+	Converter to_sjis("SHIFT_JIS", g_input_encoding);
+	std::string word;
+	char line[1024];
+	uint32_t skipped = 0;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		char* p = line + strspn(line, " \t");
+		if (*p == ';' || *p == '#')
+			continue;
+		size_t len = strcspn(p, " \t\r\n");
+		if (len == 0)
+			continue;
+		char* q = p + len;
+		q += strspn(q, " \t");
+		uint64_t count = (*q >= '0' && *q <= '9') ? strtoull(q, NULL, 10) : 1;
+		if (!to_sjis.convert(p, len, word)) {
+			skipped++;
+			continue;
+		}
+		freq[word] += count;
+	}
+	fclose(fp);
+	if (skipped > 0)
+		fprintf(stderr, "Warning: %u unencodable words in %s\n", skipped, path);
+	return true;
+}
+
+static bool write_bin(const char* path, const std::vector<unsigned char>& image) {
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+		return false;
+	bool ok = fwrite(image.data(), 1, image.size(), fp) == image.size();
+	return (fclose(fp) == 0) && ok;
+}
+
+static bool write_incbin(const char* path, const char* bin_path) {
+	FILE* fp = fopen(path, "w");
+	if (fp == NULL)
+		return false;
+	fprintf(fp, "@ Generated by skk_dict_compiler\n");
+	fprintf(fp, "\t.section .rodata\n");
+	fprintf(fp, "\t.balign 4\n");
+	fprintf(fp, "\t.global embedded_skk_dict\n");
+	fprintf(fp, "embedded_skk_dict:\n");
+	fprintf(fp, "\t.incbin \"%s\"\n", bin_path);
+	fprintf(fp, "\t.global embedded_skk_dict_end\n");
+	fprintf(fp, "embedded_skk_dict_end:\n");
+	return fclose(fp) == 0;
+}
+
+static bool write_c_array(const char* path, const char* input, uint32_t nentries, const std::vector<unsigned char>& image) {
+	static const char hex[] = "0123456789abcdef";
+	FILE* fp = fopen(path, "w");
+	if (fp == NULL)
+		return false;
+	fprintf(fp, "// Generated from %s by skk_dict_compiler\n", input);
+	fprintf(fp, "// Total entries: %u\n", nentries);
+	fprintf(fp, "// Data size: %zu bytes\n\n", image.size());
+	fprintf(fp, "const unsigned char embedded_skk_dict[] = {\n");
+
+	// 1行(16バイト)ずつまとめて書き出す
+	char line[4 + 16 * 5 + 2];
+	for (size_t i = 0; i < image.size(); i += 16) {
+		char* q = line;
+		memcpy(q, "    ", 4);
+		q += 4;
+		for (size_t j = i; j < i + 16 && j < image.size(); j++) {
+			*q++ = '0';
+			*q++ = 'x';
+			*q++ = hex[image[j] >> 4];
+			*q++ = hex[image[j] & 0xf];
+			*q++ = ',';
+		}
+		*q++ = '\n';
+		fwrite(line, 1, q - line, fp);
+	}
+	fprintf(fp, "\n};\n");
+	return fclose(fp) == 0;
+}
+
+static void usage() {
+	fprintf(stderr,
+	        "usage: skk_dict_compiler [-e utf-8|euc-jp] [-j threads] [-p bloom_fp_rate] [-f freq.txt] [-o dict.bin] [-s dict.s] [-c dict.h] input.txt\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	const char* input = NULL;
+	const char* out_bin = NULL;
+	const char* out_asm = NULL;
+	const char* out_c = NULL;
+	const char* freq_path = NULL;
+	unsigned nthreads = std::thread::hardware_concurrency();
+	double bloom_fp_rate = DEFAULT_BLOOM_FP_RATE;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+			i++;
+			if (strcasecmp(argv[i], "utf-8") == 0) {
+				g_input_encoding = "UTF-8";
+			} else if (strcasecmp(argv[i], "euc-jp") == 0) {
+				g_input_encoding = "EUC-JP";
+			} else {
+				fprintf(stderr, "unknown encoding: %s\n", argv[i]);
+				usage();
+			}
+		} else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			nthreads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			bloom_fp_rate = atof(argv[++i]);
+			if (bloom_fp_rate < 0 || bloom_fp_rate >= 1)
+				usage();
+		} else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			freq_path = argv[++i];
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			out_bin = argv[++i];
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			out_asm = argv[++i];
+		} else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			out_c = argv[++i];
+		} else if (argv[i][0] == '-' || input != NULL) {
+			usage();
+		} else {
+			input = argv[i];
+		}
+	}
+	if (input == NULL || (out_bin == NULL && out_c == NULL) || (out_asm != NULL && out_bin == NULL))
+		usage();
+	if (nthreads == 0)
+		nthreads = 1;
+
+	if (!Converter("SHIFT_JIS", g_input_encoding).ok()) {
+		fprintf(stderr, "iconv does not support %s -> SHIFT_JIS\n", g_input_encoding);
+		return 1;
+	}
+
+	FILE* fp = fopen(input, "rb");
+	if (fp == NULL) {
+		perror(input);
+		return 1;
+	}
+
+	// ブロック単位で読み込み、行の途中で切れた部分は次のブロックに回す
+	std::vector<ParseResult> results;
+	std::vector<char> block(READ_BLOCK_SIZE);
+	size_t carry = 0;
+	for (;;) {
+		size_t n = fread(block.data() + carry, 1, block.size() - carry, fp);
+		size_t filled = carry + n;
+		if (filled == 0)
+			break;
+		size_t parse_len = filled;
+		if (n > 0) {
+			while (parse_len > 0 && block[parse_len - 1] != '\n')
+				parse_len--;
+			if (parse_len == 0) {
+				// 1行がブロックより長い場合はブロックを拡張する
+				block.resize(block.size() * 2);
+				carry = filled;
+				continue;
+			}
+		}
+		parse_block(block.data(), parse_len, nthreads, results);
+		carry = filled - parse_len;
+		memmove(block.data(), block.data() + parse_len, carry);
+		if (n == 0)
+			break;
+	}
+	fclose(fp);
+
+	std::vector<DictEntry> entries;
+	uint32_t lines = 0, skipped = 0;
+	for (ParseResult& r : results) {
+		lines += r.lines;
+		skipped += r.skipped;
+		for (const std::string& w : r.warnings)
+			fprintf(stderr, "Warning: %s\n", w.c_str());
+		for (DictEntry& e : r.entries)
+			entries.push_back(std::move(e));
+	}
+	if (skipped > 0)
+		fprintf(stderr, "Warning: %u lines or candidates skipped\n", skipped);
+
+	dict_sort(entries);
+	if (freq_path != NULL) {
+		std::unordered_map<std::string, uint64_t> freq;
+		if (!load_frequencies(freq_path, freq)) {
+			perror(freq_path);
+			return 1;
+		}
+		uint32_t matched = dict_rank(entries, freq);
+		printf("%s: %zu words, %u candidates ranked\n", freq_path, freq.size(), matched);
+	}
+	uint32_t nannots = dict_strip_annotations(entries);
+	if (nannots > 0)
+		printf("%u annotations moved out of the candidate lists\n", nannots);
+	std::vector<unsigned char> image = dict_build_image(entries, bloom_fp_rate);
+
+	uint32_t errors = verify_image(image, entries);
+	if (errors > 0) {
+		fprintf(stderr, "verify: %u of %zu entries cannot be read back\n", errors, entries.size());
+		return 1;
+	}
+
+	if (out_bin && !write_bin(out_bin, image)) {
+		perror(out_bin);
+		return 1;
+	}
+	if (out_asm && !write_incbin(out_asm, out_bin)) {
+		perror(out_asm);
+		return 1;
+	}
+	if (out_c && !write_c_array(out_c, input, entries.size(), image)) {
+		perror(out_c);
+		return 1;
+	}
+	printf("%s: %u lines, %zu entries, %zu bytes\n", input, lines, entries.size(), image.size());
+	return 0;
+}